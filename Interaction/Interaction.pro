@@ -9,8 +9,13 @@ QT += core gui opengl network multimedia widgets
 TARGET   = Interaction
 TEMPLATE = app
 
+CONFIG  += c++11
+
 DEFINES += NO_DEBUG_ARUCO
 
+# Tiempos por etapa en ../Files/profile.csv y profile.json: qmake CONFIG+=profiler
+profiler:DEFINES += ENABLE_PROFILER
+
 unix:INCLUDEPATH += "/usr/include/GL/"                             # OpenGL
 unix:LIBS += "/usr/lib/x86_64-linux-gnu/libglut.so"                # OpenGL
 
@@ -26,23 +31,50 @@ unix:LIBS += "/usr/lib/x86_64-linux-gnu/lib3ds.so"                 # Modelos 3D
 
 SOURCES += main.cpp\
            scene.cpp \
+           model.cpp \
+           meshcompiler.cpp \
+           handtracker.cpp \
+           framesource.cpp \
+           skinsegmenter.cpp \
+           morphology.cpp \
+           pipeline.cpp \
+           posefilter.cpp \
+           streamingtexture.cpp \
+           profiler.cpp \
+           aruco/adaptivethreshold.cpp \
            aruco/ar_omp.cpp \
            aruco/arucofidmarkers.cpp \
            aruco/board.cpp \
            aruco/boarddetector.cpp \
            aruco/cameraparameters.cpp \
            aruco/chromaticmask.cpp \
+           aruco/cornerrefiner.cpp \
            aruco/cvdrawingutils.cpp \
            aruco/highlyreliablemarkers.cpp \
            aruco/marker.cpp \
            aruco/markerdetector.cpp \
+           aruco/markertracker.cpp \
+           aruco/planarposesolver.cpp \
            aruco/subpixelcorner.cpp \
+           aruco/threadpool.cpp \
     principal.cpp
 
 HEADERS += model.h \
+           meshcompiler.h \
            scene.h \
+           handtracker.h \
+           framesource.h \
+           skinsegmenter.h \
+           morphology.h \
+           roitracker.h \
+           framering.h \
+           pipeline.h \
+           posefilter.h \
+           profiler.h \
            texture.h \
+           streamingtexture.h \
            video.h \
+           aruco/adaptivethreshold.h \
            aruco/ar_omp.h \
            aruco/aruco.h \
            aruco/arucofidmarkers.h \
@@ -50,12 +82,18 @@ HEADERS += model.h \
            aruco/boarddetector.h \
            aruco/cameraparameters.h \
            aruco/chromaticmask.h \
+           aruco/cornerrefiner.h \
            aruco/cvdrawingutils.h \
            aruco/exports.h \
+           aruco/growbuffer.h \
            aruco/highlyreliablemarkers.h \
            aruco/marker.h \
            aruco/markerdetector.h \
+           aruco/markertracker.h \
+           aruco/planarposesolver.h \
            aruco/subpixelcorner.h \
+           aruco/threadpool.h \
+           aruco/toonearpairs.h \
     principal.h
 
 FORMS += \
@@ -0,0 +1,165 @@
+#include "adaptivethreshold.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ARUCO_ADAPTIVE_SSE2
+#endif
+
+using namespace cv;
+
+namespace aruco{
+
+AdaptiveThreshold::AdaptiveThreshold()
+{
+}
+
+/************************************
+ *
+ * _colSums[x]+=add[x]-sub[x]
+ *
+ ************************************/
+void AdaptiveThreshold::rollColumns(const uchar *add,const uchar *sub,int cols)
+{
+    int *sums=&_colSums[0];
+    int x=0;
+#ifdef ARUCO_ADAPTIVE_SSE2
+    const __m128i zero=_mm_setzero_si128();
+    for (;x<=cols-16;x+=16) {
+        __m128i a=_mm_loadu_si128((const __m128i*)(add+x));
+        __m128i s=_mm_loadu_si128((const __m128i*)(sub+x));
+        //differences in [-255,255], sign extended to 32 bits
+        __m128i dlo=_mm_sub_epi16(_mm_unpacklo_epi8(a,zero),_mm_unpacklo_epi8(s,zero));
+        __m128i dhi=_mm_sub_epi16(_mm_unpackhi_epi8(a,zero),_mm_unpackhi_epi8(s,zero));
+        __m128i d0=_mm_srai_epi32(_mm_unpacklo_epi16(dlo,dlo),16);
+        __m128i d1=_mm_srai_epi32(_mm_unpackhi_epi16(dlo,dlo),16);
+        __m128i d2=_mm_srai_epi32(_mm_unpacklo_epi16(dhi,dhi),16);
+        __m128i d3=_mm_srai_epi32(_mm_unpackhi_epi16(dhi,dhi),16);
+        __m128i *p=(__m128i*)(sums+x);
+        _mm_storeu_si128(p,_mm_add_epi32(_mm_loadu_si128(p),d0));
+        _mm_storeu_si128(p+1,_mm_add_epi32(_mm_loadu_si128(p+1),d1));
+        _mm_storeu_si128(p+2,_mm_add_epi32(_mm_loadu_si128(p+2),d2));
+        _mm_storeu_si128(p+3,_mm_add_epi32(_mm_loadu_si128(p+3),d3));
+    }
+#endif
+    for (;x<cols;x++) sums[x]+=int(add[x])-int(sub[x]);
+}
+
+/************************************
+ *
+ * Horizontal box of the column sums, replicating the first and last columns
+ *
+ ************************************/
+void AdaptiveThreshold::boxRow(int cols,int radius)
+{
+    const int *sums=&_colSums[0];
+    int *prefix=&_prefix[0];
+    int *box=&_boxSums[0];
+    int blockSize=2*radius+1;
+
+    int acc=0;
+    int k=0;
+    prefix[k++]=0;
+    for (int i=0;i<radius;i++) prefix[k++]=(acc+=sums[0]);
+    for (int x=0;x<cols;x++) prefix[k++]=(acc+=sums[x]);
+    for (int i=0;i<radius;i++) prefix[k++]=(acc+=sums[cols-1]);
+
+    int x=0;
+#ifdef ARUCO_ADAPTIVE_SSE2
+    for (;x<=cols-4;x+=4) {
+        __m128i hi=_mm_loadu_si128((const __m128i*)(prefix+x+blockSize));
+        __m128i lo=_mm_loadu_si128((const __m128i*)(prefix+x));
+        _mm_storeu_si128((__m128i*)(box+x),_mm_sub_epi32(hi,lo));
+    }
+#endif
+    for (;x<cols;x++) box[x]=prefix[x+blockSize]-prefix[x];
+}
+
+/************************************
+ *
+ * dst=255 where 2*box-A*(2*delta-1) >= 2*A*src
+ *
+ ************************************/
+void AdaptiveThreshold::compareRow(const uchar *src,uchar *dst,int cols,int area,int delta)
+{
+    const int *box=&_boxSums[0];
+    //delta is bounded by the caller, so this does not overflow
+    const int offset=area*(1-2*delta);
+    const int area2=2*area;
+
+    int x=0;
+#ifdef ARUCO_ADAPTIVE_SSE2
+    //src*2A is done with _mm_madd_epi16, valid while 2A fits in a signed short
+    if (area2<32768) {
+        const __m128i zero=_mm_setzero_si128();
+        const __m128i vOffset=_mm_set1_epi32(offset);
+        const __m128i vArea2=_mm_set1_epi32(area2);
+        const __m128i ones=_mm_set1_epi32(-1);
+        for (;x<=cols-16;x+=16) {
+            __m128i s=_mm_loadu_si128((const __m128i*)(src+x));
+            __m128i slo=_mm_unpacklo_epi8(s,zero);
+            __m128i shi=_mm_unpackhi_epi8(s,zero);
+            __m128i r[4];
+            r[0]=_mm_madd_epi16(_mm_unpacklo_epi16(slo,zero),vArea2);
+            r[1]=_mm_madd_epi16(_mm_unpackhi_epi16(slo,zero),vArea2);
+            r[2]=_mm_madd_epi16(_mm_unpacklo_epi16(shi,zero),vArea2);
+            r[3]=_mm_madd_epi16(_mm_unpackhi_epi16(shi,zero),vArea2);
+            __m128i m[4];
+            for (int i=0;i<4;i++) {
+                __m128i b=_mm_loadu_si128((const __m128i*)(box+x+4*i));
+                __m128i l=_mm_add_epi32(_mm_add_epi32(b,b),vOffset);
+                //l>=r  <=>  !(r>l)
+                m[i]=_mm_xor_si128(_mm_cmpgt_epi32(r[i],l),ones);
+            }
+            __m128i m16lo=_mm_packs_epi32(m[0],m[1]);
+            __m128i m16hi=_mm_packs_epi32(m[2],m[3]);
+            _mm_storeu_si128((__m128i*)(dst+x),_mm_packs_epi16(m16lo,m16hi));
+        }
+    }
+#endif
+    for (;x<cols;x++) dst[x]=(2*box[x]+offset>=area2*int(src[x]))?255:0;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void AdaptiveThreshold::apply(const Mat &grey,Mat &out,int blockSize,double C,bool subsample)throw (cv::Exception)
+{
+    if (grey.type()!=CV_8UC1) throw cv::Exception(9001,"grey.type()!=CV_8UC1","AdaptiveThreshold::apply",__FILE__,__LINE__);
+    if (blockSize<3 || blockSize%2!=1) throw cv::Exception(9001,"blockSize must be odd and >=3","AdaptiveThreshold::apply",__FILE__,__LINE__);
+    if (grey.data==out.data) throw cv::Exception(9001,"in-place threshold is not supported","AdaptiveThreshold::apply",__FILE__,__LINE__);
+
+    out.create(grey.size(),CV_8UC1);
+    const int rows=grey.rows,cols=grey.cols;
+    if (rows==0 || cols==0) return;
+
+    const int radius=blockSize/2;
+    const int area=blockSize*blockSize;
+    //OpenCV uses floor(C) for THRESH_BINARY_INV. Beyond +-255 the output no longer changes, so it is clamped
+    int delta=std::max(-256,std::min(256,int(std::floor(C))));
+
+    _colSums.assign(cols,0);
+    _prefix.resize(cols+blockSize);
+    _boxSums.resize(cols);
+    _zeros.resize(cols,0);
+
+    //column sums of the rows around row 0, replicating the first and last rows
+    for (int i=-radius;i<=radius;i++)
+        rollColumns(grey.ptr<uchar>(std::max(0,std::min(rows-1,i))),&_zeros[0],cols);
+
+    for (int y=0;y<rows;y++) {
+        if (y>0) {
+            const uchar *add=grey.ptr<uchar>(std::min(rows-1,y+radius));
+            const uchar *sub=grey.ptr<uchar>(std::max(0,y-radius-1));
+            rollColumns(add,sub,cols);
+        }
+        if (!subsample || y%2==0) boxRow(cols,radius);
+        compareRow(grey.ptr<uchar>(y),out.ptr<uchar>(y),cols,area,delta);
+    }
+}
+
+}
@@ -0,0 +1,53 @@
+#ifndef aruco_ADAPTIVETHRESHOLD_HPP
+#define aruco_ADAPTIVETHRESHOLD_HPP
+
+#include <vector>
+#include <opencv2/core/core.hpp> // Basic OpenCV structures (cv::Mat)
+
+namespace aruco
+{
+
+/**
+ * Mean adaptive threshold computed in a single pass.
+ *
+ * Gives the same output as
+ *   cv::adaptiveThreshold(grey,out,255,ADAPTIVE_THRESH_MEAN_C,THRESH_BINARY_INV,blockSize,C)
+ * but with no intermediate mean image. Column sums are rolled down the image one row at a time, the box sum of
+ * every pixel is the difference of two prefix sums of the current column sums, and the comparison with the pixel
+ * is done on integers, so the rounded mean used by OpenCV is reproduced exactly:
+ *   out=255  <=>  round(sum/A) >= src+floor(C)  <=>  2*sum >= A*(2*(src+floor(C))-1)
+ * where A=blockSize*blockSize (A is odd, so there are no ties). Borders are replicated as in OpenCV.
+ *
+ * In subsampled mode the box sums are only computed on even rows and reused on the following odd row. The output
+ * is then an approximation, which is enough for the high speed modes of MarkerDetector.
+ *
+ * The buffers are kept between calls, so an instance should not be shared among threads.
+ */
+class AdaptiveThreshold
+{
+public:
+    AdaptiveThreshold();
+
+    /**
+     * @param grey input image, CV_8UC1
+     * @param out output image, CV_8UC1, 255 where the pixel is darker than the local mean minus C
+     * @param blockSize odd size of the neighbourhood, >=3
+     * @param C constant subtracted from the mean
+     * @param subsample compute the local mean only on even rows
+     */
+    void apply(const cv::Mat &grey,cv::Mat &out,int blockSize,double C,bool subsample=false)throw (cv::Exception);
+
+private:
+    std::vector<int> _colSums; //sum of the blockSize rows around the current one, per column
+    std::vector<int> _prefix;  //prefix sums of _colSums with the borders replicated
+    std::vector<int> _boxSums; //box sum of every pixel of the current row
+    std::vector<uchar> _zeros; //row of zeros, subtracted while the first column sums are built
+
+    void rollColumns(const uchar *add,const uchar *sub,int cols);
+    void boxRow(int cols,int radius);
+    void compareRow(const uchar *src,uchar *dst,int cols,int area,int delta);
+};
+
+}
+
+#endif // aruco_ADAPTIVETHRESHOLD_HPP
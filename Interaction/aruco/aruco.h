@@ -129,6 +129,8 @@ For testing the applications, the library provides videos and the corresponding
 */
 
 #include "markerdetector.h"
+#include "markertracker.h"
+#include "planarposesolver.h"
 #include "boarddetector.h"
 #include "cvdrawingutils.h"
 
@@ -265,72 +265,137 @@ cv::Mat  FiducidalMarkers::createBoardImage_Frame( Size gridSize,int MarkerSize,
 
     return tableImage;
 }
-/************************************
- *
- *
- *
- *
- ************************************/
-Mat FiducidalMarkers::rotate(const Mat  &in)
+/**Cell (y,x) of the 5x5 inner code is the bit 24-(y*5+x), so each row is a 5 bits word with x=0 as its most
+ * significative bit, as the ids used in createMarkerImage
+ */
+static unsigned int rotateBits(unsigned int bits)
 {
-    Mat out;
-    in.copyTo(out);
-    for (int i=0;i<in.rows;i++)
+    //same as rotating the matrix with out(i,j)=in(4-j,i)
+    unsigned int out=0;
+    for (int i=0;i<5;i++)
+        for (int j=0;j<5;j++)
+            if ( ( bits>>(24-((4-j)*5+i)) ) & 0x0001 ) out|=1<<(24-(i*5+j));
+    return out;
+}
+
+/**Hamming distance to the nearest valid marker in the same rotation, row by row
+ */
+static int hammDistBits(unsigned int bits)
+{
+    int ids[4]={0x10,0x17,0x09,0x0e};
+    int dist=0;
+    for (int y=0;y<5;y++)
     {
-        for (int j=0;j<in.cols;j++)
+        int row=(bits>>5*(4-y)) & 0x001f;
+        int minSum=5;
+        for (int p=0;p<4;p++)
         {
-            out.at<uchar>(i,j)=in.at<uchar>(in.cols-j-1,i);
+            int sum=0;
+            for (int diff=row^ids[p];diff!=0;diff&=diff-1) sum++;
+            if (minSum>sum) minSum=sum;
         }
+        dist+=minSum;
     }
-    return out;
+    return dist;
 }
 
-
-/************************************
- *
- *
- *
- *
- ************************************/
-int FiducidalMarkers::hammDistMarker(Mat  bits)
+/**The 1024 valid markers in their four rotations, as an open addressing hash table from the packed bits to
+ * the id and the number of rotations needed. Also keeps rotateBits and hammDistBits tabulated by row
+ */
+class FiducidalCodeTable
 {
-    int ids[4][5]=
+public:
+    FiducidalCodeTable()
     {
-        {
-            1,0,0,0,0
-        }
-        ,
-        {
-            1,0,1,1,1
+        for (unsigned int v=0;v<32;v++) {
+            rowDist[v]=hammDistBits(v | 0x10<<5 | 0x10<<10 | 0x10<<15 | 0x10<<20);//the other rows are valid
+            for (int y=0;y<5;y++) rowRotated[y][v]=rotateBits(v<<5*(4-y));
         }
-        ,
-        {
-            0,1,0,0,1
-        }
-        ,
+
+        for (unsigned int i=0;i<nSlots;i++) keys[i]=empty;
+        int ids[4]={0x10,0x17,0x09,0x0e};
+        for (int id=0;id<1024;id++)
         {
-            0, 1, 1, 1, 0
+            unsigned int word=0;
+            for (int y=0;y<5;y++) word=(word<<5) | ids[(id>>2*(4-y)) & 0x0003];
+            //bits that need nRotations rotations to become word. A symmetric marker is found with the
+            //lowest number of rotations, so they are inserted from 3 to 0 overwriting the previous ones
+            unsigned int rotated[4];
+            rotated[0]=word;
+            for (int r=1;r<4;r++) rotated[r]=rotateBits(rotated[r-1]);
+            for (int nRotations=3;nRotations>=0;nRotations--)
+                insert(rotated[(4-nRotations)%4],id | nRotations<<10);
         }
-    };
-    int dist=0;
+    }
 
-    for (int y=0;y<5;y++)
+    bool find(unsigned int bits,int &id,int &nRotations) const
     {
-        int minSum=1e5;
-        //hamming distance to each possible word
-        for (int p=0;p<4;p++)
+        for (unsigned int i=slot(bits);keys[i]!=empty;i=(i+1)%nSlots)
+            if (keys[i]==bits) {
+                id=values[i] & 0x03ff;
+                nRotations=values[i]>>10;
+                return true;
+            }
+        return false;
+    }
+
+    unsigned int rotate(unsigned int bits) const
+    {
+        unsigned int out=0;
+        for (int y=0;y<5;y++) out|=rowRotated[y][(bits>>5*(4-y)) & 0x001f];
+        return out;
+    }
+
+    int hammDist(unsigned int bits) const
+    {
+        int dist=0;
+        for (int y=0;y<5;y++) dist+=rowDist[(bits>>5*(4-y)) & 0x001f];
+        return dist;
+    }
+
+private:
+    static const unsigned int nSlots=8192;//twice the number of words, so the chains stay short
+    static const unsigned int empty=0xffffffff;
+    static unsigned int slot(unsigned int bits) { return (bits*2654435761u)>>19; }
+
+    void insert(unsigned int bits,unsigned short value)
+    {
+        unsigned int i=slot(bits);
+        while (keys[i]!=empty && keys[i]!=bits) i=(i+1)%nSlots;
+        keys[i]=bits;
+        values[i]=value;
+    }
+
+    unsigned int keys[nSlots];
+    unsigned short values[nSlots];//id | nRotations<<10
+    unsigned int rowRotated[5][32];//rotateBits of each row value alone
+    unsigned char rowDist[32];//distance of each row value to the nearest valid row
+};
+
+/**Same result as checking the hamming distance of the four rotations, but with a single search in the table of
+ * valid markers
+ */
+int FiducidalMarkers::decode(unsigned int bits,int &nRotations)
+{
+    //built on the first call, the initialization of local statics is thread safe
+    static const FiducidalCodeTable table;
+    int id;
+    if (table.find(bits,id,nRotations)) return id;
+
+    //not a marker, nRotations is the rotation nearest to a valid one
+    int minDist=table.hammDist(bits);
+    nRotations=0;
+    for (int i=1;i<4;i++)
+    {
+        bits=table.rotate(bits);
+        int dist=table.hammDist(bits);
+        if (dist<minDist)
         {
-            int sum=0;
-            //now, count
-            for (int x=0;x<5;x++)
-                sum+=  bits.at<uchar>(y,x) == ids[p][x]?0:1;
-            if (minSum>sum) minSum=sum;
+            minDist=dist;
+            nRotations=i;
         }
-        //do the and
-        dist+=minSum;
     }
-
-    return dist;
+    return -1;
 }
 
 /************************************
@@ -363,11 +428,8 @@ int FiducidalMarkers::analyzeMarkerImage(Mat &grey,int &nRotations)
         }
     }
 
-    //now,
-    vector<int> markerInfo(5);
-    Mat _bits=Mat::zeros(5,5,CV_8UC1);
-    //get information(for each inner square, determine if it is  black or white)
-
+    //get information(for each inner square, determine if it is  black or white), packed row by row
+    unsigned int bits=0;
     for (int y=0;y<5;y++)
     {
 
@@ -377,102 +439,15 @@ int FiducidalMarkers::analyzeMarkerImage(Mat &grey,int &nRotations)
             int Ystart=(y+1)*(swidth);
             Mat square=grey(Rect(Xstart,Ystart,swidth,swidth));
             int nZ=countNonZero(square);
-            if (nZ> (swidth*swidth) /2)  _bits.at<uchar>( y,x)=1;
-        }
-    }
-// 		printMat<uchar>( _bits,"or mat");
-
-    //checkl all possible rotations
-    Mat _bitsFlip;
-    Mat Rotations[4];
-    Rotations[0]=_bits;
-    int dists[4];
-    dists[0]=hammDistMarker( Rotations[0]) ;
-    pair<int,int> minDist( dists[0],0);
-    for (int i=1;i<4;i++)
-    {
-        //rotate
-        Rotations[i]=rotate(Rotations[i-1]);
-        //get the hamming distance to the nearest possible word
-        dists[i]=hammDistMarker( Rotations[i]) ;
-        if (dists[i]<minDist.first)
-        {
-            minDist.first=  dists[i];
-            minDist.second=i;
+            bits<<=1;
+            if (nZ> (swidth*swidth) /2)  bits|=1;
         }
     }
-// 		        printMat<uchar>( Rotations [ minDist.second]);
-// 		 	cout<<"MinDist="<<minDist.first<<" "<<minDist.second<<endl;
-
-    nRotations=minDist.second;
-    if (minDist.first!=0)	 //FUTURE WORK: correct if any error
-        return -1;
-    else {//Get id of the marker
-        int MatID=0;
-        cv::Mat bits=Rotations [ minDist.second];
-        for (int y=0;y<5;y++)
-        {
-            MatID<<=1;
-            if ( bits.at<uchar>(y,1)) MatID|=1;
-            MatID<<=1;
-            if ( bits.at<uchar>(y,3)) MatID|=1;
-        }
-        return MatID;
-    }
-}
-
 
-/************************************
- *
- *
- *
- *
- ************************************/
-bool FiducidalMarkers::correctHammMarker(Mat &bits)
-{
-    //detect this lines with errors
-    bool errors[4];
-
-    (void)errors;  // solo para que el compilador no tire el warning de variable no usada
-
-    int ids[4][5]=
-    {
-        {
-            0,0,0,0,0
-        }
-        ,
-        {
-            0,0,1,1,1
-        }
-        ,
-        {
-            1,1,0,0,1
-        }
-        ,
-        {
-            1, 1, 1, 1, 0
-        }
-    };
-
-    for (int y=0;y<5;y++)  {
-        int minSum=1e5;
-        //hamming distance to each possible word
-        for (int p=0;p<4;p++)  {
-            int sum=0;
-            //now, count
-            for (int x=0;x<5;x++)
-                sum+=  bits.at<uchar>(y,x) == ids[p][x]?0:1;
-            if (minSum>sum) minSum=sum;
-        }
-        if (minSum!=0)
-            errors[y]=true;
-        else
-            errors[y]=false;
-    }
-
-    return true;
+    return decode(bits,nRotations);
 }
 
+
 /************************************
  *
  *
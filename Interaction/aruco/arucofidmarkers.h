@@ -72,6 +72,13 @@ public:
      */
     static int detect(const cv::Mat &in,int &nRotations);
 
+    /**Decoding step of detect, on the 5x5 inner cells already read
+     * @param bits cells packed row by row, cell (y,x) in the bit 24-(y*5+x), 1 for white
+     * @param nRotations as in detect. If bits is not a marker, the rotation nearest to a valid one
+     * @return -1 if bits is not a valid marker in any rotation, and its id otherwise
+     */
+    static int decode(unsigned int bits,int &nRotations);
+
     /**Similar to createMarkerImage. Instead of returning a visible image, returns a 8UC1 matrix of 0s and 1s with
      * the marker info
      */
@@ -127,10 +134,7 @@ public:
 private:
   
     static vector<int> getListOfValidMarkersIds_random(int nMarkers,vector<int> *excluded) throw (cv::Exception);
-    static  cv::Mat rotate(const cv::Mat & in);
-    static  int hammDistMarker(cv::Mat  bits);
     static  int analyzeMarkerImage(cv::Mat &grey,int &nRotations);
-    static  bool correctHammMarker(cv::Mat &bits);
 };
 
 }
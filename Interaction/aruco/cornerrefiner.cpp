@@ -0,0 +1,216 @@
+#include "cornerrefiner.h"
+#include "threadpool.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define ARUCO_CORNER_SSE2
+#endif
+
+using namespace cv;
+using namespace std;
+
+namespace aruco{
+
+//corners per chunk of the parallel loop. Refining one corner takes well under a microsecond with the default window,
+//so a few markers are not worth waking the pool
+static const int CORNERS_PER_CHUNK=32;
+
+CornerRefiner::CornerRefiner(int halfWin,int maxIters,float epsilon)throw (cv::Exception)
+{
+    if (halfWin<1 || halfWin>MAX_HALF_WIN) throw cv::Exception(9001,"halfWin out of range","CornerRefiner::CornerRefiner",__FILE__,__LINE__);
+    _halfWin=halfWin;
+    _maxIters=std::max(1,maxIters);
+    _epsilon=std::max(0.f,epsilon);
+
+    const int winSize=2*_halfWin+1;
+    _paddedWidth=(winSize+3)&~3;
+    //same weights as cv::cornerSubPix
+    vector<float> mask(winSize);
+    double coeff=1./(_halfWin*_halfWin);
+    for (int i=-_halfWin;i<=_halfWin;i++) mask[i+_halfWin]=float(exp(-i*i*coeff));
+    _weights.assign(winSize*_paddedWidth,0.f);
+    for (int i=0;i<winSize;i++)
+        for (int j=0;j<winSize;j++) _weights[i*_paddedWidth+j]=mask[i]*mask[j];
+}
+
+#ifdef ARUCO_CORNER_SSE2
+static inline __m128 load4(const uchar *p)
+{
+    int v;
+    memcpy(&v,p,4);
+    const __m128i zero=_mm_setzero_si128();
+    return _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(v),zero),zero));
+}
+#endif
+
+/************************************
+ *
+ * patch(r,c)=grey(y-_halfWin-1+r,x-_halfWin-1+c) interpolated bilinearly, for r in [0,2*_halfWin+3) and c in
+ * [0,_paddedWidth+4). Each row of the image is interpolated horizontally once and then blended with the next one
+ *
+ ************************************/
+void CornerRefiner::samplePatch(const Mat &grey,float x,float y,float *patch)const
+{
+    const int rows=2*_halfWin+3,stride=_paddedWidth+4;
+    float fx0=x-_halfWin-1,fy0=y-_halfWin-1;
+    int x0=int(floor(fx0)),y0=int(floor(fy0));
+    float ax=fx0-x0,ay=fy0-y0;
+
+    //horizontal pass on rows+1 rows of the image
+    if (x0>=0 && y0>=0 && x0+stride<grey.cols && y0+rows<grey.rows) {
+        for (int r=0;r<=rows;r++) {
+            const uchar *src=grey.ptr<uchar>(y0+r)+x0;
+            float *p=patch+r*stride;
+            int c=0;
+#ifdef ARUCO_CORNER_SSE2
+            const __m128 w0=_mm_set1_ps(1-ax),w1=_mm_set1_ps(ax);
+            for (;c<stride;c+=4)
+                _mm_storeu_ps(p+c,_mm_add_ps(_mm_mul_ps(w0,load4(src+c)),_mm_mul_ps(w1,load4(src+c+1))));
+#endif
+            for (;c<stride;c++) p[c]=(1-ax)*src[c]+ax*src[c+1];
+        }
+    }
+    else {
+        //near the border, replicate it
+        int xs[2*MAX_HALF_WIN+8];
+        for (int c=0;c<=stride;c++) xs[c]=std::min(std::max(x0+c,0),grey.cols-1);
+        for (int r=0;r<=rows;r++) {
+            const uchar *src=grey.ptr<uchar>(std::min(std::max(y0+r,0),grey.rows-1));
+            float *p=patch+r*stride;
+            for (int c=0;c<stride;c++) p[c]=(1-ax)*src[xs[c]]+ax*src[xs[c+1]];
+        }
+    }
+    //vertical pass, in place
+    for (int r=0;r<rows;r++) {
+        float *p=patch+r*stride;
+        int c=0;
+#ifdef ARUCO_CORNER_SSE2
+        const __m128 w0=_mm_set1_ps(1-ay),w1=_mm_set1_ps(ay);
+        for (;c<stride;c+=4)
+            _mm_storeu_ps(p+c,_mm_add_ps(_mm_mul_ps(w0,_mm_loadu_ps(p+c)),_mm_mul_ps(w1,_mm_loadu_ps(p+c+stride))));
+#endif
+        for (;c<stride;c++) p[c]=(1-ay)*p[c]+ay*p[c+stride];
+    }
+}
+
+/************************************
+ *
+ * sums = {sum w*gx*gx, sum w*gx*gy, sum w*gy*gy, sum w*(gx*gx*px+gx*gy*py), sum w*(gx*gy*px+gy*gy*py)}
+ * over the window, where (px,py) is the position relative to its center
+ *
+ ************************************/
+static void accumulateSystem(const float *patch,const float *weights,int halfWin,int paddedWidth,double sums[5])
+{
+    const int winSize=2*halfWin+1,cols=paddedWidth+4;
+#ifdef ARUCO_CORNER_SSE2
+    __m128 sxx=_mm_setzero_ps(),sxy=_mm_setzero_ps(),syy=_mm_setzero_ps();
+    __m128 sbx=_mm_setzero_ps(),sby=_mm_setzero_ps();
+    const __m128 firstPx=_mm_setr_ps(-halfWin,1-halfWin,2-halfWin,3-halfWin);
+    const __m128 four=_mm_set1_ps(4);
+    for (int i=0;i<winSize;i++) {
+        const float *up=patch+i*cols,*row=up+cols,*down=row+cols;
+        const float *w=weights+i*paddedWidth;
+        const __m128 py=_mm_set1_ps(i-halfWin);
+        __m128 px=firstPx;
+        for (int j=0;j<paddedWidth;j+=4) {
+            __m128 gx=_mm_sub_ps(_mm_loadu_ps(row+j+2),_mm_loadu_ps(row+j));
+            __m128 gy=_mm_sub_ps(_mm_loadu_ps(down+j+1),_mm_loadu_ps(up+j+1));
+            __m128 wgx=_mm_mul_ps(_mm_loadu_ps(w+j),gx);
+            __m128 gxx=_mm_mul_ps(wgx,gx);
+            __m128 gxy=_mm_mul_ps(wgx,gy);
+            __m128 gyy=_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(w+j),gy),gy);
+            sxx=_mm_add_ps(sxx,gxx);
+            sxy=_mm_add_ps(sxy,gxy);
+            syy=_mm_add_ps(syy,gyy);
+            sbx=_mm_add_ps(sbx,_mm_add_ps(_mm_mul_ps(gxx,px),_mm_mul_ps(gxy,py)));
+            sby=_mm_add_ps(sby,_mm_add_ps(_mm_mul_ps(gxy,px),_mm_mul_ps(gyy,py)));
+            px=_mm_add_ps(px,four);
+        }
+    }
+    float lanes[5][4];
+    _mm_storeu_ps(lanes[0],sxx);
+    _mm_storeu_ps(lanes[1],sxy);
+    _mm_storeu_ps(lanes[2],syy);
+    _mm_storeu_ps(lanes[3],sbx);
+    _mm_storeu_ps(lanes[4],sby);
+    for (int k=0;k<5;k++) sums[k]=double(lanes[k][0])+lanes[k][1]+lanes[k][2]+lanes[k][3];
+#else
+    //per column sums, so that the compiler can vectorize the inner loop
+    float acc[5][2*CornerRefiner::MAX_HALF_WIN+4];
+    for (int k=0;k<5;k++) std::fill(acc[k],acc[k]+paddedWidth,0.f);
+    for (int i=0;i<winSize;i++) {
+        const float *up=patch+i*cols,*row=up+cols,*down=row+cols;
+        const float *w=weights+i*paddedWidth;
+        const float py=i-halfWin;
+        for (int j=0;j<paddedWidth;j++) {
+            float gx=row[j+2]-row[j],gy=down[j+1]-up[j+1];
+            float px=j-halfWin;
+            float gxx=w[j]*gx*gx,gxy=w[j]*gx*gy,gyy=w[j]*gy*gy;
+            acc[0][j]+=gxx;
+            acc[1][j]+=gxy;
+            acc[2][j]+=gyy;
+            acc[3][j]+=gxx*px+gxy*py;
+            acc[4][j]+=gxy*px+gyy*py;
+        }
+    }
+    for (int k=0;k<5;k++) {
+        sums[k]=0;
+        for (int j=0;j<paddedWidth;j++) sums[k]+=acc[k][j];
+    }
+#endif
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+int CornerRefiner::refineCorner(const Mat &grey,Point2f &corner)const
+{
+    if (!(corner.x>=0 && corner.y>=0 && corner.x<grey.cols && corner.y<grey.rows)) return 0;
+
+    float patch[(2*MAX_HALF_WIN+4)*(2*MAX_HALF_WIN+6)];
+    const float eps2=_epsilon*_epsilon;
+    Point2f cur=corner;
+    int iter=0;
+    while (iter<_maxIters) {
+        iter++;
+        samplePatch(grey,cur.x,cur.y,patch);
+        double s[5];
+        accumulateSystem(patch,&_weights[0],_halfWin,_paddedWidth,s);
+        //solve [a b;b c] d = [bx;by]
+        double a=s[0],b=s[1],c=s[2];
+        double det=a*c-b*b;
+        if (fabs(det)<=DBL_EPSILON*DBL_EPSILON) break;
+        double scale=1./det;
+        float dx=float((c*s[3]-b*s[4])*scale),dy=float((a*s[4]-b*s[3])*scale);
+        cur.x+=dx;
+        cur.y+=dy;
+        if (cur.x<0 || cur.y<0 || cur.x>=grey.cols || cur.y>=grey.rows) break;
+        if (dx*dx+dy*dy<=eps2) break;
+    }
+    if (fabs(cur.x-corner.x)<=_halfWin && fabs(cur.y-corner.y)<=_halfWin) corner=cur;
+    return iter;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void CornerRefiner::refine(const Mat &grey,vector<Point2f> &corners)const throw (cv::Exception)
+{
+    if (grey.type()!=CV_8UC1) throw cv::Exception(9001,"grey.type()!=CV_8UC1","CornerRefiner::refine",__FILE__,__LINE__);
+    //each corner is independent and written only by its own iteration
+    parallel_for(0,corners.size(),[&](int begin,int end) {
+        for (int i=begin;i<end;i++) refineCorner(grey,corners[i]);
+    },CORNERS_PER_CHUNK);
+}
+
+}
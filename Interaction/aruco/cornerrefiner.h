@@ -0,0 +1,64 @@
+#ifndef aruco_CORNERREFINER_HPP
+#define aruco_CORNERREFINER_HPP
+
+#include <vector>
+#include <opencv2/core/core.hpp> // Basic OpenCV structures (cv::Mat)
+#include "exports.h"
+
+namespace aruco
+{
+
+/**
+ * Subpixel refinement of corners, used by all the refinement methods of MarkerDetector.
+ *
+ * Same iteration as cv::cornerSubPix: the corner q is moved to the point that minimizes the sum over the window of
+ *   w(p)*(grad(p)·(p-q))^2
+ * that is, the 2x2 system sum(w*g*g^T) q = sum(w*g*g^T p) with gaussian weights w. Only a patch of (2*halfWin+3)^2
+ * pixels around each corner is sampled (bilinearly, replicating the image borders as cv::getRectSubPix) and the
+ * gradients are central differences computed on that patch, never on the whole image. The five sums of the system
+ * are accumulated four columns at a time, with the window padded with zero weights to a multiple of four.
+ *
+ * A corner stops as soon as it moves less than epsilon, when the system is singular (flat window) or when it leaves
+ * the image. If it ends farther than halfWin from where it started, it is left where it was.
+ *
+ * refine() is const, so an instance can be shared among threads.
+ */
+class ARUCO_EXPORTS CornerRefiner
+{
+public:
+    /**
+     * @param halfWin half the side of the search window, the window is (2*halfWin+1)^2. In [1,MAX_HALF_WIN]
+     * @param maxIters maximum number of iterations per corner
+     * @param epsilon the iterations of a corner stop when it moves less than this
+     */
+    CornerRefiner(int halfWin=2,int maxIters=3,float epsilon=0.05)throw (cv::Exception);
+
+    enum {MAX_HALF_WIN=15};
+
+    /**
+     * Refines the corners in place. They are processed in parallel with aruco::parallel_for
+     * @param grey CV_8UC1 image
+     */
+    void refine(const cv::Mat &grey,std::vector<cv::Point2f> &corners)const throw (cv::Exception);
+
+    /**
+     * Refines a single corner. Returns the number of iterations done (0 if the corner is out of the image)
+     */
+    int refineCorner(const cv::Mat &grey,cv::Point2f &corner)const;
+
+    int getHalfWin()const{return _halfWin;}
+    int getMaxIters()const{return _maxIters;}
+    float getEpsilon()const{return _epsilon;}
+
+private:
+    int _halfWin,_maxIters;
+    float _epsilon;
+    int _paddedWidth;           //2*_halfWin+1 rounded up to a multiple of 4
+    std::vector<float> _weights;//gaussian weights, (2*_halfWin+1) rows of _paddedWidth, 0 in the padding
+
+    void samplePatch(const cv::Mat &grey,float x,float y,float *patch)const;
+};
+
+}
+
+#endif // aruco_CORNERREFINER_HPP
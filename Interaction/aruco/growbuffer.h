@@ -0,0 +1,37 @@
+#ifndef aruco_GROWBUFFER_HPP
+#define aruco_GROWBUFFER_HPP
+
+#include <vector>
+#include <algorithm>
+
+namespace aruco
+{
+
+/************************************
+ *
+ * Resizes a buffer that is kept between frames to n elements. When it has to grow it takes room for 2n, so that the
+ * next frames, with a few more elements, do not reallocate it again: assign() and resize() grow to the exact size
+ *
+ ************************************/
+template<typename T>
+void resizeBuffer ( std::vector<T> &buffer,size_t n )
+{
+    if ( n>buffer.capacity() ) buffer.reserve ( 2*n );
+    buffer.resize ( n );
+}
+
+/************************************
+ *
+ * assign(n,value) with the growth of resizeBuffer()
+ *
+ ************************************/
+template<typename T>
+void assignBuffer ( std::vector<T> &buffer,size_t n,const typename std::vector<T>::value_type &value )
+{
+    resizeBuffer ( buffer,n );
+    std::fill ( buffer.begin(),buffer.end(),value );
+}
+
+}
+
+#endif
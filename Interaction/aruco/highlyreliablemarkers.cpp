@@ -28,24 +28,27 @@ or implied, of Rafael Muñoz Salinas.
 
 #include "highlyreliablemarkers.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HRM_X86
+#endif
+
 namespace aruco {
 
   // static variables from HighlyReliableMarkers. Need to be here to avoid linking errors
   Dictionary HighlyReliableMarkers::_D;
   HighlyReliableMarkers::BalancedBinaryTree HighlyReliableMarkers::_binaryTree;
+  HighlyReliableMarkers::MultiIndexHashing HighlyReliableMarkers::_hashing;
   unsigned int HighlyReliableMarkers::_n, HighlyReliableMarkers::_ncellsBorder, HighlyReliableMarkers::_correctionDistance;
   int HighlyReliableMarkers::_swidth;
 
 
   /**
   */
-  MarkerCode::MarkerCode(unsigned int n) {
-    // resize bits vectors and initialize to 0
-    for(unsigned int i=0; i<4; i++) {
-      _bits[i].resize(n*n); 
-      for(unsigned int j=0; j<_bits[i].size(); j++) _bits[i][j]=0;
-      _ids[i] = 0; // ids are also 0
-    }
+  MarkerCode::MarkerCode(unsigned int n) throw (cv::Exception) {
+    // n*n bits must fit in a 64 bit word, larger shifts would be undefined
+    if(n>8) throw cv::Exception(9001,"marker size must not be higher than 8","MarkerCode::MarkerCode",__FILE__,__LINE__);
+    // initialize all rotations to 0
+    for(unsigned int i=0; i<4; i++) _bits[i] = 0;
     _n = n;
   };
   
@@ -54,10 +57,7 @@ namespace aruco {
    */
   MarkerCode::MarkerCode(const MarkerCode& MC)
   {
-    for(unsigned int i=0; i<4; i++) {
-      _bits[i] = MC._bits[i];
-      _ids[i] = MC._ids[i];
-    }
+    for(unsigned int i=0; i<4; i++) _bits[i] = MC._bits[i];
     _n = MC._n;
   }
 
@@ -75,10 +75,9 @@ namespace aruco {
 	else if(i==2) { y=n()-y-1; x=n()-x-1; }
     else if(i==3) { unsigned int aux=y; y=n()-x-1; x=aux; }
     unsigned int rotPos = y*n()+x; // calculate position in the unidimensional string
-	_bits[i][rotPos] = val; // modify value
-	// update identifier in that rotation
-    if(val==true) _ids[i] += (unsigned int)pow(float(2),float(rotPos)); // if 1, add 2^pos
-    else _ids[i] -= (unsigned int)pow(float(2),float(rotPos)); // if 0, substract 2^pos
+	// modify value, the identifier in that rotation is updated with it
+    if(val==true) _bits[i] |= uint64_t(1)<<rotPos;
+    else _bits[i] &= ~(uint64_t(1)<<rotPos);
       }   
     }
   }
@@ -86,8 +85,8 @@ namespace aruco {
   
   /**
    */
-  unsigned int MarkerCode::selfDistance(unsigned int &minRot) {
-    unsigned int res = _bits[0].size(); // init to n*n (max value)
+  unsigned int MarkerCode::selfDistance(unsigned int &minRot) const {
+    unsigned int res = size(); // init to n*n (max value)
     for(unsigned int i=1; i<4; i++) { // self distance is not calculated for rotation 0
       unsigned int hammdist = hammingDistance(_bits[0], _bits[i]);
       if(hammdist<res) {
@@ -101,10 +100,10 @@ namespace aruco {
   
   /**
    */
-  unsigned int MarkerCode::distance(MarkerCode m, unsigned int &minRot) {
-    unsigned int res = _bits[0].size(); // init to n*n (max value)
+  unsigned int MarkerCode::distance(const MarkerCode &m, unsigned int &minRot) const {
+    unsigned int res = size(); // init to n*n (max value)
     for(unsigned int i=0; i<4; i++) {
-      unsigned int hammdist = hammingDistance(_bits[0], m.getRotation(i));
+      unsigned int hammdist = hammingDistance(_bits[0], m._bits[i]);
       if(hammdist<res) {
 	minRot = i;
 	res = hammdist;
@@ -126,7 +125,7 @@ namespace aruco {
 
   /**
    */
-  std::string MarkerCode::toString()
+  std::string MarkerCode::toString() const
   {
     std::string s;
     s.resize(size());
@@ -140,7 +139,7 @@ namespace aruco {
   
   /**
    */
-  cv::Mat MarkerCode::getImg(unsigned int pixSize) {
+  cv::Mat MarkerCode::getImg(unsigned int pixSize) const {
     const unsigned int borderSize=1;
     unsigned int nrows = n()+2*borderSize;
     if(pixSize%nrows != 0) pixSize = pixSize + nrows - pixSize%nrows;
@@ -149,7 +148,7 @@ namespace aruco {
     // double for to go over all the cells
     for(unsigned int i=0; i<n(); i++) {
       for(unsigned int j=0; j<n(); j++) {
-	if(_bits[0][i*n()+j]!=0) { // just draw if it is 1, since the image has been init to 0
+	if(get(i*n()+j)) { // just draw if it is 1, since the image has been init to 0
 	  // double for to go over all the pixels in the cell
       for(unsigned int k=0; k<cellSize; k++) {
         for(unsigned int l=0; l<cellSize; l++) {
@@ -163,15 +162,6 @@ namespace aruco {
   }  
   
   
-  /**
-   */
-  unsigned int MarkerCode::hammingDistance(std::vector<bool> m1, std::vector<bool> m2) {
-    unsigned int res=0;
-    for(unsigned int i=0; i<m1.size(); i++)
-      if(m1[i]!=m2[i]) res++;
-    return res;
-  };  
-  
   
   
   
@@ -179,13 +169,14 @@ namespace aruco {
   
    /**
    */
-  bool Dictionary::fromFile(std::string filename) {
+  bool Dictionary::fromFile(std::string filename) throw (cv::Exception) {
     cv::FileStorage fs(filename, cv::FileStorage::READ);
-    int nmarkers, markersize;
+    int nmarkers=0, markersize=0;
     
     // read number of markers
     fs["nmarkers"] >> nmarkers; // cardinal of D
     fs["markersize"] >> markersize; // n
+    if(markersize<0 || markersize>8) throw cv::Exception(9001,"markersize of "+filename+" must be in [0,8]","Dictionary::fromFile",__FILE__,__LINE__);
        
     // read each marker info
     for (int i=0; i<nmarkers; i++) {  
@@ -217,7 +208,7 @@ namespace aruco {
   
   /**
    */
-  unsigned int Dictionary::distance(MarkerCode m, unsigned int &minMarker, unsigned int &minRot) {
+  unsigned int Dictionary::distance(const MarkerCode &m, unsigned int &minMarker, unsigned int &minRot) const {
     unsigned int res = m.size();
     for(unsigned int i=0; i<size(); i++) {
       unsigned int minRotAux;
@@ -234,7 +225,7 @@ namespace aruco {
   
   /**
    */
-  unsigned int Dictionary::minimunDistance()
+  unsigned int Dictionary::minimunDistance() const
   {
     if(size()==0) return 0;
     unsigned int minDist = (*this)[0].size();
@@ -270,6 +261,7 @@ namespace aruco {
     _correctionDistance = (unsigned int)floor( (_D.minimunDistance()-1)/2. ); //maximun correction distance
     
     _binaryTree.loadDictionary(&D);   
+    _hashing.loadDictionary(&D, _correctionDistance);
     
     return true;
     
@@ -321,9 +313,9 @@ namespace aruco {
     //       }
     //     }
     
-    // correct errors
+    // correct errors (same result as _D.distance(candidate, minMarker, minRot) <= _correctionDistance)
     unsigned int minMarker, minRot;
-    if(_D.distance(candidate, minMarker, minRot) <= _correctionDistance) {
+    if(_hashing.findNearest(candidate, minMarker, minRot)) {
       nRotations = minRot;
       //return minMarker;
      return _D[minMarker].getId();
@@ -398,6 +390,7 @@ namespace aruco {
     // calculate position of the root element
     unsigned int rootIdx = _orderD.size()/2;
     visited[rootIdx] = true; // mark it as visited
+    _root = rootIdx;
     
     // auxiliar vector to store the ids intervals (max and min) during the creation of the tree
     std::vector< std::pair<unsigned int, unsigned int> > intervals;
@@ -477,4 +470,112 @@ namespace aruco {
   }
   
   
+
+  
+  /**
+   */
+  void HighlyReliableMarkers::MultiIndexHashing::loadDictionary(Dictionary *D, unsigned int maxDistance) {
+    _codes.resize(D->size());
+    for(unsigned int i=0; i<D->size(); i++) _codes[i] = (*D)[i].getCode();
+    _maxDistance = maxDistance;
+    
+    // maxDistance+1 chunks, with no more than 16 bits each so the tables can be indexed directly by chunk value
+    unsigned int nbits = D->size()>0 ? (*D)[0].size() : 0;
+    unsigned int nchunks = std::max(maxDistance+1, (nbits+15)/16);
+    _shifts.clear();
+    _masks.clear();
+    _offsets.clear();
+    _entries.clear();
+    // with too many chunks for the bits every code would be in range, or every marker checked several times,
+    // then findNearest searchs the whole dictionary
+    if(nchunks>nbits || nchunks>(1u<<(nbits/nchunks))) return;
+    
+    _shifts.resize(nchunks);
+    _masks.resize(nchunks);
+    _offsets.resize(nchunks);
+    _entries.resize(nchunks);
+    for(unsigned int j=0; j<nchunks; j++) {
+      unsigned int begin = j*nbits/nchunks, end = (j+1)*nbits/nchunks;
+      _shifts[j] = begin;
+      _masks[j] = (1u<<(end-begin))-1;
+      
+      // counting sort of the markers by the value of this chunk
+      std::vector<unsigned int> &offsets = _offsets[j];
+      offsets.assign(_masks[j]+2, 0);
+      for(unsigned int i=0; i<_codes.size(); i++) offsets[((_codes[i]>>begin)&_masks[j])+1]++;
+      for(unsigned int k=1; k<offsets.size(); k++) offsets[k] += offsets[k-1];
+      std::vector<unsigned int> next(offsets.begin(), offsets.end()-1);
+      _entries[j].resize(_codes.size());
+      for(unsigned int i=0; i<_codes.size(); i++) _entries[j][ next[(_codes[i]>>begin)&_masks[j]]++ ] = i;
+    }
+  }
+  
+  
+  /**
+   * Without -mpopcnt every MarkerCode::hammingDistance would be a call to libgcc, so on x86 cpus with the popcnt
+   * instruction the search runs in a copy built for it
+   */
+  bool HighlyReliableMarkers::MultiIndexHashing::findNearest(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const {
+#ifdef HRM_X86
+    static const bool popcnt = __builtin_cpu_supports("popcnt");
+    if(popcnt) return searchPopcnt(m, orgPos, rot);
+#endif
+    return search(m, orgPos, rot);
+  }
+  
+  
+  /**
+   */
+#ifdef HRM_X86
+  inline __attribute__((always_inline))
+#endif
+  bool HighlyReliableMarkers::MultiIndexHashing::search(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const {
+    // ties are resolved as in Dictionary::distance: lower position first, then lower rotation. The best marker is
+    // kept in locals, orgPos and rot are only written when one is in range
+    unsigned int res = _maxDistance+1, bestPos = 0, bestRot = 0;
+    for(unsigned int r=0; r<4; r++) {
+      uint64_t code = m.getCode(r);
+      if(_shifts.empty()) { // no tables, compare with all the dictionary
+	for(unsigned int i=0; i<_codes.size(); i++) {
+	  unsigned int distance = MarkerCode::hammingDistance(_codes[i], code);
+	  if(distance<res || (distance==res && i<bestPos)) {
+	    res = distance;
+	    bestPos = i;
+	    bestRot = r;
+	  }
+	}
+	continue;
+      }
+      // only the markers with an identical chunk can be in range (a marker can be checked once per chunk)
+      for(unsigned int j=0; j<_shifts.size(); j++) {
+	unsigned int value = (code>>_shifts[j])&_masks[j];
+	for(unsigned int k=_offsets[j][value]; k<_offsets[j][value+1]; k++) {
+	  unsigned int i = _entries[j][k];
+	  unsigned int distance = MarkerCode::hammingDistance(_codes[i], code);
+	  if(distance<res || (distance==res && i<bestPos)) {
+	    res = distance;
+	    bestPos = i;
+	    bestRot = r;
+	  }
+	}
+      }
+    }
+    if(res>_maxDistance) return false;
+    orgPos = bestPos;
+    rot = bestRot;
+    return true;
+  }
+  
+  
+  /**
+   * search inlined with MarkerCode::hammingDistance, so that __builtin_popcountll is a single instruction
+   */
+#ifdef HRM_X86
+  __attribute__((target("popcnt")))
+#endif
+  bool HighlyReliableMarkers::MultiIndexHashing::searchPopcnt(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const {
+    return search(m, orgPos, rot);
+  }
+  
+  
 };
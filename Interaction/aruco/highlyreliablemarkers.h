@@ -33,6 +33,7 @@ or implied, of Rafael Muñoz Salinas.
 #include <vector>
 #include <math.h>
 #include <string>
+#include <stdint.h>
 #include <opencv2/core/core.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
 #include "exports.h"
@@ -44,15 +45,16 @@ namespace aruco {
 /**
  * This class represent the internal code of a marker
  * It does not include marker borders
+ * The bits of the four rotations are packed in 64 bit words (bit pos=y*n+x), so n can not be higher than 8
  * 
  */
 class ARUCO_EXPORTS MarkerCode {
 public:
   
   /**
-   * Constructor, receive dimension of marker
+   * Constructor, receive dimension of marker. Throws cv::Exception if n>8
    */
-  MarkerCode(unsigned int n=0);
+  MarkerCode(unsigned int n=0) throw (cv::Exception);
   
   /**
    * Copy Constructor
@@ -62,23 +64,32 @@ public:
   /**
    * Get id of a specific rotation as the number obtaiend from the concatenation of all the bits
    */
-  unsigned int getId(unsigned int rot=0)  {
-      return _ids[rot];
+  unsigned int getId(unsigned int rot=0) const {
+      return (unsigned int)_bits[rot];
+  }
+  
+  /**
+   * Get the packed bits of a specific rotation, bit pos=y*n+x
+   */
+  uint64_t getCode(unsigned int rot=0) const {
+      return _bits[rot];
   }
   
   /**
    * Get a bit value in a specific rotation.
    * The marker is refered as a unidimensional string of bits, i.e. pos=y*n+x
    */
-  bool get(unsigned int pos, unsigned int rot=0)  {
-      return _bits[rot][pos];
+  bool get(unsigned int pos, unsigned int rot=0) const {
+      return (_bits[rot]>>pos)&1;
   }
   
   /**
    * Get the string of bits for a specific rotation
    */
-  std::vector<bool> getRotation(unsigned int rot)  {
-      return _bits[rot];
+  std::vector<bool> getRotation(unsigned int rot) const {
+      std::vector<bool> res(size());
+      for(unsigned int i=0; i<res.size(); i++) res[i] = get(i,rot);
+      return res;
   }
   
   /**
@@ -94,14 +105,14 @@ public:
   /**
    * Return the full size of the marker (n*n)
    */
-  unsigned int size()  {
+  unsigned int size() const {
       return n()*n();
   }
   
   /**
    * Return the value of marker dimension (n)
    */
-  unsigned int n()  {
+  unsigned int n() const {
       return _n;
   }
   
@@ -109,13 +120,13 @@ public:
    * Return the self distance S(m) of the marker (Equation 8)
    * Assign to minRot the rotation of minimun hamming distance
    */
-  unsigned int selfDistance(unsigned int &minRot);
+  unsigned int selfDistance(unsigned int &minRot) const;
   
   /**
    * Return the self distance S(m) of the marker (Equation 8)
    * Same method as selfDistance(uint &minRot), except this doesnt return minRot value.
    */
-  unsigned int selfDistance()  {
+  unsigned int selfDistance() const {
       unsigned int minRot;
       return selfDistance(minRot);
   }
@@ -124,13 +135,13 @@ public:
    * Return the rotation invariant distance to another marker, D(m1, m2) (Equation 6)
    * Assign to minRot the rotation of minimun hamming distance. The rotation refers to the marker passed as parameter, m
    */
-  unsigned int distance(MarkerCode m, unsigned int &minRot);
+  unsigned int distance(const MarkerCode &m, unsigned int &minRot) const;
   
   /**
    * Return the rotation invariant distance to another marker, D(m1, m2) (Equation 6)
    * Same method as distance(MarkerCode m, uint &minRot), except this doesnt return minRot value.
    */
-  unsigned int distance(MarkerCode m) {
+  unsigned int distance(const MarkerCode &m) const {
       unsigned int minRot;
       return distance(m, minRot);
   }
@@ -143,24 +154,35 @@ public:
   /**
    * Convert marker to a string of "0"s and "1"s
    */
-  std::string toString();
+  std::string toString() const;
   
   
   /**
    * Convert marker to a cv::Mat image of (pixSize x pixSize) pixels
    * It adds a black border of one cell size
    */
-  cv::Mat getImg(unsigned int pixSize);
-  
-private:
-  unsigned int _ids[4]; // ids in the four rotations
-  std::vector<bool> _bits[4]; // bit strings in the four rotations
-  unsigned int _n; // marker dimension
+  cv::Mat getImg(unsigned int pixSize) const;
   
   /**
-   * Return hamming distance between two bit vectors
+   * Return hamming distance between two packed bit strings. With gcc it is the popcnt instruction only where the
+   * code is built for it (-mpopcnt, or inlined in MultiIndexHashing::findNearest on cpus that have it), otherwise
+   * a library call
    */
-  unsigned int hammingDistance(std::vector<bool> m1, std::vector<bool> m2);
+  static unsigned int hammingDistance(uint64_t m1, uint64_t m2) {
+#if defined(__GNUC__)
+      return __builtin_popcountll(m1^m2);
+#else
+      uint64_t x = m1^m2;
+      x = x - ((x>>1) & 0x5555555555555555ULL);
+      x = (x & 0x3333333333333333ULL) + ((x>>2) & 0x3333333333333333ULL);
+      x = (x + (x>>4)) & 0x0F0F0F0F0F0F0F0FULL;
+      return (unsigned int)((x*0x0101010101010101ULL)>>56);
+#endif
+  }
+  
+private:
+  uint64_t _bits[4]; // bit strings in the four rotations, the id of each rotation is its lower 32 bits
+  unsigned int _n; // marker dimension
   
 };
 
@@ -174,9 +196,9 @@ class ARUCO_EXPORTS Dictionary : public std::vector<MarkerCode> {
 public: 
   
   /**
-   * Read dictionary from a .yml opencv file
+   * Read dictionary from a .yml opencv file. Throws cv::Exception if its markersize is higher than 8
    */
-  bool fromFile(std::string filename);
+  bool fromFile(std::string filename) throw (cv::Exception);
   
   /**
    * Write dictionary to a .yml opencv file
@@ -188,13 +210,13 @@ public:
    * Assign to minMarker the marker index in the dictionary with minimun distance to m
    * Assign to minRot the rotation of minimun hamming distance. The rotation refers to the marker passed as parameter, m
    */
-  unsigned int distance(MarkerCode m, unsigned int &minMarker, unsigned int &minRot);
+  unsigned int distance(const MarkerCode &m, unsigned int &minMarker, unsigned int &minRot) const;
   
   /**
    * Return the distance of a marker to the dictionary, D(m,D) (Equation 7)
    * Same method as distance(MarkerCode m, uint &minMarker, uint &minRot), except this doesnt return minMarker and minRot values.
    */
-  unsigned int distance(MarkerCode m)  {
+  unsigned int distance(const MarkerCode &m) const {
       unsigned int minMarker, minRot;
       return distance(m,minMarker,minRot);
   }  
@@ -202,7 +224,7 @@ public:
   /**
    * Calculate the minimun distance between the markers in the dictionary (Equation 9)
    */
-  unsigned int minimunDistance();
+  unsigned int minimunDistance() const;
   
 private:
   
@@ -257,6 +279,40 @@ public:
     
   };
   
+  /**
+  * Multi-index hashing of a marker dictionary for error correction
+  * The n*n bits are split in at least maxDistance+1 disjoint chunks. If a code is at hamming distance
+  * maxDistance or less of a dictionary marker, by the pigeonhole principle at least one of its chunks is
+  * identical to the one of the marker, so only the markers sharing a chunk value need to be compared.
+  */
+  class MultiIndexHashing {
+    
+  public:
+    
+    /**
+    * Create the tables for dictionary D, valid for searchs up to maxDistance
+    */
+    void loadDictionary(Dictionary *D, unsigned int maxDistance);
+    
+    /**
+    * Search the marker of the dictionary at minimun distance of m, if it is not higher than maxDistance.
+    * Return true if found, assigning to orgPos its position in D and to rot the rotation of m, as in Dictionary::distance
+    */
+    bool findNearest(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const;
+    
+  private:
+    
+    bool search(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const; // findNearest for any cpu
+    bool searchPopcnt(const MarkerCode &m, unsigned int &orgPos, unsigned int &rot) const; // search built for popcnt
+    
+    std::vector<uint64_t> _codes; // rotation 0 of each marker of D
+    std::vector<unsigned int> _shifts, _masks; // position and mask of each chunk
+    std::vector< std::vector<unsigned int> > _offsets; // for each chunk, start of the markers of each chunk value in _entries
+    std::vector< std::vector<unsigned int> > _entries; // for each chunk, positions in D sorted by chunk value
+    unsigned int _maxDistance;
+    
+  };
+  
   /**
    * Load the dictionary that will be detected or read it directly from file
    */
@@ -279,6 +335,7 @@ public:
 private:
   static Dictionary _D; // loaded dictionary
   static BalancedBinaryTree _binaryTree;
+  static MultiIndexHashing _hashing;
   // marker dimension, marker dimension with borders, maximunCorrectionDistance
   static unsigned int _n;
   static unsigned int _ncellsBorder;
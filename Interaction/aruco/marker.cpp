@@ -26,6 +26,7 @@ authors and should not be interpreted as representing official policies, either
 or implied, of Rafael Muñoz Salinas.
 ********************************/
 #include "marker.h"
+#include "planarposesolver.h"
 #define _USE_MATH_DEFINES
 #include <math.h>
 #include <cstdio>
@@ -310,13 +311,35 @@ void Marker::calculateExtrinsics(float markerSizeMeters,cv::Mat  camMatrix,cv::M
 
 }
 
-void Marker::calculateExtrinsicsHandMatrix(float markerSizeMeters,cv::Mat  camMatrix, std::vector< float > values, cv::Mat distCoeff ,bool setYPerpendicular)throw(cv::Exception)
+void Marker::calculateExtrinsicsHandMatrix(float markerSizeMeters,cv::Mat  camMatrix, const std::vector< float > &values, cv::Mat distCoeff ,bool setYPerpendicular,PlanarPoseSolver *solver)throw(cv::Exception)
 {
     if (!isValid()) throw cv::Exception(9004,"!isValid(): invalid marker. It is not possible to calculate extrinsics","calculateExtrinsics",__FILE__,__LINE__);
     if (markerSizeMeters<=0)throw cv::Exception(9004,"markerSize<=0: invalid markerSize","calculateExtrinsics",__FILE__,__LINE__);
     if ( camMatrix.rows==0 || camMatrix.cols==0) throw cv::Exception(9004,"CameraMatrix is empty","calculateExtrinsics",__FILE__,__LINE__);
     if ( values.size() != 12 ) throw cv::Exception(9004, "Valores invalidos","calculateExtrinsics",__FILE__,__LINE__);
 
+    //Modelo plano ( el de HandTracker::handModel ): solucion cerrada, sin cv::Mat temporales
+    PlanarPoseSolver localSolver;
+    if ( solver == NULL ) solver = &localSolver;
+    double rvec[3],tvec[3];
+    if ( solver->solve( &values[0], &(*this)[0], camMatrix, distCoeff, rvec, tvec ) )
+    {
+        if (setYPerpendicular)
+            rotateXAxis(rvec);
+        Rvec.create(3,1,CV_32FC1);
+        Tvec.create(3,1,CV_32FC1);
+        for (int i=0;i<3;i++)
+        {
+            Rvec.at<float>(i,0)=rvec[i];
+            Tvec.at<float>(i,0)=tvec[i];
+        }
+        ssize=markerSizeMeters;
+#ifndef NO_DEBUG_ARUCO
+        cout<<(*this)<<endl;
+#endif
+        return;
+    }
+
     cv::Mat ObjPoints(4,3,CV_32FC1);
 
     ObjPoints.at< float >( 0, 0 ) = values.at( 0 );
@@ -379,6 +402,22 @@ void Marker::rotateXAxis(Mat &rotation)
 
 
 
+/**
+ * Same as rotateXAxis(Mat&) on a Rodrigues vector: R*RX, with RX the rotation of 90 degrees around the X axis
+ */
+void Marker::rotateXAxis(double rvec[3])
+{
+    double R[9],RRX[9];
+    PlanarPoseSolver::rodriguesToMatrix(rvec,R);
+    for (int i=0;i<3;i++)
+    {
+        RRX[i*3]=R[i*3];
+        RRX[i*3+1]=R[i*3+2];
+        RRX[i*3+2]=-R[i*3+1];
+    }
+    PlanarPoseSolver::matrixToRodrigues(RRX,rvec);
+}
+
 /**
  */
 cv::Point2f Marker::getCenter()const
@@ -34,6 +34,7 @@ or implied, of Rafael Muñoz Salinas.
 #include "cameraparameters.h"
 using namespace std;
 namespace aruco {
+class PlanarPoseSolver;
 /**\brief This class represents a marker. It is a vector of the fours corners ot the marker
  *
  */
@@ -91,12 +92,14 @@ public:
                              bool setYPerpendicular=true) throw(cv::Exception);
 
     /**Calcula los valores extrinsicos de un marcador ya generado
-       Utiliza los puntos enviados al marcador**/
+       Utiliza los puntos enviados al marcador. Si los 4 puntos de values tienen z=0 usa solver ( uno temporal
+       si es NULL, que no parte de la pose del cuadro anterior ), si no cv::solvePnP**/
     void calculateExtrinsicsHandMatrix(float markerSize,
                                 cv::Mat CameraMatrix,
-                                std::vector< float > values,
+                                const std::vector< float > &values,
                                 cv::Mat Distorsion=cv::Mat(),
-                                bool setYPerpendicular=true) throw(cv::Exception);
+                                bool setYPerpendicular=true,
+                                PlanarPoseSolver *solver=NULL) throw(cv::Exception);
     
     /**Given the extrinsic camera parameters returns the GL_MODELVIEW matrix for opengl.
      * Setting this matrix, the reference coordinate system will be set in this marker
@@ -150,6 +153,7 @@ public:
  
 private:
   void rotateXAxis(cv::Mat &rotation);
+  static void rotateXAxis(double rvec[3]);
  
 };
 
@@ -26,14 +26,15 @@ authors and should not be interpreted as representing official policies, either
 or implied, of Rafael Muñoz Salinas.
 ********************************/
 #include "markerdetector.h"
-#include "subpixelcorner.h"
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 #include <iostream>
 #include <fstream>
 #include "arucofidmarkers.h"
 #include <valarray>
-#include "ar_omp.h"
+#include <cfloat>
+#include "threadpool.h"
+#include "toonearpairs.h"
 using namespace std;
 using namespace cv;
   
@@ -45,7 +46,7 @@ namespace aruco
  *
  *
  ************************************/
-MarkerDetector::MarkerDetector()
+MarkerDetector::MarkerDetector():_harrisRefiner(7,10,0.1f),_subpixRefiner(2,3,0.05f)
 {
     _doErosion=false; 
     _thresMethod=ADPT_THRES;
@@ -59,6 +60,8 @@ MarkerDetector::MarkerDetector()
     _maxSize=0.5;
 
   _borderDistThres=0.01;//corners in a border of 1% of image  are ignored
+  _work.blankMarker.Rvec.release();
+  _work.blankMarker.Tvec.release();
 }
 /************************************
  *
@@ -107,7 +110,19 @@ void MarkerDetector::setDesiredSpeed ( int val )
  *
  *
  ************************************/
-void MarkerDetector::detect ( const  cv::Mat &input,std::vector<Marker> &detectedMarkers, CameraParameters camParams ,float markerSizeMeters ,bool setYPerpendicular) throw ( cv::Exception )
+void MarkerDetector::setMultiThresholdParams ( const std::vector<cv::Vec2d> &params )
+{
+    _multiThresParams=params;
+    _thresPasses.resize ( params.size() );
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void MarkerDetector::detect ( const  cv::Mat &input,std::vector<Marker> &detectedMarkers, const CameraParameters &camParams ,float markerSizeMeters ,bool setYPerpendicular) throw ( cv::Exception )
 {
     detect ( input, detectedMarkers,camParams.CameraMatrix ,camParams.Distorsion,  markerSizeMeters ,setYPerpendicular);
 }
@@ -130,8 +145,8 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
 
 //     cv::cvtColor(grey,_ssImC ,CV_GRAY2BGR); //DELETE
 
-    //clear input data
-    detectedMarkers.clear();
+    //clear input data. Its elements are kept, see shrinkMarkers()
+    shrinkMarkers ( detectedMarkers,0 );
 
 
     cv::Mat imgToBeThresHolded=grey;
@@ -139,30 +154,34 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
     //Must the image be downsampled before continue pocessing?
     if ( pyrdown_level!=0 )
     {
-        reduced=grey;
+        _work.pyramid.resize ( pyrdown_level );
         for ( int i=0;i<pyrdown_level;i++ )
-        {
-            cv::Mat tmp;
-            cv::pyrDown ( reduced,tmp );
-            reduced=tmp;
-        }
+            cv::pyrDown ( i==0 ? grey : _work.pyramid[i-1],_work.pyramid[i] );
+        reduced=_work.pyramid.back();
         int red_den=pow ( 2.0f,pyrdown_level );
         imgToBeThresHolded=reduced;
         ThresParam1/=float ( red_den );
         ThresParam2/=float ( red_den );
     }
 
-    ///Do threshold the image and detect contours
-    thresHold ( _thresMethod,imgToBeThresHolded,thres,ThresParam1,ThresParam2 );
-    //an erosion might be required to detect chessboard like boards
-    if ( _doErosion )
+    CandidateList &MarkerCanditates=_work.candidates;
+    MarkerCanditates.clear();
+    if ( _multiThresParams.empty() )
     {
-        erode ( thres,thres2,cv::Mat() );
-        thres2.copyTo(thres); //vs thres=thres2;
+        ///Do threshold the image and detect contours
+        thresHold ( _thresMethod,imgToBeThresHolded,thres,ThresParam1,ThresParam2 );
+        //an erosion might be required to detect chessboard like boards
+        if ( _doErosion )
+        {
+            erode ( thres,thres2,cv::Mat() );
+            thres2.copyTo(thres); //vs thres=thres2;
+        }
+        //find all rectangles in the thresholdes image
+        findRectangles ( thres,_work.search );
+        removeTooNearCandidates ( _work.search.candidates,MarkerCanditates );
     }
-    //find all rectangles in the thresholdes image
-    vector<MarkerCandidate > MarkerCanditates;
-    detectRectangles ( thres,MarkerCanditates );
+    else
+        detectRectanglesMultiThreshold ( imgToBeThresHolded,pow ( 2.0f,pyrdown_level ),MarkerCanditates );
     //if the image has been downsampled, then calcualte the location of the corners in the original image
     if ( pyrdown_level!=0 )
     {
@@ -185,41 +204,69 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
 
     
     ///identify the markers
-    vector<vector<Marker> >markers_omp(omp_get_max_threads());
-    vector<vector < std::vector<cv::Point2f> > >candidates_omp(omp_get_max_threads());
-    #pragma omp parallel for
+    //each iteration writes only its own entries, so the result does not depend on the number of threads
+    vector<int> &ids=_work.ids,&rotations=_work.rotations;
+    assignBuffer ( ids,MarkerCanditates.size(),-1 );
+    assignBuffer ( rotations,MarkerCanditates.size(),0 );
+    //canonical images of all the candidates, one after the other in _warpBuffer
+    vector<char> &warped=_work.warped;
+    warpCandidates ( grey,MarkerCanditates,_markerWarpSize,warped );
+    parallel_for ( 0,MarkerCanditates.size(),[&] ( int begin,int end )
+    {
+        for ( int i=begin;i<end;i++ )
+        {
+            if ( warped[i] )
+            {
+                Mat canonicalMarker=_warpBuffer.rowRange ( i*_markerWarpSize, ( i+1 ) *_markerWarpSize );
+                ids[i]= ( *markerIdDetector_ptrfunc ) ( canonicalMarker,rotations[i] );
+                if ( ids[i]!=-1 && _cornerMethod==LINES ) // make LINES refinement before lose contour points
+                    refineCandidateLines ( MarkerCanditates[i], camMatrix, distCoeff );
+            }
+        }
+    } );
+    //collect. The elements of _candidates are overwritten, and the ones left over are moved to spareCorners instead
+    //of destroyed, so that their buffers are used again when there are more candidates
+    vector<std::pair<int,int> > &order=_work.order;
+    order.clear();
+    size_t nRejected=0;
     for ( unsigned int i=0;i<MarkerCanditates.size();i++ )
     {
-        //Find proyective homography
-        Mat canonicalMarker;
-        bool resW=false;
-     	resW=warp ( grey,canonicalMarker,Size ( _markerWarpSize,_markerWarpSize ),MarkerCanditates[i] );
-        if (resW) {
-             int nRotations;
-            int id= ( *markerIdDetector_ptrfunc ) ( canonicalMarker,nRotations );
-            if ( id!=-1 )
+        if ( !warped[i] ) continue;
+        if ( ids[i]!=-1 ) order.push_back ( std::make_pair ( ids[i],int ( i ) ) );
+        else
+        {
+            if ( nRejected==_candidates.size() )
             {
- 		if(_cornerMethod==LINES) // make LINES refinement before lose contour points
-		  refineCandidateLines( MarkerCanditates[i], camMatrix, distCoeff ); 
-                markers_omp[omp_get_thread_num()].push_back ( MarkerCanditates[i] );
-                markers_omp[omp_get_thread_num()].back().id=id;
-                //sort the points so that they are always in the same order no matter the camera orientation
-                std::rotate ( markers_omp[omp_get_thread_num()].back().begin(),markers_omp[omp_get_thread_num()].back().begin() +4-nRotations,markers_omp[omp_get_thread_num()].back().end() );
+                _candidates.push_back ( vector<Point2f>() );
+                takeCorners ( _candidates.back(),_candidates.size() );
             }
-            else candidates_omp[omp_get_thread_num()].push_back ( MarkerCanditates[i] );
+            _candidates[nRejected++].assign ( MarkerCanditates[i].begin(),MarkerCanditates[i].end() );
         }
-       
     }
-    //unify parallel data 
-	joinVectors(markers_omp,detectedMarkers,true);
-	joinVectors(candidates_omp,_candidates,true);
-
-
+    while ( _candidates.size() >nRejected )
+    {
+        _work.spareCorners.push_back ( vector<Point2f>() );
+        _work.spareCorners.back().swap ( _candidates.back() );
+        _candidates.pop_back();
+    }
+    //the markers are added sorted by id (and by candidate for the same id), so that they need no sort, which
+    //would copy them
+    std::sort ( order.begin(),order.end() );
+    for ( size_t k=0;k<order.size();k++ )
+    {
+        int i=order[k].second;
+        Marker &marker=addMarker ( detectedMarkers );
+        marker.assign ( MarkerCanditates[i].begin(),MarkerCanditates[i].end() );
+        marker.id=ids[i];
+        //sort the points so that they are always in the same order no matter the camera orientation
+        std::rotate ( marker.begin(),marker.begin() +4-rotations[i],marker.end() );
+    }
 
     ///refine the corner location if desired
     if ( detectedMarkers.size() >0 && _cornerMethod!=NONE && _cornerMethod!=LINES )
     {
-        vector<Point2f> Corners;
+        vector<Point2f> &Corners=_work.corners;
+        Corners.clear();
         for ( unsigned int i=0;i<detectedMarkers.size();i++ )
             for ( int c=0;c<4;c++ )
                 Corners.push_back ( detectedMarkers[i][c] );
@@ -227,19 +274,18 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
         if ( _cornerMethod==HARRIS )
             findBestCornerInRegion_harris ( grey, Corners,7 );
         else if ( _cornerMethod==SUBPIX )
-            cornerSubPix ( grey, Corners,cvSize ( 5,5 ), cvSize ( -1,-1 )   ,cvTermCriteria ( CV_TERMCRIT_ITER|CV_TERMCRIT_EPS,3,0.05 ) );
+            _subpixRefiner.refine ( grey,Corners );
 
         //copy back
         for ( unsigned int i=0;i<detectedMarkers.size();i++ )
             for ( int c=0;c<4;c++ )     detectedMarkers[i][c]=Corners[i*4+c];
     }
-    //sort by id
-    std::sort ( detectedMarkers.begin(),detectedMarkers.end() );
     //there might be still the case that a marker is detected twice because of the double border indicated earlier,
     //detect and remove these cases
     int borderDistThresX=_borderDistThres*float(input.cols);
     int borderDistThresY=_borderDistThres*float(input.rows);
-    vector<bool> toRemove ( detectedMarkers.size(),false );
+    vector<bool> &toRemove=_work.toRemove;
+    assignBuffer ( toRemove,detectedMarkers.size(),false );
     for ( int i=0;i<int ( detectedMarkers.size() )-1;i++ )
     {
         if ( detectedMarkers[i].id==detectedMarkers[i+1].id && !toRemove[i+1] )
@@ -259,8 +305,15 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
  
         
     }
-    //remove the markers marker
-    removeElements ( detectedMarkers, toRemove );
+    //remove the markers marker. They are swapped instead of copied, so that no buffer is lost
+    size_t nValid=0;
+    for ( size_t i=0;i<detectedMarkers.size();i++ )
+    {
+        if ( toRemove[i] ) continue;
+        if ( nValid!=i ) swapMarkers ( detectedMarkers[nValid],detectedMarkers[i] );
+        nValid++;
+    }
+    shrinkMarkers ( detectedMarkers,nValid );
 
     ///detect the position of detected markers if desired
     if ( camMatrix.rows!=0  && markerSizeMeters>0 )
@@ -270,6 +323,77 @@ void MarkerDetector::detect ( const  cv::Mat &input,vector<Marker> &detectedMark
     }
 }
 
+/************************************
+ *
+ * Gives buffer one of spareCorners, if there is one. Otherwise buffer stays new, and spareCorners makes room for
+ * the inUse buffers there are now, so that it does not grow when they are given back
+ *
+ ************************************/
+void MarkerDetector::takeCorners ( vector<Point2f> &buffer,size_t inUse )
+{
+    if ( !_work.spareCorners.empty() )
+    {
+        buffer.swap ( _work.spareCorners.back() );
+        _work.spareCorners.pop_back();
+    }
+    else if ( _work.spareCorners.capacity() <inUse ) _work.spareCorners.reserve ( 2*inUse );
+}
+
+/************************************
+ *
+ * Adds an element to markers, as Marker() but with the buffers of one of spareMarkers if there is one. Otherwise
+ * spareMarkers makes room for all the markers there are now, so that it does not grow when they are given back
+ *
+ ************************************/
+Marker &MarkerDetector::addMarker ( vector<Marker> &markers )
+{
+    markers.push_back ( _work.blankMarker );
+    Marker &marker=markers.back();
+    if ( !_work.spareMarkers.empty() )
+    {
+        swapMarkers ( marker,_work.spareMarkers.back() );
+        _work.spareMarkers.pop_back();
+    }
+    else if ( _work.spareMarkers.capacity() <markers.size() ) _work.spareMarkers.reserve ( 2*markers.size() );
+    marker.clear();
+    marker.id=-1;
+    marker.ssize=-1;
+    marker.Rvec.create ( 3,1,CV_32FC1 );
+    marker.Tvec.create ( 3,1,CV_32FC1 );
+    for ( int i=0;i<3;i++ )
+        marker.Tvec.at<float> ( i,0 ) =marker.Rvec.at<float> ( i,0 ) =-999999;
+    return marker;
+}
+
+/************************************
+ *
+ * Leaves n elements in markers. The removed ones are moved to spareMarkers
+ *
+ ************************************/
+void MarkerDetector::shrinkMarkers ( vector<Marker> &markers,size_t n )
+{
+    while ( markers.size() >n )
+    {
+        _work.spareMarkers.push_back ( _work.blankMarker );
+        swapMarkers ( _work.spareMarkers.back(),markers.back() );
+        markers.pop_back();
+    }
+}
+
+/************************************
+ *
+ * Swaps two markers without copying their corners
+ *
+ ************************************/
+void MarkerDetector::swapMarkers ( Marker &a,Marker &b )
+{
+    a.swap ( b );
+    std::swap ( a.id,b.id );
+    std::swap ( a.ssize,b.ssize );
+    cv::swap ( a.Rvec,b.Rvec );
+    cv::swap ( a.Tvec,b.Tvec );
+}
+
 
 /************************************
  *
@@ -289,19 +413,49 @@ void  MarkerDetector::detectRectangles ( const cv::Mat &thres,vector<std::vector
 
 void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandidate> & OutMarkerCanditates)
 {
-    vector<MarkerCandidate>  MarkerCanditates;
+    RectangleSearch search;
+    CandidateList MarkerCanditates;
+    findRectangles ( thresImg,search );
+    removeTooNearCandidates ( search.candidates,MarkerCanditates );
+    OutMarkerCanditates.reserve ( OutMarkerCanditates.size() +MarkerCanditates.size() );
+    for ( size_t i=0;i<MarkerCanditates.size();i++ )
+        OutMarkerCanditates.push_back ( MarkerCanditates[i] );
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void MarkerDetector::findRectangles(const cv::Mat &thresImg,RectangleSearch &search)
+{
     //calcualte the min_max contour sizes
     int minSize=_minSize*std::max(thresImg.cols,thresImg.rows)*4;
     int maxSize=_maxSize*std::max(thresImg.cols,thresImg.rows)*4;
-    std::vector<std::vector<cv::Point> > contours2;
-    std::vector<cv::Vec4i> hierarchy2;
-
-    thresImg.copyTo ( thres2 );
-    cv::findContours ( thres2 , contours2, hierarchy2,CV_RETR_LIST, CV_CHAIN_APPROX_NONE );
-    vector<Point>  approxCurve;
+    std::vector<std::vector<cv::Point> > &contours2=search.contours;
+    CandidateList &MarkerCanditates=search.candidates;
+    MarkerCanditates.clear();
+
+    thresImg.copyTo ( search.work );
+    //what cv::findContours() does, but with a storage kept between calls instead of a new one in every call. The
+    //contours go to the first nContours elements of contours2, whose buffers are only reallocated to grow
+    if ( search.storage.empty() ) search.storage=cvCreateMemStorage();
+    else cvClearMemStorage ( search.storage );
+    IplImage work=search.work;
+    CvSeq *first=0;
+    cvFindContours ( &work,search.storage,&first,sizeof ( CvContour ),CV_RETR_LIST,CV_CHAIN_APPROX_NONE );
+    size_t nContours=0;
+    for ( CvSeq *c=first;c!=0;c=c->h_next,nContours++ )
+    {
+        if ( nContours==contours2.size() ) contours2.push_back ( vector<Point>() );
+        resizeBuffer ( contours2[nContours],c->total );
+        if ( c->total>0 ) cvCvtSeqToArray ( c,&contours2[nContours][0] );
+    }
+    vector<Point> &approxCurve=search.approxCurve;
     ///for each contour, analyze if it is a paralelepiped likely to be the marker
 
-    for ( unsigned int i=0;i<contours2.size();i++ )
+    for ( unsigned int i=0;i<nContours;i++ )
     {
 
 
@@ -310,6 +464,8 @@ void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandi
         {
             //approximate to a poligon
             approxPolyDP (  contours2[i]  ,approxCurve , double ( contours2[i].size() ) *0.05 , true );
+            //approxPolyDP() resizes it to the exact size, leave room for longer curves
+            if ( approxCurve.capacity() <2*approxCurve.size() ) approxCurve.reserve ( 2*approxCurve.size() );
             // 				drawApproxCurve(copy,approxCurve,Scalar(0,0,255));
             //check that the poligon has 4 points
             if ( approxCurve.size() ==4 )
@@ -337,11 +493,11 @@ void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandi
                     {
                         //add the points
                         // 	      cout<<"ADDED"<<endl;
-                        MarkerCanditates.push_back ( MarkerCandidate() );
-                        MarkerCanditates.back().idx=i;
+                        MarkerCandidate &candidate=MarkerCanditates.add();
+                        candidate.idx=i;
                         for ( int j=0;j<4;j++ )
                         {
-                            MarkerCanditates.back().push_back ( Point2f ( approxCurve[j].x,approxCurve[j].y ) );
+                            candidate.push_back ( Point2f ( approxCurve[j].x,approxCurve[j].y ) );
                         }
                     }
                 }
@@ -353,7 +509,6 @@ void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandi
 //  		imshow("input",input);
 //  						waitKey(0);
     ///sort the points in anti-clockwise order
-    valarray<bool> swapped(false,MarkerCanditates.size());//used later
     for ( unsigned int i=0;i<MarkerCanditates.size();i++ )
     {
 
@@ -368,40 +523,35 @@ void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandi
         if ( o  < 0.0 )		 //if the third point is in the left side, then sort in anti-clockwise order
         {
             swap ( MarkerCanditates[i][1],MarkerCanditates[i][3] );
-            swapped[i]=true;
-            //sort the contour points
-//  	    reverse(MarkerCanditates[i].contour.begin(),MarkerCanditates[i].contour.end());//????
-
         }
+        //assign the contour. If the corners where swapped, it is required to reverse here the points so that they
+        //are in the same order. It is copied, not swapped, so that every buffer stays where it grew
+        const vector<Point> &found=contours2[ MarkerCanditates[i].idx];
+        resizeBuffer ( MarkerCanditates[i].contour,found.size() );
+        if ( o < 0.0 )
+            std::reverse_copy ( found.begin(),found.end(),MarkerCanditates[i].contour.begin() );
+        else
+            std::copy ( found.begin(),found.end(),MarkerCanditates[i].contour.begin() );
     }
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void MarkerDetector::removeTooNearCandidates(const CandidateList &MarkerCanditates,CandidateList &OutMarkerCanditates)
+{
       
     /// remove these elements which corners are too close to each other
     //first detect candidates to be removed
  
-    vector< vector<pair<int,int>  > > TooNearCandidates_omp(omp_get_max_threads());
-    #pragma omp parallel for
-    for ( unsigned int i=0;i<MarkerCanditates.size();i++ )
-    {
-        // 	cout<<"Marker i="<<i<<MarkerCanditates[i]<<endl;
-        //calculate the average distance of each corner to the nearest corner of the other marker candidate
-        for ( unsigned int j=i+1;j<MarkerCanditates.size();j++ )
-        {
-            float dist=0;
-            for ( int c=0;c<4;c++ )
-                dist+= sqrt ( ( MarkerCanditates[i][c].x-MarkerCanditates[j][c].x ) * ( MarkerCanditates[i][c].x-MarkerCanditates[j][c].x ) + ( MarkerCanditates[i][c].y-MarkerCanditates[j][c].y ) * ( MarkerCanditates[i][c].y-MarkerCanditates[j][c].y ) );
-            dist/=4;
-            //if distance is too small
-            if ( dist< 10 )
-            {
-                TooNearCandidates_omp[omp_get_thread_num()].push_back ( pair<int,int> ( i,j ) );
-            }
-        }
-    }
-    //join
-     vector<pair<int,int>  > TooNearCandidates;
-     joinVectors(  TooNearCandidates_omp,TooNearCandidates);
+    findTooNearPairs ( MarkerCanditates,_work );
+    const vector<pair<int,int>  > &TooNearCandidates=_work.pairs;
     //mark for removal the element of  the pair with smaller perimeter
-    valarray<bool> toRemove ( false,MarkerCanditates.size() );
+    vector<char> &toRemove=_work.toRemoveCandidates;
+    assignBuffer ( toRemove,MarkerCanditates.size(),false );
     for ( unsigned int i=0;i<TooNearCandidates.size();i++ )
     {
         if ( perimeter ( MarkerCanditates[TooNearCandidates[i].first ] ) >perimeter ( MarkerCanditates[ TooNearCandidates[i].second] ) )
@@ -411,19 +561,54 @@ void MarkerDetector::detectRectangles(const cv::Mat &thresImg,vector<MarkerCandi
 
     //remove the invalid ones
 //     removeElements ( MarkerCanditates,toRemove );
-    //finally, assign to the remaining candidates the contour
-    OutMarkerCanditates.reserve(MarkerCanditates.size());
+    //finally, copy the remaining candidates
+    OutMarkerCanditates.clear();
     for (size_t i=0;i<MarkerCanditates.size();i++) {
         if (!toRemove[i]) {
-            OutMarkerCanditates.push_back(MarkerCanditates[i]);
-            OutMarkerCanditates.back().contour=contours2[ MarkerCanditates[i].idx];
-            if (swapped[i] )//if the corners where swapped, it is required to reverse here the points so that they are in the same order
-                reverse(OutMarkerCanditates.back().contour.begin(),OutMarkerCanditates.back().contour.end());//????
+            OutMarkerCanditates.add(MarkerCanditates[i]);
         }
     }
 
 }
 
+/************************************
+ *
+ * Multi-threshold mode. Every pass thresholds and finds its rectangles with its own buffers, then all the
+ * rectangles go together through the too-near test, so the same marker found by several passes is kept once
+ *
+ ************************************/
+void MarkerDetector::detectRectanglesMultiThreshold ( const cv::Mat &img,float red_den,CandidateList &OutMarkerCanditates )
+{
+    if ( _thresPasses.size() !=_multiThresParams.size() ) _thresPasses.resize ( _multiThresParams.size() );
+
+    parallel_for ( 0,_thresPasses.size(),[&] ( int begin,int end )
+    {
+        for ( int k=begin;k<end;k++ )
+        {
+            ThresholdPass &pass=_thresPasses[k];
+            thresHold ( _thresMethod,img,pass.thres,_multiThresParams[k][0]/red_den,_multiThresParams[k][1]/red_den,pass.adaptiveThres );
+            //an erosion might be required to detect chessboard like boards
+            if ( _doErosion )
+            {
+                erode ( pass.thres,pass.search.work,cv::Mat() );
+                cv::swap ( pass.thres,pass.search.work );
+            }
+            findRectangles ( pass.thres,pass.search );
+        }
+    } );
+
+    //join
+    CandidateList &MarkerCanditates=_work.joined;
+    MarkerCanditates.clear();
+    for ( size_t k=0;k<_thresPasses.size();k++ )
+        for ( size_t i=0;i<_thresPasses[k].search.candidates.size();i++ )
+            MarkerCanditates.add ( _thresPasses[k].search.candidates[i] );
+    removeTooNearCandidates ( MarkerCanditates,OutMarkerCanditates );
+
+    //for getThresholdedImage()
+    _thresPasses[0].thres.copyTo ( thres );
+}
+
 /************************************
  *
  *
@@ -436,6 +621,11 @@ void MarkerDetector::thresHold ( int method,const Mat &grey,Mat &out,double para
     if (param1==-1) param1=_thresParam1;
     if (param2==-1) param2=_thresParam2;
 
+    thresHold ( method,grey,out,param1,param2,_adaptiveThres );
+}
+
+void MarkerDetector::thresHold ( int method,const Mat &grey,Mat &out,double param1,double param2,AdaptiveThreshold &engine ) throw ( cv::Exception )
+{
     if ( grey.type() !=CV_8UC1 )     throw cv::Exception ( 9001,"grey.type()!=CV_8UC1","MarkerDetector::thresHold",__FILE__,__LINE__ );
     switch ( method )
     {
@@ -447,7 +637,12 @@ void MarkerDetector::thresHold ( int method,const Mat &grey,Mat &out,double para
         if ( param1<3 ) param1=3;
         else if ( ( ( int ) param1 ) %2 !=1 ) param1= ( int ) ( param1+1 );
 
-        cv::adaptiveThreshold ( grey,out,255,ADAPTIVE_THRESH_MEAN_C,THRESH_BINARY_INV,param1,param2 );
+        //same result as cv::adaptiveThreshold(ADAPTIVE_THRESH_MEAN_C,THRESH_BINARY_INV) in a single pass.
+        //In high speed modes the local mean is only computed on even rows
+        if ( grey.data!=out.data )
+            engine.apply ( grey,out,( int ) param1,param2,_speed>=2 );
+        else
+            cv::adaptiveThreshold ( grey,out,255,ADAPTIVE_THRESH_MEAN_C,THRESH_BINARY_INV,param1,param2 );
         break;
     case CANNY:
     {
@@ -487,6 +682,77 @@ bool MarkerDetector::warp ( Mat &in,Mat &out,Size size, vector<Point2f> points )
     return true;
 }
 
+/************************************
+ *
+ * Homography from the canonical image of size x size pixels to the image, taking (0,0),(size-1,0),(size-1,size-1)
+ * and (0,size-1) to points[0..3]. Closed form of the unit square to quadrilateral mapping, scaled to the canonical
+ * size. Returns false if the quadrilateral is degenerate
+ *
+ ************************************/
+static bool canonicalToImage ( const vector<Point2f> &points,int size,double H[9] )
+{
+    double x0=points[0].x,x1=points[1].x,x2=points[2].x,x3=points[3].x;
+    double y0=points[0].y,y1=points[1].y,y2=points[2].y,y3=points[3].y;
+    double dx3=x0-x1+x2-x3,dy3=y0-y1+y2-y3;
+    double g=0,h=0;
+    if ( dx3!=0 || dy3!=0 )
+    {
+        double dx1=x1-x2,dx2=x3-x2,dy1=y1-y2,dy2=y3-y2;
+        double den=dx1*dy2-dx2*dy1;
+        if ( den==0 ) return false;
+        g= ( dx3*dy2-dx2*dy3 ) /den;
+        h= ( dx1*dy3-dx3*dy1 ) /den;
+    }
+    double scale=1./ ( size-1 );
+    H[0]= ( x1-x0+g*x1 ) *scale;  H[1]= ( x3-x0+h*x3 ) *scale;  H[2]=x0;
+    H[3]= ( y1-y0+g*y1 ) *scale;  H[4]= ( y3-y0+h*y3 ) *scale;  H[5]=y0;
+    H[6]=g*scale;                 H[7]=h*scale;                 H[8]=1;
+    return true;
+}
+
+/************************************
+ *
+ * Canonical images of all the candidates, as warp() does (nearest neighbour, 0 outside the image) but sampled
+ * straight from in into consecutive size x size blocks of _warpBuffer, which is only reallocated when it grows
+ *
+ ************************************/
+void MarkerDetector::warpCandidates ( const Mat &in,const CandidateList &candidates,int size,vector<char> &warped )
+{
+    const int n=candidates.size();
+    assignBuffer ( warped,n,0 );
+    if ( n==0 ) return;
+
+    if ( _warpBuffer.cols!=size || _warpBuffer.rows<n*size )
+        _warpBuffer.create ( std::max ( n*size,_warpBuffer.cols==size ? 2*_warpBuffer.rows : 0 ),size,CV_8UC1 );
+
+    //all the homographies first, then the sampling in parallel
+    vector<double> &homographies=_work.homographies;
+    resizeBuffer ( homographies,9*n );
+    for ( int i=0;i<n;i++ )
+        warped[i]=candidates[i].size() ==4 && canonicalToImage ( candidates[i],size,&homographies[9*i] );
+
+    parallel_for ( 0,n,[&] ( int begin,int end )
+    {
+        for ( int i=begin;i<end;i++ )
+        {
+            if ( !warped[i] ) continue;
+            const double *H=&homographies[9*i];
+            for ( int v=0;v<size;v++ )
+            {
+                uchar *dst=_warpBuffer.ptr<uchar> ( i*size+v );
+                double X0=H[1]*v+H[2],Y0=H[4]*v+H[5],W0=H[7]*v+H[8];
+                for ( int u=0;u<size;u++ )
+                {
+                    double W=W0+H[6]*u;
+                    W=W ? 1./W : 0;
+                    int x=cvRound ( ( X0+H[0]*u ) *W ),y=cvRound ( ( Y0+H[3]*u ) *W );
+                    dst[u]= ( unsigned ) x< ( unsigned ) in.cols && ( unsigned ) y< ( unsigned ) in.rows ? in.at<uchar> ( y,x ) : 0;
+                }
+            }
+        }
+    } );
+}
+
 void findCornerPointsInContour(const vector<cv::Point2f>& points,const vector<cv::Point> &contour,vector<int> &idxs)
 {
     assert(points.size()==4);
@@ -731,7 +997,7 @@ bool MarkerDetector::isInto ( Mat &contour,vector<Point2f> &b )
  *
  *
  ************************************/
-int MarkerDetector:: perimeter ( vector<Point2f> &a )
+int MarkerDetector:: perimeter ( const vector<Point2f> &a )
 {
     int sum=0;
     for ( unsigned int i=0;i<a.size();i++ )
@@ -748,10 +1014,8 @@ int MarkerDetector:: perimeter ( vector<Point2f> &a )
  *
  */
 void MarkerDetector::findBestCornerInRegion_harris ( const cv::Mat  & grey,vector<cv::Point2f> &  Corners,int blockSize )
-{ 
-     SubPixelCorner Subp;
-     Subp.RefineCorner(grey,Corners);
- 
+{
+    _harrisRefiner.refine ( grey,Corners );
 }
 
 
@@ -762,8 +1026,7 @@ void MarkerDetector::findBestCornerInRegion_harris ( const cv::Mat  & grey,vecto
 void MarkerDetector::refineCandidateLines(MarkerDetector::MarkerCandidate& candidate, const cv::Mat &camMatrix, const cv::Mat &distCoeff)
 {
       // search corners on the contour vector
-      vector<unsigned int> cornerIndex;
-      cornerIndex.resize(4);
+      unsigned int cornerIndex[4]={0,0,0,0};
       for(unsigned int j=0; j<candidate.contour.size(); j++) {
 	for(unsigned int k=0; k<4; k++) {
 	  if(candidate.contour[j].x==candidate[k].x && candidate.contour[j].y==candidate[k].y) {
@@ -785,40 +1048,37 @@ void MarkerDetector::refineCandidateLines(MarkerDetector::MarkerCandidate& candi
       int inc = 1;
       if(inverse) inc = -1;
       
-      // undistort contour
-      vector<Point2f> contour2f;
+      // undistort contour. The point buffers are the candidate's, so that they are reused between frames
+      vector<Point2f> &contour2f=candidate.contour2f;
+      contour2f.clear();
       for(unsigned int i=0; i<candidate.contour.size(); i++) 
 	contour2f.push_back( cv::Point2f(candidate.contour[i].x, candidate.contour[i].y) );      
       if(!camMatrix.empty() && !distCoeff.empty())
 	cv::undistortPoints(contour2f, contour2f, camMatrix, distCoeff, cv::Mat(), camMatrix); 
 
 
-      vector<std::vector<cv::Point2f> > contourLines;
-      contourLines.resize(4);
+      // interpolate marker lines, one after the other in the same buffer
+      vector<Point2f> &linePoints=candidate.linePoints;
+      Point3f lines[4];
       for(unsigned int l=0; l<4; l++) {
+	linePoints.clear();
 	for(int j=(int)cornerIndex[l]; j!=(int)cornerIndex[(l+1)%4]; j+=inc) {
 	  if(j==(int)candidate.contour.size() && !inverse) j=0;
 	  else if(j==0 && inverse) j=candidate.contour.size()-1;
-	  contourLines[l].push_back(contour2f[j]);
+	  linePoints.push_back(contour2f[j]);
 	  if(j==(int)cornerIndex[(l+1)%4]) break; // this has to be added because of the previous ifs
 	}
-	
+	interpolate2Dline(linePoints, lines[l]);
       }
-
-      // interpolate marker lines
-      vector<Point3f> lines;
-      lines.resize(4);
-      for(unsigned int j=0; j<lines.size(); j++) interpolate2Dline(contourLines[j], lines[j]);    
       
       // get cross points of lines
-      vector<Point2f> crossPoints;
-      crossPoints.resize(4);
+      Point2f crossPoints[4];
       for(unsigned int i=0; i<4; i++)
 	crossPoints[i] = getCrossPoint( lines[(i-1)%4], lines[i] );
       
       // distort corners again if undistortion was performed
       if(!camMatrix.empty() && !distCoeff.empty())
-	  distortPoints(crossPoints, crossPoints, camMatrix, distCoeff);
+	  distortPoints(crossPoints, crossPoints, 4, camMatrix, distCoeff);
       
       // reassing points
       for(unsigned int j=0; j<4; j++)
@@ -841,51 +1101,49 @@ void MarkerDetector::interpolate2Dline( const std::vector< Point2f >& inPoints,
     if(inPoints[i].y > maxY) maxY = inPoints[i].y;
   }
 
-    // create matrices of equation system
-    Mat A(inPoints.size(),2,CV_32FC1, Scalar(0));
-    Mat B(inPoints.size(),1,CV_32FC1, Scalar(0));
-    Mat X;
-
-    
-    
-    if( maxX-minX > maxY-minY ) {
-      // Ax + C = y
-      for (int i=0; i<inPoints.size(); i++) {
-
-	  A.at<float>(i, 0) = inPoints[i].x;
-	  A.at<float>(i, 1) = 1.;
-	  B.at<float>(i, 0) = inPoints[i].y;
-
-      }
-
-      // solve system
-      solve(A,B,X, DECOMP_SVD);
-      // return Ax + By + C
-      outLine = Point3f(X.at<float>(0,0), -1., X.at<float>(1,0));  
+    // Ax + C = y if the points extend more along x, By + C = x otherwise. Least squares solution in closed form,
+    // the one solve(DECOMP_SVD) gives without allocating its matrices
+    bool alongX = maxX-minX > maxY-minY;
+    double meanU=0, meanV=0;
+    for (unsigned int i=0; i<inPoints.size(); i++) {
+      meanU += alongX ? inPoints[i].x : inPoints[i].y;
+      meanV += alongX ? inPoints[i].y : inPoints[i].x;
+    }
+    meanU /= inPoints.size();
+    meanV /= inPoints.size();
+    double suu=0, suv=0;
+    for (unsigned int i=0; i<inPoints.size(); i++) {
+      double du = ( alongX ? inPoints[i].x : inPoints[i].y ) - meanU;
+      double dv = ( alongX ? inPoints[i].y : inPoints[i].x ) - meanV;
+      suu += du*du;
+      suv += du*dv;
+    }
+    double slope, offset;
+    if( suu>0 ) {
+      slope = suv/suu;
+      offset = meanV-slope*meanU;
     }
     else {
-      // By + C = x
-      for (int i=0; i<inPoints.size(); i++) {
-
-	  A.at<float>(i, 0) = inPoints[i].y;
-	  A.at<float>(i, 1) = 1.;
-	  B.at<float>(i, 0) = inPoints[i].x;
-
-      }
-
-      // solve system
-      solve(A,B,X, DECOMP_SVD);
-      // return Ax + By + C
-      outLine = Point3f(-1., X.at<float>(0,0), X.at<float>(1,0));        
+      // all the points are the same: the minimum norm solution, as the SVD
+      slope = meanU*meanV/(meanU*meanU+1);
+      offset = meanV/(meanU*meanU+1);
     }
-  
+
+    // return Ax + By + C
+    if( alongX ) outLine = Point3f(slope, -1., offset);
+    else outLine = Point3f(-1., slope, offset);
 }
 
 /**
  */
 Point2f MarkerDetector::getCrossPoint(const cv::Point3f& line1, const cv::Point3f& line2)
 {
-  
+    // Cramer's rule, parallel lines keep the least squares solution of the SVD
+    double det = double(line1.x)*line2.y - double(line1.y)*line2.x;
+    if( det!=0 )
+      return Point2f( (double(line1.y)*line2.z - double(line2.y)*line1.z)/det,
+                      (double(line2.x)*line1.z - double(line1.x)*line2.z)/det );
+
     // create matrices of equation system
     Mat A(2,2,CV_32FC1, Scalar(0));
     Mat B(2,1,CV_32FC1, Scalar(0));
@@ -908,19 +1166,24 @@ Point2f MarkerDetector::getCrossPoint(const cv::Point3f& line1, const cv::Point3
 
 /**
  */
-void MarkerDetector::distortPoints(vector<cv::Point2f> in, vector<cv::Point2f> &out, const Mat& camMatrix, const Mat& distCoeff)
+void MarkerDetector::distortPoints(const cv::Point2f *in, cv::Point2f *out, int n, const Mat& camMatrix, const Mat& distCoeff)
 {
- 	// trivial extrinsics
- 	cv::Mat Rvec = cv::Mat(3,1,CV_32FC1, cv::Scalar::all(0));
- 	cv::Mat Tvec = Rvec.clone();
- 	// calculate 3d points and then reproject, so opencv makes the distortion internally
- 	vector<cv::Point3f> cornersPoints3d;
- 	for(unsigned int i=0; i<in.size(); i++)
- 	  cornersPoints3d.push_back( cv::Point3f( 
-	      (in[i].x-camMatrix.at<float>(0,2))/camMatrix.at<float>(0,0), 	//x
-	      (in[i].y-camMatrix.at<float>(1,2))/camMatrix.at<float>(1,1), 	//y
-	      1 ) );								//z
- 	cv::projectPoints(cornersPoints3d, Rvec, Tvec, camMatrix, distCoeff, out);
+ 	// what cv::projectPoints() does with trivial extrinsics and the points at z=1, written out so that no matrix is
+ 	// allocated. distCoeff is k1,k2,p1,p2[,k3[,k4,k5,k6]]
+ 	double k[8]={0,0,0,0,0,0,0,0};
+ 	for(int i=0; i<std::min(8,(int)distCoeff.total()); i++)
+ 	  k[i] = distCoeff.depth()==CV_64F ? distCoeff.at<double>(i) : distCoeff.at<float>(i);
+ 	double fx=camMatrix.at<float>(0,0), fy=camMatrix.at<float>(1,1);
+ 	double cx=camMatrix.at<float>(0,2), cy=camMatrix.at<float>(1,2);
+ 	// in can be out: each point is read before it is written
+ 	for(int i=0; i<n; i++) {
+ 	  double x=(in[i].x-cx)/fx, y=(in[i].y-cy)/fy;
+ 	  double r2=x*x+y*y;
+ 	  double radial=(1+r2*(k[0]+r2*(k[1]+r2*k[4])))/(1+r2*(k[5]+r2*(k[6]+r2*k[7])));
+ 	  double xd=x*radial+2*k[2]*x*y+k[3]*(r2+2*x*x);
+ 	  double yd=y*radial+k[2]*(r2+2*y*y)+2*k[3]*x*y;
+ 	  out[i]=cv::Point2f(xd*fx+cx, yd*fy+cy);
+ 	}
 }
 
 
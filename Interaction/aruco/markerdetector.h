@@ -33,6 +33,9 @@ or implied, of Rafael Muñoz Salinas.
 #include "cameraparameters.h"
 #include "exports.h"
 #include "marker.h"
+#include "adaptivethreshold.h"
+#include "cornerrefiner.h"
+#include "growbuffer.h"
 using namespace std;
 
 namespace aruco
@@ -55,13 +58,51 @@ class ARUCO_EXPORTS  MarkerDetector
     }
     MarkerCandidate & operator=(const  MarkerCandidate &M){
       (*(Marker*)this)=(*(Marker*)&M);
-      contour=M.contour;
+      //as contour=M.contour, but growing with room to spare when it has to, see resizeBuffer()
+      resizeBuffer(contour,M.contour.size());
+      std::copy(M.contour.begin(),M.contour.end(),contour.begin());
       idx=M.idx;
       return *this;
     }
     
     vector<cv::Point> contour;//all the points of its contour
     int idx;//index position in the global contour list
+    vector<cv::Point2f> contour2f,linePoints;//buffers of refineCandidateLines(), not copied
+  };
+
+  /**Candidates of a frame. Only the first size() elements are valid, the others keep their buffers so that a
+   * frame with no more candidates than the previous ones does not allocate
+   */
+  class CandidateList {
+  public:
+    CandidateList():_size(0){}
+    size_t size()const {return _size;}
+    void clear() {_size=0;}
+    MarkerCandidate & operator[](size_t i) {return _items[i];}
+    const MarkerCandidate & operator[](size_t i)const {return _items[i];}
+    //appends a candidate with no corners and an empty contour
+    MarkerCandidate & add() {
+      if (_size==_items.size()) _items.push_back(MarkerCandidate());
+      MarkerCandidate &c=_items[_size++];
+      c.resize(0);
+      c.contour.resize(0);
+      return c;
+    }
+    void add(const MarkerCandidate &c) {
+      add()=c;
+    }
+  private:
+    vector<MarkerCandidate> _items;
+    size_t _size;
+  };
+
+  //buffers of findRectangles()
+  struct RectangleSearch {
+    cv::Mat work;
+    cv::MemStorage storage;//of cvFindContours(), its blocks are reused
+    vector<vector<cv::Point> > contours;//never shrinks, so that the buffers of its elements are kept
+    vector<cv::Point> approxCurve;
+    CandidateList candidates;
   };
 
 public:
@@ -87,6 +128,11 @@ public:
      * @param markerSizeMeters size of the marker sides expressed in meters
      * @param setYPerperdicular If set the Y axis will be perpendicular to the surface. Otherwise, it
      * will be the Z axis
+     *
+     * The buffers of the detection are kept between calls, and so are the elements of detectedMarkers, so pass
+     * the same vector every frame. Once they have grown, the detection does not call operator new, and the only
+     * malloc() calls left are inside OpenCV: one per call in cvFindContours(), those of approxPolyDP() for long
+     * contours, and the extrinsics. replay --check-allocations checks it
      */
     void detect(const cv::Mat &input,
                 std::vector<Marker> &detectedMarkers,
@@ -109,7 +155,7 @@ public:
      */
     void detect(const cv::Mat &input,
                 std::vector<Marker> &detectedMarkers,
-                CameraParameters camParams,
+                const CameraParameters &camParams,
                 float markerSizeMeters=-1,
                 bool setYPerperdicular=false) throw (cv::Exception);
 
@@ -152,15 +198,33 @@ public:
         param2=_thresParam2;
     }
 
+    /**
+     * Enables the multi-threshold mode. Instead of the single pair of setThresholdParams, the image is thresholded
+     * once per pair in params, concurrently, and the rectangles found in all the thresholded images are merged.
+     * Rectangles found by more than one threshold are removed by the too-near test of detectRectangles, keeping the
+     * one with the largest perimeter. Useful under uneven lighting, where a single block size misses some markers.
+     * Only meaningful for ADPT_THRES and FIXED_THRES. An empty vector goes back to the single threshold.
+     *   @param params pairs (param1,param2) with the same meaning as in setThresholdParams
+     */
+    void setMultiThresholdParams(const std::vector<cv::Vec2d> &params);
+
+    /**Returns the pairs of the multi-threshold mode, empty if disabled
+     */
+    const std::vector<cv::Vec2d> &getMultiThresholdParams() const {
+        return _multiThresParams;
+    }
+
 
     /**Returns a reference to the internal image thresholded. It is for visualization purposes and to adjust manually
-     * the parameters
+     * the parameters. In multi-threshold mode, it is the image of the first pair
      */
     const cv::Mat & getThresholdedImage() {
         return thres;
     }
 
-    /**Methods for corner refinement
+    /**Methods for corner refinement. HARRIS and SUBPIX both use CornerRefiner, with a 15x15 window and up to 10
+     * iterations the first and with a 5x5 window and up to 3 iterations (as cv::cornerSubPix in previous versions)
+     * the second. LINES fits a line to the contour points of each side
      */
     enum CornerRefinementMethod {NONE,HARRIS,SUBPIX,LINES};
 
@@ -203,7 +267,8 @@ public:
      *
      * Actually, the main differences are that in highspeed mode, we employ setCornerRefinementMethod(NONE) and
      * internally, we use a small canonical image to detect the marker. In low speed mode, we use
-     * setCornerRefinementMethod(HARRIS) and a bigger size for the canonical marker image
+     * setCornerRefinementMethod(HARRIS) and a bigger size for the canonical marker image.
+     * From 2 on, the adaptive threshold computes the local mean only on even rows.
      */
     void setDesiredSpeed(int val);
     /**
@@ -245,6 +310,12 @@ public:
         markerIdDetector_ptrfunc=markerdetector_func;
     }
 
+    /**Returns the function that identifies the markers, see setMakerDetectorFunction
+     */
+    int (* getMakerDetectorFunction())(const cv::Mat &in,int &nRotations) {
+        return markerIdDetector_ptrfunc;
+    }
+
     /** Use an smaller version of the input image for marker detection. 
      * If your marker is small enough, you can employ an smaller image to perform the detection without
      * noticeable reduction in the precision.
@@ -331,6 +402,20 @@ private:
     * This function returns in candidates all the rectangles found in a thresolded image
     */
     void detectRectangles(const cv::Mat &thresImg,vector<MarkerCandidate> & candidates);
+    /**Rectangles of thresImg in search.candidates, with their corners in anti-clockwise order and their contours
+     */
+    void findRectangles(const cv::Mat &thresImg,RectangleSearch &search);
+    /**Copies to out the candidates of in, except those too near to a candidate with larger perimeter
+     */
+    void removeTooNearCandidates(const CandidateList &in,CandidateList &out);
+    /**Thresholds and finds rectangles once per pair of _multiThresParams, in parallel
+     */
+    void detectRectanglesMultiThreshold(const cv::Mat &img,float red_den,CandidateList &candidates);
+    void thresHold(int method,const cv::Mat &grey,cv::Mat &out,double param1,double param2,AdaptiveThreshold &engine) throw(cv::Exception);
+    /**Canonical images of all the candidates in _warpBuffer (candidate i in rows [i*size,(i+1)*size) ). warped[i] is
+     * false for degenerate candidates
+     */
+    void warpCandidates(const cv::Mat &in,const CandidateList &candidates,int size,vector<char> &warped);
     //Current threshold method
     ThresholdMethods _thresMethod;
     //Threshold parameters
@@ -350,6 +435,48 @@ private:
     int pyrdown_level;
     //Images
     cv::Mat grey,thres,thres2,reduced;
+    //single pass engine for ADPT_THRES, keeps its buffers between frames
+    AdaptiveThreshold _adaptiveThres;
+    //corner refinement of the HARRIS and SUBPIX methods
+    CornerRefiner _harrisRefiner,_subpixRefiner;
+    //refines the corners it tracks with the same method and refiners, see MarkerTracker::relocalize
+    friend class MarkerTracker;
+    //canonical images of the candidates of the last frame, reused between frames
+    cv::Mat _warpBuffer;
+    //multi-threshold mode. Each pass has its own buffers so that passes can run in parallel
+    struct ThresholdPass {
+        AdaptiveThreshold adaptiveThres;
+        cv::Mat thres;
+        RectangleSearch search;
+    };
+    std::vector<cv::Vec2d> _multiThresParams;
+    std::vector<ThresholdPass> _thresPasses;
+    //the other buffers of detect(), reused between frames
+    struct Workspace {
+        vector<cv::Mat> pyramid;
+        RectangleSearch search;//single threshold mode
+        CandidateList joined;//rectangles of all the passes of the multi-threshold mode
+        CandidateList candidates;//rectangles left by the too-near test
+        //too-near test, see findTooNearPairs()
+        vector<cv::Point2f> centers;
+        vector<int> cellX,cellY,cellStart,cellItems,pairStart;
+        vector<std::pair<int,int> > pairs;
+        vector<char> toRemoveCandidates;
+        //identification
+        vector<double> homographies;
+        vector<char> warped;
+        vector<int> ids,rotations;
+        vector<std::pair<int,int> > order;//(id,candidate) of the markers found
+        vector<cv::Point2f> corners;
+        vector<bool> toRemove;
+        //buffers of the elements removed from _candidates when it shrinks
+        vector<std::vector<cv::Point2f> > spareCorners;
+        //elements removed from detectedMarkers, with their corners, Rvec and Tvec
+        vector<Marker> spareMarkers;
+        //no corners and no Rvec,Tvec, so that copying it does not allocate
+        Marker blankMarker;
+    };
+    Workspace _work;
     //pointer to the function that analizes a rectangular region so as to detect its internal marker
     int (* markerIdDetector_ptrfunc)(const cv::Mat &in,int &nRotations);
 
@@ -358,7 +485,7 @@ private:
     bool isInto(cv::Mat &contour,std::vector<cv::Point2f> &b);
     /**
      */
-    int perimeter(std::vector<cv::Point2f> &a);
+    int perimeter(const std::vector<cv::Point2f> &a);
 
     
 //     //GL routines
@@ -378,12 +505,19 @@ private:
     void interpolate2Dline( const vector< cv::Point2f > &inPoints, cv::Point3f &outLine);
     cv::Point2f getCrossPoint(const cv::Point3f& line1, const cv::Point3f& line2);      
 
-    void distortPoints(vector<cv::Point2f> in,
-                       vector<cv::Point2f> &out,
+    void distortPoints(const cv::Point2f *in,
+                       cv::Point2f *out,
+                       int n,
                        const cv::Mat &camMatrix,
                        const cv::Mat &distCoeff);
     
     
+    //reuse of the corner buffers of _candidates and of the elements of detectedMarkers, see Workspace
+    void takeCorners(vector<cv::Point2f> &buffer,size_t inUse);
+    Marker &addMarker(vector<Marker> &markers);
+    void shrinkMarkers(vector<Marker> &markers,size_t n);
+    static void swapMarkers(Marker &a,Marker &b);
+
     /**Given a vector vinout with elements and a boolean vector indicating the lements from it to remove, 
      * this function remove the elements
      * @param vinout
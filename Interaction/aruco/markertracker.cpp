@@ -0,0 +1,193 @@
+#include "markertracker.h"
+#include "threadpool.h"
+#include <cmath>
+#include <algorithm>
+#include <opencv2/imgproc/imgproc.hpp>
+using namespace cv;
+using namespace std;
+
+namespace aruco{
+
+MarkerTracker::MarkerTracker()
+{
+    _sinceDetection=0;
+    _fullInterval=30;
+    _verifyInterval=10;
+    _margin=0.25;
+    _lastFull=false;
+}
+
+void MarkerTracker::setFullDetectionInterval(int frames)
+{
+    _fullInterval=std::max(1,frames);
+}
+
+void MarkerTracker::setVerificationInterval(int frames)
+{
+    _verifyInterval=std::max(1,frames);
+}
+
+void MarkerTracker::setSearchMargin(float margin)
+{
+    _margin=std::max(0.f,margin);
+}
+
+void MarkerTracker::reset()
+{
+    _tracks.clear();
+    _sinceVerified.clear();
+    _sinceDetection=0;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void MarkerTracker::track(const Mat &input,vector<Marker> &detectedMarkers,const CameraParameters &camParams,float markerSizeMeters,bool setYPerpendicular)throw (cv::Exception)
+{
+    bool full=_tracks.empty() || ++_sinceDetection>=_fullInterval;
+
+    if (!full) {
+        if ( input.type() ==CV_8UC3 )   cv::cvtColor ( input,_grey,CV_BGR2GRAY );
+        else     _grey=input;
+
+        vector<char> found(_tracks.size(),0);
+        parallel_for(0,_tracks.size(),[&](int begin,int end) {
+            AdaptiveThreshold thresholder;
+            MarkerDetector::MarkerCandidate lineCandidate;
+            for (int i=begin;i<end;i++) {
+                bool verify=++_sinceVerified[i]>=_verifyInterval;
+                found[i]=relocalize(_tracks[i],verify,thresholder,lineCandidate,camParams);
+                if (verify) _sinceVerified[i]=0;
+            }
+        });
+        //a lost marker might be somewhere else in the image
+        for (size_t i=0;i<found.size();i++)
+            if (!found[i]) full=true;
+    }
+
+    _lastFull=full;
+    if (full) {
+        _mdetector.detect(input,detectedMarkers,camParams,markerSizeMeters,setYPerpendicular);
+        _tracks=detectedMarkers;
+        _sinceVerified.assign(_tracks.size(),0);
+        _sinceDetection=0;
+        return;
+    }
+
+    detectedMarkers=_tracks;
+    if (camParams.isValid() && markerSizeMeters>0)
+        for (size_t i=0;i<detectedMarkers.size();i++)
+            detectedMarkers[i].calculateExtrinsics(markerSizeMeters,camParams,setYPerpendicular);
+}
+
+/************************************
+ *
+ * Looks for marker in a window around its corners. On success the corners are updated and keep their order
+ *
+ ************************************/
+bool MarkerTracker::relocalize(Marker &marker,bool verify,AdaptiveThreshold &thresholder,
+                               MarkerDetector::MarkerCandidate &lineCandidate,const CameraParameters &camParams)
+{
+    float perimeter=0;
+    for (int c=0;c<4;c++) perimeter+=norm(marker[c]-marker[(c+1)%4]);
+    float side=perimeter/4;
+
+    Rect box=boundingRect(Mat(marker));
+    int margin=std::max(8,int(_margin*side));
+    Rect window(box.x-margin,box.y-margin,box.width+2*margin,box.height+2*margin);
+    window&=Rect(0,0,_grey.cols,_grey.rows);
+    if (window.width<8 || window.height<8) return false;
+
+    //threshold the window with the parameters of the detector
+    double param1,param2;
+    _mdetector.getThresholdParams(param1,param2);
+    int blockSize=std::max(3,int(param1)|1);
+    Mat thres;
+    if (_mdetector.getThresholdMethod()==MarkerDetector::FIXED_THRES)
+        cv::threshold(_grey(window),thres,param1,255,CV_THRESH_BINARY_INV);
+    else
+        thresholder.apply(_grey(window),thres,blockSize,param2);
+
+    vector<vector<Point> > contours;
+    findContours(thres,contours,CV_RETR_LIST,CV_CHAIN_APPROX_NONE,window.tl());
+
+    //the quadrilateral with the corners closest to the last ones, in any order
+    vector<Point2f> best;
+    size_t bestContour=0;
+    float bestDist=std::max(3.f,0.15f*side);
+    vector<Point> approxCurve;
+    for (size_t i=0;i<contours.size();i++) {
+        if (contours[i].size()<0.5*perimeter || contours[i].size()>2*perimeter) continue;
+        approxPolyDP(contours[i],approxCurve,double(contours[i].size())*0.05,true);
+        if (approxCurve.size()!=4 || !isContourConvex(Mat(approxCurve))) continue;
+
+        for (int dir=0;dir<2;dir++)
+            for (int rot=0;rot<4;rot++) {
+                float dist=0;
+                for (int c=0;c<4;c++) {
+                    int k=dir==0 ? (c+rot)%4 : (rot-c+4)%4;
+                    dist+=norm(Point2f(approxCurve[k].x,approxCurve[k].y)-marker[c]);
+                }
+                dist/=4;
+                if (dist<bestDist) {
+                    bestDist=dist;
+                    bestContour=i;
+                    best.resize(4);
+                    for (int c=0;c<4;c++) {
+                        int k=dir==0 ? (c+rot)%4 : (rot-c+4)%4;
+                        best[c]=Point2f(approxCurve[k].x,approxCurve[k].y);
+                    }
+                }
+            }
+    }
+    if (best.empty()) return false;
+
+    refineCorners(best,contours[bestContour],lineCandidate,camParams);
+
+    if (verify) {
+        Mat canonicalMarker;
+        int warpSize=_mdetector.getWarpSize();
+        if (!_mdetector.warp(_grey,canonicalMarker,Size(warpSize,warpSize),best)) return false;
+        int nRotations;
+        int id=(*_mdetector.getMakerDetectorFunction())(canonicalMarker,nRotations);
+        if (id!=marker.id) return false;
+        //as in MarkerDetector::detect, so that the first corner is always the same one
+        std::rotate(best.begin(),best.begin()+4-nRotations,best.end());
+    }
+
+    for (int c=0;c<4;c++) marker[c]=best[c];
+    return true;
+}
+
+/************************************
+ *
+ * Same refinement as MarkerDetector::detect for its corner method. corners must be points of contour, as left by
+ * approxPolyDP, for LINES to find the sides
+ *
+ ************************************/
+void MarkerTracker::refineCorners(vector<Point2f> &corners,const vector<Point> &contour,
+                                  MarkerDetector::MarkerCandidate &lineCandidate,const CameraParameters &camParams)
+{
+    switch (_mdetector.getCornerRefinementMethod()) {
+    case MarkerDetector::HARRIS:
+        for (int c=0;c<4;c++) _mdetector._harrisRefiner.refineCorner(_grey,corners[c]);
+        break;
+    case MarkerDetector::SUBPIX:
+        for (int c=0;c<4;c++) _mdetector._subpixRefiner.refineCorner(_grey,corners[c]);
+        break;
+    case MarkerDetector::LINES: {
+        lineCandidate.assign(corners.begin(),corners.end());
+        lineCandidate.contour.assign(contour.begin(),contour.end());
+        _mdetector.refineCandidateLines(lineCandidate,camParams.CameraMatrix,camParams.Distorsion);
+        for (int c=0;c<4;c++) corners[c]=lineCandidate[c];
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+}
@@ -0,0 +1,96 @@
+#ifndef aruco_MARKERTRACKER_HPP
+#define aruco_MARKERTRACKER_HPP
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "exports.h"
+#include "marker.h"
+#include "cameraparameters.h"
+#include "markerdetector.h"
+#include "adaptivethreshold.h"
+
+namespace aruco
+{
+
+/**\brief Detects markers in a video, re-localizing the ones of the previous frame instead of detecting from scratch
+ *
+ * Each marker found in the previous frame is searched only inside a window around its last corners: the window is
+ * thresholded, the quadrilateral closest to the last corners is taken and its corners are refined. The id is checked
+ * again (warp and decoding) only every few frames. The full MarkerDetector::detect runs on the first frame, every
+ * setFullDetectionInterval() frames (to find markers that entered the image) and whenever a marker is lost.
+ *
+ * With a fixed camera and markers that move little, most frames only cost a few small windows.
+ * \code
+  MarkerTracker MT;
+  MT.getMarkerDetector().setThresholdParams(7,7);
+  vector<Marker> markers;
+  while (capture_image(im))
+      MT.track(im,markers,CP,0.05);
+ \endcode
+ */
+class ARUCO_EXPORTS MarkerTracker
+{
+public:
+    MarkerTracker();
+
+    /**Markers in input, as MarkerDetector::detect, using the markers of the previous call when possible
+     * @param input input color or grey image
+     * @param detectedMarkers output vector with the markers
+     * @param camParams camera parameters, if valid and markerSizeMeters>0 the extrinsics are calculated
+     * @param markerSizeMeters size of the marker sides expressed in meters
+     * @param setYPerpendicular see MarkerDetector::detect
+     */
+    void track(const cv::Mat &input,
+               std::vector<Marker> &detectedMarkers,
+               const CameraParameters &camParams=CameraParameters(),
+               float markerSizeMeters=-1,
+               bool setYPerpendicular=false) throw (cv::Exception);
+
+    /**Returns a reference to the internal marker detector, used for full detections. Its threshold parameters and
+     * corner refinement method are also used in the windows, so tracked corners are refined as detect() does
+     */
+    MarkerDetector &getMarkerDetector(){return _mdetector;}
+
+    /**Runs the full detection at least every frames frames (default 30). 1 detects on every frame
+     */
+    void setFullDetectionInterval(int frames);
+    int getFullDetectionInterval()const{return _fullInterval;}
+
+    /**Checks the id of each tracked marker every frames frames (default 10)
+     */
+    void setVerificationInterval(int frames);
+    int getVerificationInterval()const{return _verifyInterval;}
+
+    /**Margin around the last corners of a marker where it is searched, as a fraction of its side (default 0.25)
+     */
+    void setSearchMargin(float margin);
+    float getSearchMargin()const{return _margin;}
+
+    /**Forgets the tracked markers, so that the next call runs the full detection
+     */
+    void reset();
+
+    /**Indicates if the last call to track ran the full detection
+     */
+    bool wasFullDetection()const{return _lastFull;}
+
+private:
+    MarkerDetector _mdetector;
+    std::vector<Marker> _tracks;
+    std::vector<int> _sinceVerified;
+    int _sinceDetection;
+    int _fullInterval,_verifyInterval;
+    float _margin;
+    bool _lastFull;
+    cv::Mat _grey;
+
+    //thresholder and lineCandidate are buffers of the calling thread
+    bool relocalize(Marker &marker,bool verify,AdaptiveThreshold &thresholder,MarkerDetector::MarkerCandidate &lineCandidate,
+                    const CameraParameters &camParams);
+    void refineCorners(std::vector<cv::Point2f> &corners,const std::vector<cv::Point> &contour,
+                       MarkerDetector::MarkerCandidate &lineCandidate,const CameraParameters &camParams);
+};
+
+}
+
+#endif // aruco_MARKERTRACKER_HPP
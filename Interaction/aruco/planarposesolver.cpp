@@ -0,0 +1,388 @@
+#include "planarposesolver.h"
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace cv;
+
+namespace aruco{
+
+PlanarPoseSolver::PlanarPoseSolver()
+{
+    _iterations=3;
+    _hasPrevious=false;
+    _error=0;
+}
+
+//the pose closer to the previous one is kept while its squared error is at most this times the other one
+static const double AMBIGUITY_RATIO=4;
+
+void PlanarPoseSolver::setRefinementIterations(int n)
+{
+    _iterations=std::max(0,n);
+}
+
+/************************************
+ *
+ * Solves A x = b by gaussian elimination with partial pivoting. A is n x n, row major, and is destroyed. b is
+ * replaced by x. Returns false if A is singular
+ *
+ ************************************/
+static bool solveLinear(double *A,double *b,int n)
+{
+    for (int c=0;c<n;c++) {
+        int pivot=c;
+        for (int r=c+1;r<n;r++)
+            if (fabs(A[r*n+c])>fabs(A[pivot*n+c])) pivot=r;
+        if (fabs(A[pivot*n+c])<1e-12) return false;
+        if (pivot!=c) {
+            for (int k=c;k<n;k++) std::swap(A[c*n+k],A[pivot*n+k]);
+            std::swap(b[c],b[pivot]);
+        }
+        for (int r=c+1;r<n;r++) {
+            double f=A[r*n+c]/A[c*n+c];
+            for (int k=c;k<n;k++) A[r*n+k]-=f*A[c*n+k];
+            b[r]-=f*b[c];
+        }
+    }
+    for (int r=n-1;r>=0;r--) {
+        double s=b[r];
+        for (int k=r+1;k<n;k++) s-=A[r*n+k]*b[k];
+        b[r]=s/A[r*n+r];
+    }
+    return true;
+}
+
+static double element(const Mat &m,int i)
+{
+    int r=i/m.cols,c=i%m.cols;
+    return m.type()==CV_64FC1 ? m.at<double>(r,c) : m.at<float>(r,c);
+}
+
+/************************************
+ *
+ * Undistorted normalized coordinates of the image points, as cv::undistortPoints. Returns sqrt(fx*fy), to express
+ * the errors in pixels
+ *
+ ************************************/
+static double normalizePoints(const Point2f imgPoints[4],const Mat &camMatrix,const Mat &distCoeff,double img[4][2])
+{
+    double fx=element(camMatrix,0),cx=element(camMatrix,2),fy=element(camMatrix,4),cy=element(camMatrix,5);
+    double k[5]={0,0,0,0,0};
+    int nk=std::min(int(distCoeff.total()),5);
+    bool distorted=false;
+    for (int i=0;i<nk;i++) {
+        k[i]=element(distCoeff,i);
+        distorted|=k[i]!=0;
+    }
+    for (int i=0;i<4;i++) {
+        double x0=(imgPoints[i].x-cx)/fx,y0=(imgPoints[i].y-cy)/fy;
+        double x=x0,y=y0;
+        if (distorted) {
+            for (int it=0;it<5;it++) {
+                double r2=x*x+y*y;
+                double icdist=1./(1+((k[4]*r2+k[1])*r2+k[0])*r2);
+                double dx=2*k[2]*x*y+k[3]*(r2+2*x*x);
+                double dy=k[2]*(r2+2*y*y)+2*k[3]*x*y;
+                x=(x0-dx)*icdist;
+                y=(y0-dy)*icdist;
+            }
+        }
+        img[i][0]=x;
+        img[i][1]=y;
+    }
+    return sqrt(fx*fy);
+}
+
+/************************************
+ *
+ * Homography H (row major, H[8]=1) that maps src[i] to dst[i]. Returns false if three of the points are aligned
+ *
+ ************************************/
+static bool homography(const double src[4][2],const double dst[4][2],double H[9])
+{
+    double A[64],b[8];
+    for (int i=0;i<4;i++) {
+        double x=src[i][0],y=src[i][1],u=dst[i][0],v=dst[i][1];
+        double *r0=A+16*i,*r1=r0+8;
+        r0[0]=x; r0[1]=y; r0[2]=1; r0[3]=0; r0[4]=0; r0[5]=0; r0[6]=-u*x; r0[7]=-u*y;
+        r1[0]=0; r1[1]=0; r1[2]=0; r1[3]=x; r1[4]=y; r1[5]=1; r1[6]=-v*x; r1[7]=-v*y;
+        b[2*i]=u;
+        b[2*i+1]=v;
+    }
+    if (!solveLinear(A,b,8)) return false;
+    for (int i=0;i<8;i++) H[i]=b[i];
+    H[8]=1;
+    return true;
+}
+
+/************************************
+ *
+ * The two rotations of IPPE, from the jacobian J of the homography at a point of the plane and the normalized
+ * image (p,q) of that point. Direct port of IPPE_computeRotations of the reference implementation
+ *
+ ************************************/
+static bool ippeRotations(double j00,double j01,double j10,double j11,double p,double q,double R1[9],double R2[9])
+{
+    //Rv, rotation that takes the z axis to the line of sight of (p,q)
+    double n=sqrt(p*p+q*q+1);
+    double ax=p/n,ay=q/n,az=1/n;
+    double d=1./(1+az);
+    double rv[9]={1-ax*ax*d,-ax*ay*d,ax,
+                  -ax*ay*d,1-ay*ay*d,ay,
+                  -ax,-ay,1-(ax*ax+ay*ay)*d};
+
+    double b00=rv[0]-p*rv[6],b01=rv[1]-p*rv[7];
+    double b10=rv[3]-q*rv[6],b11=rv[4]-q*rv[7];
+    double det=b00*b11-b01*b10;
+    if (fabs(det)<DBL_EPSILON) return false;
+    double binv00=b11/det,binv01=-b01/det,binv10=-b10/det,binv11=b00/det;
+
+    double a00=binv00*j00+binv01*j10,a01=binv00*j01+binv01*j11;
+    double a10=binv10*j00+binv11*j10,a11=binv10*j01+binv11*j11;
+
+    //largest singular value of A
+    double ata00=a00*a00+a01*a01,ata01=a00*a10+a01*a11,ata11=a10*a10+a11*a11;
+    double gamma=sqrt(0.5*(ata00+ata11+sqrt((ata00-ata11)*(ata00-ata11)+4*ata01*ata01)));
+    if (!(gamma>FLT_EPSILON)) return false;
+
+    double r00=a00/gamma,r01=a01/gamma,r10=a10/gamma,r11=a11/gamma;
+    double c0=sqrt(std::max(0.,1-r00*r00-r10*r10));
+    double c1=sqrt(std::max(0.,1-r01*r01-r11*r11));
+    if (-r00*r01-r10*r11<0) c1=-c1;
+
+    //both are Rv times a rotation whose third row changes sign
+    double m[2][9];
+    for (int s=0;s<2;s++) {
+        double b0=s==0 ? c0 : -c0,b1=s==0 ? c1 : -c1;
+        double *M=m[s];
+        M[0]=r00; M[1]=r01; M[2]=b1*r10-b0*r11;
+        M[3]=r10; M[4]=r11; M[5]=b0*r01-b1*r00;
+        M[6]=b0;  M[7]=b1;  M[8]=r00*r11-r01*r10;
+    }
+    for (int i=0;i<3;i++)
+        for (int j=0;j<3;j++) {
+            R1[i*3+j]=rv[i*3]*m[0][j]+rv[i*3+1]*m[0][3+j]+rv[i*3+2]*m[0][6+j];
+            R2[i*3+j]=rv[i*3]*m[1][j]+rv[i*3+1]*m[1][3+j]+rv[i*3+2]*m[1][6+j];
+        }
+    return true;
+}
+
+/************************************
+ *
+ * Translation that minimizes the algebraic error of the projection of the points with rotation R
+ *
+ ************************************/
+static bool translation(const double R[9],const double obj[4][2],const double img[4][2],double t[3])
+{
+    double A[9]={0,0,0,0,0,0,0,0,0};
+    double b[3]={0,0,0};
+    for (int i=0;i<4;i++) {
+        double u=img[i][0],v=img[i][1];
+        double q0=R[0]*obj[i][0]+R[1]*obj[i][1];
+        double q1=R[3]*obj[i][0]+R[4]*obj[i][1];
+        double q2=R[6]*obj[i][0]+R[7]*obj[i][1];
+        //rows (1,0,-u) and (0,1,-v)
+        double e0=u*q2-q0,e1=v*q2-q1;
+        A[0]+=1; A[2]-=u;
+        A[4]+=1; A[5]-=v;
+        A[8]+=u*u+v*v;
+        b[0]+=e0; b[1]+=e1; b[2]-=u*e0+v*e1;
+    }
+    A[6]=A[2];
+    A[7]=A[5];
+    if (!solveLinear(A,b,3)) return false;
+    t[0]=b[0]; t[1]=b[1]; t[2]=b[2];
+    return true;
+}
+
+/************************************
+ *
+ * Sum of the squared reprojection errors, DBL_MAX if a point is behind the camera
+ *
+ ************************************/
+static double squaredError(const double R[9],const double t[3],const double obj[4][2],const double img[4][2])
+{
+    double sum=0;
+    for (int i=0;i<4;i++) {
+        double X=R[0]*obj[i][0]+R[1]*obj[i][1]+t[0];
+        double Y=R[3]*obj[i][0]+R[4]*obj[i][1]+t[1];
+        double Z=R[6]*obj[i][0]+R[7]*obj[i][1]+t[2];
+        if (Z<=0) return DBL_MAX;
+        double ex=X/Z-img[i][0],ey=Y/Z-img[i][1];
+        sum+=ex*ex+ey*ey;
+    }
+    return sum;
+}
+
+/************************************
+ *
+ * One Gauss-Newton step on the reprojection error. The rotation is updated as exp([w]x)*R
+ *
+ ************************************/
+static void gaussNewtonStep(double R[9],double t[3],const double obj[4][2],const double img[4][2])
+{
+    double A[36],g[6];
+    std::fill(A,A+36,0.);
+    std::fill(g,g+6,0.);
+    for (int i=0;i<4;i++) {
+        double q0=R[0]*obj[i][0]+R[1]*obj[i][1];
+        double q1=R[3]*obj[i][0]+R[4]*obj[i][1];
+        double q2=R[6]*obj[i][0]+R[7]*obj[i][1];
+        double X=q0+t[0],Y=q1+t[1],Z=q2+t[2];
+        double iz=1./Z,xz=X*iz*iz,yz=Y*iz*iz;
+        double e[2]={X*iz-img[i][0],Y*iz-img[i][1]};
+        //d(X,Y,Z)/dw = -[q]x, d(X,Y,Z)/dt = I
+        double J[2][6]={{-xz*q1,iz*q2+xz*q0,-iz*q1,iz,0,-xz},
+                        {-iz*q2-yz*q1,yz*q0,iz*q0,0,iz,-yz}};
+        for (int k=0;k<2;k++)
+            for (int r=0;r<6;r++) {
+                g[r]-=J[k][r]*e[k];
+                for (int c=0;c<6;c++) A[r*6+c]+=J[k][r]*J[k][c];
+            }
+    }
+    if (!solveLinear(A,g,6)) return;
+    double dR[9],Rn[9];
+    PlanarPoseSolver::rodriguesToMatrix(g,dR);
+    for (int r=0;r<3;r++)
+        for (int c=0;c<3;c++) Rn[r*3+c]=dR[r*3]*R[c]+dR[r*3+1]*R[3+c]+dR[r*3+2]*R[6+c];
+    std::copy(Rn,Rn+9,R);
+    t[0]+=g[3]; t[1]+=g[4]; t[2]+=g[5];
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+bool PlanarPoseSolver::solve(const float objPoints[12],const Point2f imgPoints[4],const Mat &camMatrix,const Mat &distCoeff,
+                             double rvec[3],double tvec[3])
+{
+    //object points relative to their centroid, where IPPE takes the jacobian of the homography
+    double cx=0,cy=0;
+    for (int i=0;i<4;i++) {
+        cx+=objPoints[3*i]/4.;
+        cy+=objPoints[3*i+1]/4.;
+    }
+    double obj[4][2],extent=0;
+    for (int i=0;i<4;i++) {
+        obj[i][0]=objPoints[3*i]-cx;
+        obj[i][1]=objPoints[3*i+1]-cy;
+        extent=std::max(extent,std::max(fabs(obj[i][0]),fabs(obj[i][1])));
+    }
+    if (!(extent>0)) return false;
+    for (int i=0;i<4;i++)
+        if (fabs(objPoints[3*i+2])>1e-6*extent) return false;
+
+    double img[4][2];
+    double focal=normalizePoints(imgPoints,camMatrix,distCoeff,img);
+
+    //the homography is solved with the points scaled to [-1,1], and then brought back to the centered points
+    double scaled[4][2],H[9];
+    for (int i=0;i<4;i++) {
+        scaled[i][0]=obj[i][0]/extent;
+        scaled[i][1]=obj[i][1]/extent;
+    }
+    if (!homography(scaled,img,H)) return false;
+    H[0]/=extent; H[1]/=extent;
+    H[3]/=extent; H[4]/=extent;
+    H[6]/=extent; H[7]/=extent;
+
+    //image of the centroid and jacobian of the homography there
+    double p=H[2]/H[8],q=H[5]/H[8];
+    double j00=(H[0]-H[6]*p)/H[8],j01=(H[1]-H[7]*p)/H[8];
+    double j10=(H[3]-H[6]*q)/H[8],j11=(H[4]-H[7]*q)/H[8];
+    double R[2][9],t[2][3],err[2];
+    if (!ippeRotations(j00,j01,j10,j11,p,q,R[0],R[1])) return false;
+    //both poses are refined before choosing, the closed form one with the smaller error is often the wrong one
+    for (int k=0;k<2;k++) {
+        err[k]=translation(R[k],obj,img,t[k]) ? squaredError(R[k],t[k],obj,img) : DBL_MAX;
+        for (int it=0;it<_iterations && err[k]!=DBL_MAX;it++) {
+            double Rn[9],tn[3];
+            std::copy(R[k],R[k]+9,Rn);
+            std::copy(t[k],t[k]+3,tn);
+            gaussNewtonStep(Rn,tn,obj,img);
+            double en=squaredError(Rn,tn,obj,img);
+            if (!(en<err[k])) break;
+            std::copy(Rn,Rn+9,R[k]);
+            std::copy(tn,tn+3,t[k]);
+            err[k]=en;
+        }
+    }
+
+    int best=err[1]<err[0] ? 1 : 0;
+    if (err[best]==DBL_MAX) return false;
+    if (_hasPrevious && err[1-best]!=DBL_MAX) {
+        //the closer rotation has the larger trace of previous^T*R
+        double dot[2]={0,0};
+        for (int k=0;k<2;k++)
+            for (int i=0;i<9;i++) dot[k]+=_previousR[i]*R[k][i];
+        int closer=dot[1]>dot[0] ? 1 : 0;
+        if (err[closer]<=AMBIGUITY_RATIO*err[best]+1e-12) best=closer;
+    }
+    const double *Rb=R[best],*tb=t[best];
+    double e=err[best];
+
+    _error=sqrt(e/4)*focal;
+    std::copy(Rb,Rb+9,_previousR);
+    _hasPrevious=true;
+
+    //back to the frame of the object points: R*(P-c)+t
+    matrixToRodrigues(Rb,rvec);
+    tvec[0]=tb[0]-Rb[0]*cx-Rb[1]*cy;
+    tvec[1]=tb[1]-Rb[3]*cx-Rb[4]*cy;
+    tvec[2]=tb[2]-Rb[6]*cx-Rb[7]*cy;
+    return true;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void PlanarPoseSolver::rodriguesToMatrix(const double rvec[3],double R[9])
+{
+    double theta=sqrt(rvec[0]*rvec[0]+rvec[1]*rvec[1]+rvec[2]*rvec[2]);
+    if (theta<DBL_EPSILON) {
+        for (int i=0;i<9;i++) R[i]=i%4==0 ? 1 : 0;
+        return;
+    }
+    double x=rvec[0]/theta,y=rvec[1]/theta,z=rvec[2]/theta;
+    double c=cos(theta),s=sin(theta),c1=1-c;
+    R[0]=c+c1*x*x;   R[1]=c1*x*y-s*z; R[2]=c1*x*z+s*y;
+    R[3]=c1*x*y+s*z; R[4]=c+c1*y*y;   R[5]=c1*y*z-s*x;
+    R[6]=c1*x*z-s*y; R[7]=c1*y*z+s*x; R[8]=c+c1*z*z;
+}
+
+/************************************
+ *
+ * Same cases as cv::Rodrigues, including angles close to pi
+ *
+ ************************************/
+void PlanarPoseSolver::matrixToRodrigues(const double R[9],double rvec[3])
+{
+    double rx=R[7]-R[5],ry=R[2]-R[6],rz=R[3]-R[1];
+    double s=sqrt((rx*rx+ry*ry+rz*rz)*0.25);
+    double c=std::max(-1.,std::min(1.,(R[0]+R[4]+R[8]-1)*0.5));
+    if (s<1e-5) {
+        if (c>0) {
+            rvec[0]=rvec[1]=rvec[2]=0;
+            return;
+        }
+        //angle pi, the axis is the column of (R+I)/2 with the largest diagonal element
+        rx=sqrt(std::max((R[0]+1)*0.5,0.));
+        ry=sqrt(std::max((R[4]+1)*0.5,0.))*(R[1]<0 ? -1. : 1.);
+        rz=sqrt(std::max((R[8]+1)*0.5,0.))*(R[2]<0 ? -1. : 1.);
+        if (fabs(rx)<fabs(ry) && fabs(rx)<fabs(rz) && (R[5]>0)!=(ry*rz>0)) rz=-rz;
+        double theta=sqrt(rx*rx+ry*ry+rz*rz);
+        double f=theta>0 ? CV_PI/theta : 0;
+        rvec[0]=rx*f; rvec[1]=ry*f; rvec[2]=rz*f;
+        return;
+    }
+    double f=atan2(s,c)/(2*s);
+    rvec[0]=rx*f; rvec[1]=ry*f; rvec[2]=rz*f;
+}
+
+}
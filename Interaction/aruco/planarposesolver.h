@@ -0,0 +1,71 @@
+#ifndef aruco_PLANARPOSESOLVER_HPP
+#define aruco_PLANARPOSESOLVER_HPP
+
+#include <opencv2/core/core.hpp> // Basic OpenCV structures (cv::Mat)
+#include "exports.h"
+
+namespace aruco
+{
+
+/**
+ * Pose of four coplanar points in closed form, used instead of cv::solvePnP for the hand model.
+ *
+ * The object points must be on the plane z=0, as the model of HandTracker::handModel. The image points are
+ * undistorted and normalized, the homography from the plane to the image is solved exactly from the four
+ * correspondences and decomposed with IPPE (T. Collins and A. Bartoli, "Infinitesimal Plane-based Pose Estimation",
+ * IJCV 2014): from the homography and its jacobian at the centroid of the points it gives the two poses that a plane
+ * can have, and the one with the smaller reprojection error is kept. It is then refined with a few Gauss-Newton
+ * steps on the reprojection error (three by default).
+ *
+ * When the plane is seen almost frontally both poses have similar errors and the noise of the points decides
+ * between them, so the solver remembers its last solution: the pose closer to it is taken unless its error is more
+ * than twice the error of the other one. Use one instance per tracked object and call reset() when it is lost.
+ *
+ * There are no cv::Mat nor heap allocations, all the math is done on fixed size arrays.
+ */
+class ARUCO_EXPORTS PlanarPoseSolver
+{
+public:
+    PlanarPoseSolver();
+
+    /**
+     * @param objPoints x,y,z of the four object points, z must be 0
+     * @param imgPoints the projections of the four points in the image
+     * @param camMatrix 3x3 camera matrix, CV_32F or CV_64F
+     * @param distCoeff k1,k2,p1,p2[,k3], or empty
+     * @param rvec output rotation, as a Rodrigues vector
+     * @param tvec output translation
+     * @return false if the points are not on z=0, three of them are aligned, or the plane is seen edge-on. Then rvec
+     * and tvec are not modified
+     */
+    bool solve(const float objPoints[12],const cv::Point2f imgPoints[4],const cv::Mat &camMatrix,const cv::Mat &distCoeff,
+               double rvec[3],double tvec[3]);
+
+    /**Gauss-Newton steps after the closed form solution, 0 to keep it as is. Default 3
+     */
+    void setRefinementIterations(int n);
+    int getRefinementIterations()const{return _iterations;}
+
+    /**Forgets the last solution
+     */
+    void reset(){_hasPrevious=false;}
+
+    /**RMS reprojection error of the last solution, in pixels (of the undistorted image)
+     */
+    double getReprojectionError()const{return _error;}
+
+    /**Rotation matrix (row major) of a Rodrigues vector and back, as cv::Rodrigues
+     */
+    static void rodriguesToMatrix(const double rvec[3],double R[9]);
+    static void matrixToRodrigues(const double R[9],double rvec[3]);
+
+private:
+    int _iterations;
+    bool _hasPrevious;
+    double _previousR[9];
+    double _error;
+};
+
+}
+
+#endif // aruco_PLANARPOSESOLVER_HPP
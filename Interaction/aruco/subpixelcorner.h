@@ -13,7 +13,6 @@ private:
     int _apertureSize;
     cv::TermCriteria _term;
     double eps;
-    cv::Mat mask;
     int _max_iters;
 public:
     bool enable;
@@ -23,12 +22,9 @@ public:
 
     double pointDist(cv::Point2f estimate_corner,cv::Point2f curr_corner);
 
-    ///method to refine the corners
+    ///method to refine the corners. Runs CornerRefiner with a window of _winSize and the termination criteria
     void RefineCorner(cv::Mat image,std::vector <cv::Point2f> &corners);
 
-    //function to generate the mask
-    void generateMask();
-
 
 };
 
@@ -0,0 +1,230 @@
+#include "threadpool.h"
+#include <algorithm>
+
+namespace aruco{
+
+//set in the pool threads and in the caller while it runs a loop, so that nested loops run serially
+static thread_local bool t_inLoop=false;
+
+ThreadPool &ThreadPool::instance()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+ThreadPool::ThreadPool()
+{
+    _numThreads=0;
+    _generation=0;
+    _stop=false;
+    _pending=0;
+    _body=0;
+    _grain=1;
+}
+
+ThreadPool::~ThreadPool()
+{
+    stop();
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void ThreadPool::setNumThreads(int n)
+{
+    std::lock_guard<std::mutex> run(_runLock);
+    stop();
+    start(n);
+}
+
+int ThreadPool::getNumThreads()
+{
+    //inside a loop body the caller already holds _runLock (or a worker runs for it), and _numThreads can not change
+    if (t_inLoop) return _numThreads;
+    std::lock_guard<std::mutex> run(_runLock);
+    if (_numThreads==0) start(0);
+    return _numThreads;
+}
+
+/************************************
+ *
+ * Called with _runLock held
+ *
+ ************************************/
+void ThreadPool::start(int n)
+{
+    if (n<=0) n=std::max(1u,std::thread::hardware_concurrency());
+    _numThreads=n;
+    _ranges.reset(new Range[n]);
+    for (int i=0;i<n;i++) _ranges[i].begin=_ranges[i].end=0;
+
+    _stop=false;
+    for (int i=1;i<n;i++) _threads.push_back(std::thread(&ThreadPool::workerLoop,this,i));
+}
+
+void ThreadPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _stop=true;
+    }
+    _wake.notify_all();
+    for (size_t i=0;i<_threads.size();i++) _threads[i].join();
+    _threads.clear();
+    _numThreads=0;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void ThreadPool::workerLoop(int index)
+{
+    t_inLoop=true;
+    unsigned int generation=0;
+    for (;;) {
+        const std::function<void(int,int)> *body;
+        int grain;
+        {
+            std::unique_lock<std::mutex> lock(_lock);
+            while (!_stop && _generation==generation) _wake.wait(lock);
+            if (_stop) return;
+            generation=_generation;
+            body=_body;
+            grain=_grain;
+        }
+
+        runChunks(index,*body,grain);
+
+        std::lock_guard<std::mutex> lock(_lock);
+        if (--_pending==0) _done.notify_one();
+    }
+}
+
+void ThreadPool::runChunks(int index,const std::function<void(int,int)> &body,int grain)
+{
+    int b,e;
+    while (pop(index,grain,b,e) || steal(index,grain,b,e)) {
+        try {
+            body(b,e);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(_lock);
+            if (!_error) _error=std::current_exception();
+        }
+    }
+}
+
+/************************************
+ *
+ * Next chunk from the front of the own range
+ *
+ ************************************/
+bool ThreadPool::pop(int index,int grain,int &b,int &e)
+{
+    Range &r=_ranges[index];
+    std::lock_guard<std::mutex> lock(r.lock);
+    if (r.begin>=r.end) return false;
+    b=r.begin;
+    e=std::min(r.end,r.begin+grain);
+    r.begin=e;
+    return true;
+}
+
+/************************************
+ *
+ * Takes half of the range of another thread (from the back, away from its owner) and starts on it
+ *
+ ************************************/
+bool ThreadPool::steal(int index,int grain,int &b,int &e)
+{
+    for (int k=1;k<_numThreads;k++) {
+        Range &victim=_ranges[(index+k)%_numThreads];
+        int sb,se;
+        {
+            std::lock_guard<std::mutex> lock(victim.lock);
+            int left=victim.end-victim.begin;
+            if (left<=0) continue;
+            int take=left>grain ? std::max(grain,left/2) : left;
+            sb=victim.end-take;
+            se=victim.end;
+            victim.end=sb;
+        }
+        {
+            std::lock_guard<std::mutex> lock(_ranges[index].lock);
+            _ranges[index].begin=sb;
+            _ranges[index].end=se;
+        }
+        return pop(index,grain,b,e);
+    }
+    return false;
+}
+
+/************************************
+ *
+ *
+ *
+ *
+ ************************************/
+void ThreadPool::parallel_for(int begin,int end,const std::function<void(int,int)> &body,int grain)
+{
+    if (end<=begin) return;
+    if (grain<1) grain=1;
+
+    //nested loop, or another thread is running one: serial
+    if (t_inLoop || end-begin<=grain || !_runLock.try_lock()) {
+        body(begin,end);
+        return;
+    }
+    std::lock_guard<std::mutex> run(_runLock,std::adopt_lock);
+    if (_numThreads==0) start(0);
+    if (_numThreads==1) {
+        t_inLoop=true;
+        try {
+            body(begin,end);
+        }
+        catch (...) {
+            t_inLoop=false;
+            throw;
+        }
+        t_inLoop=false;
+        return;
+    }
+
+    int n=end-begin;
+    for (int i=0;i<_numThreads;i++) {
+        std::lock_guard<std::mutex> lock(_ranges[i].lock);
+        _ranges[i].begin=begin+int((long long)n*i/_numThreads);
+        _ranges[i].end=begin+int((long long)n*(i+1)/_numThreads);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _body=&body;
+        _grain=grain;
+        _pending=_numThreads-1;
+        _error=std::exception_ptr();
+        _generation++;
+    }
+    _wake.notify_all();
+
+    t_inLoop=true;
+    runChunks(0,body,grain);
+    t_inLoop=false;
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(_lock);
+        while (_pending>0) _done.wait(lock);
+        error=_error;
+        _error=std::exception_ptr();
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+}
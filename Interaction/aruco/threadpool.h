@@ -0,0 +1,92 @@
+#ifndef aruco_THREADPOOL_HPP
+#define aruco_THREADPOOL_HPP
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include "exports.h"
+
+namespace aruco
+{
+
+/**
+ * Persistent pool of worker threads used by the parallel loops of the library, with or without OpenMP.
+ *
+ * parallel_for splits [begin,end) in one contiguous range per thread. Each thread takes chunks of grain iterations
+ * from the front of its own range and, when it runs out, steals half of what is left at the back of another one.
+ * The calling thread works as one of the threads. Loops called from inside a loop, or while another thread is
+ * running one, are run serially by the caller.
+ *
+ * The order in which chunks run is not fixed, so loop bodies must write their results by iteration index (and not
+ * append to shared or per thread vectors) to get the same output as a serial loop.
+ */
+class ARUCO_EXPORTS ThreadPool
+{
+public:
+    static ThreadPool &instance();
+    ~ThreadPool();
+
+    /**Sets the number of threads, including the caller. 0 uses the number of cores, 1 runs every loop serially.
+     * Waits for the running loop, if any, so it must not be called from a loop body
+     */
+    void setNumThreads(int n);
+
+    /**Number of threads used by the loops. Can be called from a loop body
+     */
+    int getNumThreads();
+
+    /**Calls body(b,e) on chunks [b,e) that cover [begin,end) and returns when all of them are done. If a chunk
+     * throws, the remaining chunks still run and the first exception is rethrown here
+     */
+    void parallel_for(int begin,int end,const std::function<void(int,int)> &body,int grain=1);
+
+private:
+    ThreadPool();
+
+    struct Range {
+        std::mutex lock;
+        int begin,end;
+    };
+
+    int _numThreads;
+    std::vector<std::thread> _threads;
+    std::unique_ptr<Range[]> _ranges;
+
+    std::mutex _runLock;  //one loop at a time
+    std::mutex _lock;     //protects the fields below
+    std::condition_variable _wake,_done;
+    unsigned int _generation;
+    bool _stop;
+    int _pending;
+    const std::function<void(int,int)> *_body;
+    int _grain;
+    std::exception_ptr _error;
+
+    void start(int n);
+    void stop();
+    void workerLoop(int index);
+    void runChunks(int index,const std::function<void(int,int)> &body,int grain);
+    bool pop(int index,int grain,int &b,int &e);
+    bool steal(int index,int grain,int &b,int &e);
+};
+
+/**Number of threads of the parallel loops of the library. See ThreadPool::setNumThreads
+ */
+inline void setNumThreads(int n) { ThreadPool::instance().setNumThreads(n); }
+inline int getNumThreads() { return ThreadPool::instance().getNumThreads(); }
+
+/**See ThreadPool::parallel_for. The body is passed by reference, so that std::function never copies a lambda with
+ * many captures to the heap
+ */
+template<typename Body>
+inline void parallel_for(int begin,int end,const Body &body,int grain=1) {
+    ThreadPool::instance().parallel_for(begin,end,std::function<void(int,int)>(std::cref(body)),grain);
+}
+
+}
+
+#endif // aruco_THREADPOOL_HPP
@@ -0,0 +1,122 @@
+#ifndef aruco_TOONEARPAIRS_HPP
+#define aruco_TOONEARPAIRS_HPP
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <opencv2/core/core.hpp>
+#include "threadpool.h"
+#include "growbuffer.h"
+
+namespace aruco
+{
+
+/************************************
+ *
+ * Pairs (i,j), i<j, of candidates whose corners are on average less than 10 pixels away, in the order of a loop over
+ * i and j, in work.pairs. Those pairs also have their centroids less than 10 pixels away (the centroid distance is
+ * at most the average corner distance), so the centroids are put in a grid of cells of that size and each candidate
+ * is only compared with the ones in the 3x3 cells around its own. The result is the same as comparing every pair.
+ * All the buffers are the ones of work (a MarkerDetector::Workspace, or anything with the same members), and
+ * candidates can be any list of quadrilaterals with candidates[i][c] the corner c of candidate i
+ *
+ ************************************/
+template<typename Candidates,typename Buffers>
+void findTooNearPairs ( const Candidates &candidates,Buffers &work )
+{
+    const float maxDist=10;
+    //a bit larger than maxDist so that rounding in the centroids never discards a pair
+    const float maxCenterDist=maxDist+0.01f;
+    const int n=candidates.size();
+
+    std::vector<std::pair<int,int> > &pairs=work.pairs;
+    pairs.clear();
+    if ( n<2 ) return;
+
+    std::vector<cv::Point2f> &centers=work.centers;
+    resizeBuffer ( centers,n );
+    cv::Point2f minc ( FLT_MAX,FLT_MAX ),maxc ( -FLT_MAX,-FLT_MAX );
+    for ( int i=0;i<n;i++ )
+    {
+        centers[i]= ( candidates[i][0]+candidates[i][1]+candidates[i][2]+candidates[i][3] ) *0.25f;
+        minc.x=std::min ( minc.x,centers[i].x );
+        minc.y=std::min ( minc.y,centers[i].y );
+        maxc.x=std::max ( maxc.x,centers[i].x );
+        maxc.y=std::max ( maxc.y,centers[i].y );
+    }
+
+    //the cells can be larger than maxCenterDist, but not smaller. Keep the grid in the order of the candidates
+    float cellSize=maxCenterDist;
+    while ( ( ( maxc.x-minc.x ) /cellSize+1 ) * ( ( maxc.y-minc.y ) /cellSize+1 ) >4*n+1024 ) cellSize*=2;
+    const int gridW=int ( ( maxc.x-minc.x ) /cellSize ) +1;
+    const int gridH=int ( ( maxc.y-minc.y ) /cellSize ) +1;
+
+    //candidates sorted by cell (counting sort filled from the end), ascending index inside each cell
+    std::vector<int> &cellX=work.cellX,&cellY=work.cellY,&cellStart=work.cellStart,&cellItems=work.cellItems;
+    resizeBuffer ( cellX,n );
+    resizeBuffer ( cellY,n );
+    resizeBuffer ( cellItems,n );
+    assignBuffer ( cellStart,gridW*gridH+1,0 );
+    for ( int i=0;i<n;i++ )
+    {
+        cellX[i]=std::min ( gridW-1,int ( ( centers[i].x-minc.x ) /cellSize ) );
+        cellY[i]=std::min ( gridH-1,int ( ( centers[i].y-minc.y ) /cellSize ) );
+        cellStart[cellY[i]*gridW+cellX[i]]++;
+    }
+    for ( int c=1;c<gridW*gridH;c++ ) cellStart[c]+=cellStart[c-1];
+    cellStart[gridW*gridH]=n;
+    for ( int i=n-1;i>=0;i-- ) cellItems[--cellStart[cellY[i]*gridW+cellX[i]]]=i;
+
+    //pairs of i, written to out if it is not NULL
+    auto nearPairs=[&] ( int i,std::pair<int,int> *out )
+    {
+        int count=0;
+        for ( int gy=std::max ( 0,cellY[i]-1 );gy<=std::min ( gridH-1,cellY[i]+1 );gy++ )
+            for ( int gx=std::max ( 0,cellX[i]-1 );gx<=std::min ( gridW-1,cellX[i]+1 );gx++ )
+                for ( int k=cellStart[gy*gridW+gx];k<cellStart[gy*gridW+gx+1];k++ )
+                {
+                    int j=cellItems[k];
+                    if ( j<=i ) continue;
+                    cv::Point2f dc=centers[i]-centers[j];
+                    if ( dc.x*dc.x+dc.y*dc.y>=maxCenterDist*maxCenterDist ) continue;
+                    //calculate the average distance of each corner to the corresponding corner of the other one
+                    float dist=0;
+                    for ( int c=0;c<4 && dist<4*maxDist;c++ )
+                        dist+= std::sqrt ( ( candidates[i][c].x-candidates[j][c].x ) * ( candidates[i][c].x-candidates[j][c].x ) + ( candidates[i][c].y-candidates[j][c].y ) * ( candidates[i][c].y-candidates[j][c].y ) );
+                    dist/=4;
+                    //if distance is too small
+                    if ( dist<maxDist )
+                    {
+                        if ( out ) out[count]=std::pair<int,int> ( i,j );
+                        count++;
+                    }
+                }
+        return count;
+    };
+
+    //count the pairs of each i, then write them where they go in pairs (only for the few i that have any)
+    std::vector<int> &pairStart=work.pairStart;
+    assignBuffer ( pairStart,n+1,0 );
+    parallel_for ( 0,n,[&] ( int begin,int end )
+    {
+        for ( int i=begin;i<end;i++ ) pairStart[i+1]=nearPairs ( i,NULL );
+    },16 );
+    for ( int i=0;i<n;i++ ) pairStart[i+1]+=pairStart[i];
+    resizeBuffer ( pairs,pairStart[n] );
+    if ( pairs.empty() ) return;
+    parallel_for ( 0,n,[&] ( int begin,int end )
+    {
+        for ( int i=begin;i<end;i++ )
+        {
+            if ( pairStart[i]==pairStart[i+1] ) continue;
+            nearPairs ( i,&pairs[pairStart[i]] );
+            std::sort ( pairs.begin() +pairStart[i],pairs.begin() +pairStart[i+1] );
+        }
+    },16 );
+}
+
+}
+
+#endif // aruco_TOONEARPAIRS_HPP
@@ -0,0 +1,64 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <cfloat>
+#include <algorithm>
+
+#include <opencv2/opencv.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Cada medicion de bench: recibe las opciones que siguen a su nombre y devuelve 0 si las versiones que compara
+ * dan el mismo resultado, o 1 si no ( o si las opciones estan mal ).
+ */
+typedef int ( *BenchFunction )( int argc, char **argv );
+
+int benchSkin( int argc, char **argv );
+int benchMorphology( int argc, char **argv );
+int benchThreshold( int argc, char **argv );
+int benchTooNear( int argc, char **argv );
+int benchFiducial( int argc, char **argv );
+int benchCorners( int argc, char **argv );
+int benchMesh( int argc, char **argv );
+int benchPose( int argc, char **argv );
+int benchHull( int argc, char **argv );
+
+/**
+ * Mejor tiempo en milisegundos de repetitions llamadas a run, despues de una de calentamiento.
+ */
+template< class Function >
+double bestTime( Function run, int repetitions = 10 )
+{
+    run();
+
+    double best = DBL_MAX;
+    for( int i = 0; i < repetitions; i++ )
+    {
+        int64 before = getTickCount();
+        run();
+        best = std::min( best, ( getTickCount() - before ) * 1000.0 / getTickFrequency() );
+    }
+    return best;
+}
+
+/**
+ * Imagen BGR de prueba, siempre igual para la misma semilla. Con natural es un fondo en degradado con una
+ * mancha de color piel y algo de ruido, parecida a un cuadro de la camara; si no, ruido uniforme, que es el
+ * peor caso para las tablas y caches.
+ */
+void testImage( Mat &image, Size size, bool natural, uint64 seed );
+
+/**
+ * Tamanios de imagen de las opciones: el de "--size WxH", o defaults si no esta. Devuelve false si hay una
+ * opcion que no es esa.
+ */
+bool parseSizes( int argc, char **argv, const vector< Size > &defaults, vector< Size > &sizes );
+
+/**
+ * Para las mediciones sin opciones: devuelve false, avisando, si se paso alguna.
+ */
+bool noOptions( const char *name, int argc, char **argv );
+
+#endif // BENCH_H
@@ -0,0 +1,65 @@
+#---------------------------------
+#
+# Bench: mediciones y comprobaciones del procesamiento sobre datos sinteticos, sin camara ni ventana
+#
+#---------------------------------
+
+QT = core
+
+TARGET   = bench
+TEMPLATE = app
+CONFIG  += console
+CONFIG  -= app_bundle
+
+CONFIG  += c++11
+
+DEFINES += NO_DEBUG_ARUCO
+
+INCLUDEPATH += ..
+
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_core.so"         # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_imgproc.so"      # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_highgui.so"      # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_calib3d.so"      # OpenCV
+
+SOURCES += main.cpp \
+           skinbench.cpp \
+           morphologybench.cpp \
+           thresholdbench.cpp \
+           toonearbench.cpp \
+           fiducialbench.cpp \
+           cornersbench.cpp \
+           meshbench.cpp \
+           posebench.cpp \
+           hullbench.cpp \
+           ../handtracker.cpp \
+           ../skinsegmenter.cpp \
+           ../skinlut.cpp \
+           ../morphology.cpp \
+           ../meshcompiler.cpp \
+           ../aruco/adaptivethreshold.cpp \
+           ../aruco/threadpool.cpp \
+           ../aruco/cornerrefiner.cpp \
+           ../aruco/arucofidmarkers.cpp \
+           ../aruco/board.cpp \
+           ../aruco/marker.cpp \
+           ../aruco/cameraparameters.cpp \
+           ../aruco/planarposesolver.cpp
+
+HEADERS += bench.h \
+           ../handtracker.h \
+           ../roitracker.h \
+           ../skinsegmenter.h \
+           ../skinlut.h \
+           ../morphology.h \
+           ../meshcompiler.h \
+           ../aruco/adaptivethreshold.h \
+           ../aruco/threadpool.h \
+           ../aruco/cornerrefiner.h \
+           ../aruco/growbuffer.h \
+           ../aruco/toonearpairs.h \
+           ../aruco/arucofidmarkers.h \
+           ../aruco/board.h \
+           ../aruco/marker.h \
+           ../aruco/cameraparameters.h \
+           ../aruco/planarposesolver.h
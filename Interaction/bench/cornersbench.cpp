@@ -0,0 +1,225 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "aruco/cornerrefiner.h"
+
+/**
+ * Cuadro sintetico de 640x480 con 40 cuadrilateros oscuros sobre fondo claro, uno por celda de una grilla de 8x5,
+ * y sus esquinas exactas en corners ( con el centro del pixel en el entero, como en OpenCV ). Se dibuja a 8 veces
+ * el tamano y se reduce por area, asi los bordes tienen el gris de la parte cubierta del pixel; despues se
+ * desenfoca con sigma 0.8, como una camara, y se suma ruido de desviacion noise.
+ */
+static void syntheticCorners( Mat &grey, vector< Point2f > &corners, double noise, uint64 seed )
+{
+    const Size size( 640, 480 );
+    const int SCALE = 8, SHIFT = 4;
+    RNG rng( seed );
+
+    Mat large( size.height * SCALE, size.width * SCALE, CV_8UC1, Scalar( 220 ) );
+    corners.clear();
+    for( int cell = 0; cell < 40; cell++ )
+    {
+        Point2f center( ( cell % 8 + 0.5f ) * size.width / 8, ( cell / 8 + 0.5f ) * size.height / 5 );
+        float radius = rng.uniform( 18.f, 32.f ), angle = rng.uniform( 0.f, float( CV_PI ) );
+
+        Point quad[ 4 ];
+        for( int c = 0; c < 4; c++ )
+        {
+            float a = angle + c * float( CV_PI ) / 2 + rng.uniform( -0.15f, 0.15f );
+            Point2f corner = center + Point2f( cos( a ), sin( a ) ) * ( radius * rng.uniform( 0.85f, 1.15f ) );
+            corners.push_back( corner );
+
+            // El pixel x cubre de x - 0.5 a x + 0.5, que en la imagen grande son los pixeles de SCALE * x a
+            // SCALE * x + SCALE - 1
+            Point2f scaled = ( corner + Point2f( 0.5f, 0.5f ) ) * float( SCALE ) - Point2f( 0.5f, 0.5f );
+            quad[ c ] = Point( cvRound( scaled.x * ( 1 << SHIFT ) ), cvRound( scaled.y * ( 1 << SHIFT ) ) );
+        }
+        fillConvexPoly( large, quad, 4, Scalar( 30 ), 8, SHIFT );
+    }
+
+    Mat smooth;
+    resize( large, smooth, size, 0, 0, INTER_AREA );
+    smooth.convertTo( smooth, CV_32F );
+    GaussianBlur( smooth, smooth, Size( 0, 0 ), 0.8 );
+    if( noise > 0 )
+    {
+        Mat noisy( size, CV_32F );
+        rng.fill( noisy, RNG::NORMAL, 0, noise );
+        smooth += noisy;
+    }
+    smooth.convertTo( grey, CV_8U );
+}
+
+/**
+ * Lo que hacia SubPixelCorner::RefineCorner antes de CornerRefiner ( ventana de 15x15, Sobel de 3, 10 iteraciones
+ * y 0.1 pixeles ): en cada iteracion getRectSubPix() de la ventana completa, Sobel() y el sistema de 2x2 con una
+ * gaussiana mas ancha que la de cornerSubPix(). La y nueva no restaba el termino B * C ( restaba C * D, con D
+ * siempre en 0 ), y se deja igual para medir lo que daba.
+ */
+static void referenceSubPixelCorner( const Mat &image, vector< Point2f > &corners )
+{
+    const int WIN_SIZE = 15, APERTURE_SIZE = 3, MAX_ITERS = 10;
+    const double EPS = 0.1 * 0.1;
+
+    Mat mask( WIN_SIZE, WIN_SIZE, CV_32FC1 );
+    for( int i = 0; i < WIN_SIZE; i++ )
+        for( int j = 0; j < WIN_SIZE; j++ )
+            mask.at< float >( i, j ) = float( exp( -( ( i - WIN_SIZE / 2 ) * ( i - WIN_SIZE / 2 ) +
+                                                       ( j - WIN_SIZE / 2 ) * ( j - WIN_SIZE / 2 ) ) /
+                                                   double( WIN_SIZE * WIN_SIZE ) ) );
+
+    for( unsigned int k = 0; k < corners.size(); k++ )
+    {
+        Point2f estimate = corners[ k ], current;
+        if( estimate.x < 0 || estimate.y < 0 || estimate.x > image.cols || estimate.y > image.rows ) continue;
+
+        int iter = 0;
+        double dist;
+        do
+        {
+            iter++;
+            current = estimate;
+
+            Mat local, dx, dy;
+            getRectSubPix( image, Size( WIN_SIZE + 2 * ( APERTURE_SIZE / 2 ), WIN_SIZE + 2 * ( APERTURE_SIZE / 2 ) ),
+                           current, local );
+            Sobel( local, dx, CV_32FC1, 1, 0, APERTURE_SIZE, 1, 0 );
+            Sobel( local, dy, CV_32FC1, 0, 1, APERTURE_SIZE, 1, 0 );
+
+            double A = 0, B = 0, C = 0, E = 0, F = 0;
+            for( int i = APERTURE_SIZE / 2; i <= WIN_SIZE; i++ )
+            {
+                int ly = i - WIN_SIZE / 2 - APERTURE_SIZE / 2;
+                for( int j = APERTURE_SIZE / 2; j <= WIN_SIZE; j++ )
+                {
+                    int lx = j - WIN_SIZE / 2 - APERTURE_SIZE / 2;
+                    double weight = mask.at< float >( ly + WIN_SIZE / 2, lx + WIN_SIZE / 2 );
+                    double gx = dx.at< float >( i, j ), gy = dy.at< float >( i, j );
+                    double dxx = gx * gx * weight, dyy = gy * gy * weight, dxy = gx * gy * weight;
+                    A += dxx;
+                    B += dxy;
+                    E += dyy;
+                    C += dxx * lx + dxy * ly;
+                    F += dxy * lx + dyy * ly;
+                }
+            }
+
+            double det = A * E - B * B;
+            if( fabs( det ) > DBL_EPSILON * DBL_EPSILON )
+                estimate = current + Point2f( float( ( C * E - B * F ) / det ), float( A * F / det ) );
+
+            dist = ( estimate.x - current.x ) * ( estimate.x - current.x ) +
+                   ( estimate.y - current.y ) * ( estimate.y - current.y );
+        }
+        while( iter < MAX_ITERS && dist > EPS );
+
+        if( fabs( corners[ k ].x - estimate.x ) <= WIN_SIZE && fabs( corners[ k ].y - estimate.y ) <= WIN_SIZE )
+            corners[ k ] = estimate;
+    }
+}
+
+// Distancia media y maxima entre esquinas correspondientes
+static void distances( const vector< Point2f > &a, const vector< Point2f > &b, double &mean, double &maximum )
+{
+    mean = maximum = 0;
+    for( unsigned int i = 0; i < a.size(); i++ )
+    {
+        double distance = norm( a[ i ] - b[ i ] );
+        mean += distance;
+        maximum = std::max( maximum, distance );
+    }
+    mean /= a.size();
+}
+
+/**
+ * aruco::CornerRefiner contra cornerSubPix() con la misma ventana y el mismo criterio de parada, con los
+ * parametros de SUBPIX y de HARRIS en MarkerDetector. Las esquinas empiezan corridas hasta 1.2 pixeles de las
+ * exactas; se da el error de cada una respecto de las exactas y el tiempo de refineCorner() de a una, como
+ * cornerSubPix(), y de refine(), que reparte las esquinas entre los hilos. Las de CornerRefiner no pueden
+ * quedar a mas de 0.05 pixeles de las de cornerSubPix ( acumula en float ), y refine() tiene que dar lo mismo
+ * que refineCorner(). Con los parametros de HARRIS tambien se da el error y el tiempo del SubPixelCorner que
+ * reemplazo CornerRefiner, sin que cuente como fallo.
+ */
+int benchCorners( int argc, char **argv )
+{
+    if( ! noOptions( "corners", argc, argv ) ) return 1;
+
+    struct Setting
+    {
+        const char *name;
+        int halfWin, maxIters;
+        float epsilon;
+    };
+    const Setting settings[] = { { "SUBPIX", 2, 3, 0.05f }, { "HARRIS", 7, 10, 0.1f } };
+    const double TOLERANCE = 0.05;
+    int failures = 0;
+
+    for( int noise = 0; noise <= 3; noise += 3 )
+    {
+        Mat grey;
+        vector< Point2f > truth;
+        syntheticCorners( grey, truth, noise, 1 + noise );
+
+        RNG rng( 100 + noise );
+        vector< Point2f > start = truth;
+        for( unsigned int i = 0; i < start.size(); i++ )
+            start[ i ] += Point2f( rng.uniform( -1.2f, 1.2f ), rng.uniform( -1.2f, 1.2f ) );
+
+        double mean, maximum;
+        distances( start, truth, mean, maximum );
+        printf( "ruido %d, %d esquinas: error inicial medio %.3f px maximo %.3f px\n", noise, ( int )truth.size(),
+                mean, maximum );
+
+        for( int s = 0; s < 2; s++ )
+        {
+            const Setting &setting = settings[ s ];
+            aruco::CornerRefiner refiner( setting.halfWin, setting.maxIters, setting.epsilon );
+            TermCriteria criteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, setting.maxIters, setting.epsilon );
+            Size window( setting.halfWin, setting.halfWin );
+
+            vector< Point2f > reference, single, parallel;
+            double referenceTime = bestTime( [ & ]()
+            {
+                reference = start;
+                cornerSubPix( grey, reference, window, Size( -1, -1 ), criteria );
+            } );
+            double singleTime = bestTime( [ & ]()
+            {
+                single = start;
+                for( unsigned int i = 0; i < single.size(); i++ ) refiner.refineCorner( grey, single[ i ] );
+            } );
+            double parallelTime = bestTime( [ & ]()
+            {
+                parallel = start;
+                refiner.refine( grey, parallel );
+            } );
+
+            double referenceMean, referenceMaximum, meanDifference, difference;
+            distances( reference, truth, referenceMean, referenceMaximum );
+            distances( single, truth, mean, maximum );
+            distances( single, reference, meanDifference, difference );
+            bool different = difference > TOLERANCE || single != parallel;
+
+            printf( "  %s ventana %dx%d: cornerSubPix %.3f ms, error medio %.3f px maximo %.3f px\n",
+                    setting.name, 2 * setting.halfWin + 1, 2 * setting.halfWin + 1, referenceTime, referenceMean,
+                    referenceMaximum );
+            printf( "    CornerRefiner %.3f ms ( %.1fx ), refine() %.3f ms ( %.1fx ), error medio %.3f px maximo %.3f px, "
+                    "hasta %.4f px de cornerSubPix%s\n", singleTime, referenceTime / singleTime, parallelTime,
+                    referenceTime / parallelTime, mean, maximum, difference, different ? "  DISTINTA" : "" );
+
+            if( different ) failures++;
+        }
+
+        vector< Point2f > subPixel;
+        double subPixelTime = bestTime( [ & ]()
+        {
+            subPixel = start;
+            referenceSubPixelCorner( grey, subPixel );
+        } );
+        distances( subPixel, truth, mean, maximum );
+        printf( "  SubPixelCorner de antes ventana 15x15: %.3f ms, error medio %.3f px maximo %.3f px\n", subPixelTime,
+                mean, maximum );
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "aruco/arucofidmarkers.h"
+
+// Lo que hacia FiducidalMarkers::analyzeMarkerImage despues de leer las celdas, con las matrices de 5x5 de antes
+
+static Mat rotateCells( const Mat &in )
+{
+    Mat out;
+    in.copyTo( out );
+    for( int i = 0; i < in.rows; i++ )
+        for( int j = 0; j < in.cols; j++ )
+            out.at< uchar >( i, j ) = in.at< uchar >( in.cols - j - 1, i );
+    return out;
+}
+
+static int hammingToValid( const Mat &cells )
+{
+    const int ids[ 4 ][ 5 ] = { { 1, 0, 0, 0, 0 }, { 1, 0, 1, 1, 1 }, { 0, 1, 0, 0, 1 }, { 0, 1, 1, 1, 0 } };
+    int distance = 0;
+
+    for( int y = 0; y < 5; y++ )
+    {
+        int minimum = 5;
+        for( int p = 0; p < 4; p++ )
+        {
+            int sum = 0;
+            for( int x = 0; x < 5; x++ ) sum += cells.at< uchar >( y, x ) == ids[ p ][ x ] ? 0 : 1;
+            minimum = std::min( minimum, sum );
+        }
+        distance += minimum;
+    }
+    return distance;
+}
+
+static int referenceDecode( const Mat &cells, int &nRotations )
+{
+    Mat rotations[ 4 ];
+    rotations[ 0 ] = cells;
+    pair< int, int > minimum( hammingToValid( cells ), 0 );
+    for( int i = 1; i < 4; i++ )
+    {
+        rotations[ i ] = rotateCells( rotations[ i - 1 ] );
+        int distance = hammingToValid( rotations[ i ] );
+        if( distance < minimum.first ) minimum = pair< int, int >( distance, i );
+    }
+
+    nRotations = minimum.second;
+    if( minimum.first != 0 ) return -1;
+
+    int id = 0;
+    const Mat &bits = rotations[ minimum.second ];
+    for( int y = 0; y < 5; y++ )
+    {
+        id <<= 1;
+        if( bits.at< uchar >( y, 1 ) ) id |= 1;
+        id <<= 1;
+        if( bits.at< uchar >( y, 3 ) ) id |= 1;
+    }
+    return id;
+}
+
+static void unpack( unsigned int bits, Mat &cells )
+{
+    for( int k = 0; k < 25; k++ ) cells.at< uchar >( k / 5, k % 5 ) = ( bits >> ( 24 - k ) ) & 1;
+}
+
+/**
+ * FiducidalMarkers::decode ( la tabla de marcadores validos ) contra la decodificacion con matrices que
+ * reemplazo, en las 2^25 combinaciones de celdas: el id y la rotacion tienen que coincidir en todas, tambien la
+ * rotacion mas cercana de las que no son marcadores. Los tiempos son sobre una de cada 1024 combinaciones.
+ */
+int benchFiducial( int argc, char **argv )
+{
+    if( ! noOptions( "fiducial", argc, argv ) ) return 1;
+
+    Mat cells( 5, 5, CV_8UC1 );
+    long different = 0, valid = 0;
+
+    for( unsigned int bits = 0; bits < ( 1u << 25 ); bits++ )
+    {
+        unpack( bits, cells );
+        int referenceRotations, rotations;
+        int reference = referenceDecode( cells, referenceRotations );
+        int id = aruco::FiducidalMarkers::decode( bits, rotations );
+
+        if( reference != id || referenceRotations != rotations )
+        {
+            if( different < 5 )
+                printf( "celdas %07x: matrices %d rotacion %d, tabla %d rotacion %d\n", bits, reference,
+                        referenceRotations, id, rotations );
+            different++;
+        }
+        if( reference >= 0 ) valid++;
+    }
+
+    volatile int sink = 0;
+    const int SAMPLES = ( 1 << 25 ) / 1024;
+    double referenceTime = bestTime( [ & ]()
+    {
+        int rotations;
+        for( unsigned int bits = 0; bits < ( 1u << 25 ); bits += 1024 )
+        {
+            unpack( bits, cells );
+            sink = referenceDecode( cells, rotations );
+        }
+    }, 3 );
+    double time = bestTime( [ & ]()
+    {
+        int rotations;
+        for( unsigned int bits = 0; bits < ( 1u << 25 ); bits += 1024 ) sink = aruco::FiducidalMarkers::decode( bits, rotations );
+    }, 3 );
+
+    printf( "%d combinaciones, %ld marcadores validos, %ld distintas; matrices %.0f ns, tabla %.0f ns por "
+            "combinacion\n", 1 << 25, valid, different, referenceTime * 1e6 / SAMPLES, time * 1e6 / SAMPLES );
+
+    return different ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "handtracker.h"
+#include "morphology.h"
+#include "skinsegmenter.h"
+
+/**
+ * Lo que hacia HandTracker::process antes de rowExtents: el cierre convexo de todos los pixeles en 255 de mask,
+ * multiplicados por scale y corridos offset.
+ */
+static void referenceHull( const Mat &mask, vector< Point > &hull, int scale = 1, Point offset = Point() )
+{
+    vector< Point > points;
+    for( int j = 0; j < mask.rows; j++ )
+        for( int i = 0; i < mask.cols; i++ )
+            if( mask.at< uchar >( j, i ) == 255 ) points.push_back( Point( i, j ) * scale + offset );
+
+    hull.clear();
+    if( ! points.empty() ) convexHull( Mat( points ), hull, false );
+}
+
+// El cierre convexo como lo calcula HandTracker::process
+static void extentsHull( const Mat &mask, vector< Point > &hull, int scale = 1, Point offset = Point() )
+{
+    vector< Point > points;
+    HandTracker::rowExtents( mask, points, scale, offset );
+
+    hull.clear();
+    if( ! points.empty() ) convexHull( Mat( points ), hull, false );
+}
+
+/**
+ * Mascara chica, de 1 a 60 pixeles de lado, con hasta cuatro elipses en 255 que pueden quedar separadas, tocar los
+ * bordes o no entrar: filas vacias, de un solo pixel y con huecos en el medio.
+ */
+static void randomBlobs( RNG &rng, Mat &mask )
+{
+    mask.create( rng.uniform( 1, 61 ), rng.uniform( 1, 61 ), CV_8UC1 );
+    mask.setTo( Scalar( 0 ) );
+
+    int blobs = rng.uniform( 1, 5 );
+    for( int b = 0; b < blobs; b++ )
+    {
+        Point center( rng.uniform( 0, mask.cols ), rng.uniform( 0, mask.rows ) );
+        Size axes( rng.uniform( 0, 15 ), rng.uniform( 0, 15 ) );
+        ellipse( mask, center, axes, rng.uniform( 0., 180. ), 0, 360, Scalar( 255 ), -1 );
+    }
+}
+
+/**
+ * HandTracker::rowExtents y convexHull() contra convexHull() de todos los pixeles en 255, que tienen que dar los
+ * mismos vertices. Se prueban la mascara de piel de la imagen natural, antes y despues de la apertura con la cruz
+ * de HandTracker, una mascara de ruido ( la que mas puntos deja en el medio de las filas ) y 2000 mascaras chicas
+ * al azar, estas con la escala y el corrimiento que usa HandTracker con la piramide.
+ */
+int benchHull( int argc, char **argv )
+{
+    vector< Size > sizes;
+    if( ! parseSizes( argc, argv, { Size( 640, 480 ), Size( 1920, 1080 ) }, sizes ) ) return 1;
+
+    const char *names[] = { "piel", "piel abierta", "ruido" };
+    Morphology morphology;
+    int failures = 0;
+
+    for( unsigned int s = 0; s < sizes.size(); s++ )
+    {
+        Mat frame, skin;
+        testImage( frame, sizes[ s ], true, 1 + s );
+        SkinSegmenter::segment( frame, skin, 0, 140 );
+
+        for( int m = 0; m < 3; m++ )
+        {
+            Mat mask;
+            if( m == 0 ) mask = skin;
+            else if( m == 1 ) morphology.openCross( skin, mask, 9 );
+            else
+            {
+                mask.create( sizes[ s ], CV_8UC1 );
+                RNG( 7 + s ).fill( mask, RNG::UNIFORM, 0, 2 );
+                mask *= 255;
+            }
+
+            vector< Point > reference, hull;
+            double referenceTime = bestTime( [ & ]() { referenceHull( mask, reference ); }, 3 );
+            double time = bestTime( [ & ]() { extentsHull( mask, hull ); } );
+            bool different = hull != reference;
+
+            printf( "%dx%d %-12s %8d pixeles  todos %7.2f ms  extremos de fila %6.3f ms ( %.0fx )  %d vertices%s\n",
+                    sizes[ s ].width, sizes[ s ].height, names[ m ], countNonZero( mask ), referenceTime, time,
+                    referenceTime / time, ( int )hull.size(), different ? "  DISTINTA" : "" );
+
+            if( different ) failures++;
+        }
+    }
+
+    RNG rng( 3 );
+    int different = 0;
+    for( int i = 0; i < 2000; i++ )
+    {
+        Mat mask;
+        randomBlobs( rng, mask );
+        int scale = rng.uniform( 1, 4 );
+        Point offset( rng.uniform( 0, 100 ), rng.uniform( 0, 100 ) );
+
+        vector< Point > reference, hull;
+        referenceHull( mask, reference, scale, offset );
+        extentsHull( mask, hull, scale, offset );
+        if( hull != reference ) different++;
+    }
+    printf( "2000 mascaras chicas con escala y corrimiento: %d distintas%s\n", different, different ? "  DISTINTA" : "" );
+    if( different ) failures++;
+
+    return failures ? 1 : 0;
+}
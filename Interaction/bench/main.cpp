@@ -0,0 +1,136 @@
+#include <cstdio>
+#include <cstring>
+
+#include "bench.h"
+
+/**
+ * Mediciones de las partes del procesamiento que no necesitan camara ni video. Cada una compara la version
+ * actual con la de referencia ( la que reemplazo, o la de OpenCV ) sobre datos sinteticos, escribe los tiempos
+ * y termina con error si los resultados no coinciden, asi que sirven tambien como pruebas.
+ *
+ *   bench <nombre> [opciones]
+ *   bench all
+ *
+ * Las que procesan imagenes aceptan --size WxH ( por defecto 640x480 y 1920x1080 ).
+ */
+
+struct Bench
+{
+    const char *name;
+    BenchFunction run;
+    const char *description;
+};
+
+static const Bench benches[] =
+{
+    { "skin", benchSkin, "segmentacion de piel: SkinSegmenter y SkinLUT contra cvtColor( CV_BGR2Lab )" },
+    { "morphology", benchMorphology, "apertura con la cruz: Morphology contra erode() y dilate()" },
+    { "threshold", benchThreshold, "umbral adaptativo: aruco::AdaptiveThreshold contra adaptiveThreshold()" },
+    { "toonear", benchTooNear, "candidatos demasiado cerca: la grilla de MarkerDetector contra todos los pares" },
+    { "fiducial", benchFiducial, "decodificacion de marcadores: FiducidalMarkers::decode contra la de matrices" },
+    { "corners", benchCorners, "refinamiento de esquinas: aruco::CornerRefiner contra cornerSubPix()" },
+    { "mesh", benchMesh, "mallas de los modelos: MeshCompiler contra las esquinas sueltas que subia Model" },
+    { "pose", benchPose, "pose de la mano: aruco::PlanarPoseSolver contra solvePnP()" },
+    { "hull", benchHull, "cierre convexo de la mano: HandTracker::rowExtents contra todos los pixeles" }
+};
+
+static const int BENCH_COUNT = sizeof( benches ) / sizeof( benches[ 0 ] );
+
+static void usage()
+{
+    fprintf( stderr, "uso: bench <nombre> [opciones] | bench all\n" );
+    for( int i = 0; i < BENCH_COUNT; i++ ) fprintf( stderr, "  %-12s %s\n", benches[ i ].name, benches[ i ].description );
+}
+
+void testImage( Mat &image, Size size, bool natural, uint64 seed )
+{
+    RNG rng( seed );
+    image.create( size, CV_8UC3 );
+
+    if( ! natural )
+    {
+        rng.fill( image, RNG::UNIFORM, 0, 256 );
+        return;
+    }
+
+    for( int j = 0; j < size.height; j++ )
+    {
+        Vec3b *row = image.ptr< Vec3b >( j );
+        for( int i = 0; i < size.width; i++ )
+            row[ i ] = Vec3b( 40 + 120 * i / size.width, 60 + 100 * j / size.height, 90 );
+    }
+
+    // Una palma con cuatro dedos, fuera del rango por defecto de replay ( a del Lab de 0 a 140 )
+    const Scalar skin( 110, 130, 230 );
+    Point center( size.width / 2, size.height * 3 / 5 );
+    int radius = std::min( size.width, size.height ) / 6;
+    circle( image, center, radius, skin, -1 );
+    for( int k = 0; k < 4; k++ )
+    {
+        Point base = center + Point( ( k - 1.5 ) * radius * 0.5, -radius / 2 );
+        line( image, base, base + Point( ( k - 1.5 ) * radius * 0.3, -radius * 1.4 ), skin, radius / 4 );
+    }
+
+    Mat noise( size, CV_16SC3 ), noisy;
+    rng.fill( noise, RNG::NORMAL, 0, 6 );
+    image.convertTo( noisy, CV_16SC3 );
+    noisy += noise;
+    noisy.convertTo( image, CV_8UC3 );
+}
+
+bool parseSizes( int argc, char **argv, const vector< Size > &defaults, vector< Size > &sizes )
+{
+    Size size;
+    for( int i = 0; i < argc; i++ )
+    {
+        if( ! strcmp( argv[ i ], "--size" ) && i + 1 < argc &&
+            sscanf( argv[ ++i ], "%dx%d", &size.width, &size.height ) == 2 && size.area() > 0 ) continue;
+        fprintf( stderr, "opcion no valida: %s\n", argv[ i ] );
+        return false;
+    }
+
+    if( size.area() ) sizes.assign( 1, size );
+    else sizes = defaults;
+    return true;
+}
+
+bool noOptions( const char *name, int argc, char **argv )
+{
+    if( ! argc ) return true;
+
+    fprintf( stderr, "%s no tiene opciones: %s\n", name, argv[ 0 ] );
+    return false;
+}
+
+int main( int argc, char **argv )
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    int failures = 0;
+    bool found = false;
+
+    for( int i = 0; i < BENCH_COUNT; i++ )
+    {
+        if( strcmp( argv[ 1 ], "all" ) && strcmp( argv[ 1 ], benches[ i ].name ) ) continue;
+
+        found = true;
+        printf( "== %s: %s\n", benches[ i ].name, benches[ i ].description );
+        if( benches[ i ].run( argc - 2, argv + 2 ) )
+        {
+            printf( "== %s: FALLO\n", benches[ i ].name );
+            failures++;
+        }
+    }
+
+    if( ! found )
+    {
+        usage();
+        return 1;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,224 @@
+#include <cstdio>
+#include <map>
+
+#include "bench.h"
+#include "meshcompiler.h"
+
+/**
+ * Triangulos con los atributos repetidos en cada esquina, como los arma Model::compile a partir de lib3ds: 9
+ * floats de posicion, 9 de normal y 6 de coordenadas de textura por triangulo.
+ */
+struct CornerMesh
+{
+    vector< float > positions, normals, texCoords;
+
+    int triangles() const
+    {
+        return positions.size() / 9;
+    }
+
+    void addCorner( const Point3f &position, const Point3f &normal, const Point2f &texCoord )
+    {
+        positions.push_back( position.x );
+        positions.push_back( position.y );
+        positions.push_back( position.z );
+        normals.push_back( normal.x );
+        normals.push_back( normal.y );
+        normals.push_back( normal.z );
+        texCoords.push_back( texCoord.x );
+        texCoords.push_back( texCoord.y );
+    }
+};
+
+/**
+ * Esfera de rings x segments cuadrilateros con normales suaves, recorrida por anillos como la exportan los
+ * programas de modelado. Cada esquina de un vertice compartido sale igual, asi que se tienen que unir.
+ */
+static void sphere( int rings, int segments, CornerMesh &mesh )
+{
+    const int corners[ 6 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+    for( int r = 0; r < rings; r++ )
+    {
+        for( int s = 0; s < segments; s++ )
+        {
+            for( int k = 0; k < 6; k++ )
+            {
+                float u = float( s + corners[ k ][ 0 ] ) / segments, v = float( r + corners[ k ][ 1 ] ) / rings;
+                float theta = u * 2 * float( CV_PI ), phi = v * float( CV_PI );
+                Point3f normal( sin( phi ) * cos( theta ), sin( phi ) * sin( theta ), cos( phi ) );
+                mesh.addCorner( normal, normal, Point2f( u, v ) );
+            }
+        }
+    }
+}
+
+/**
+ * Cubo con cada cara partida en side x side cuadrilateros y normales planas: las aristas del cubo tienen
+ * vertices con la misma posicion y distinta normal, que no se pueden unir.
+ */
+static void cube( int side, CornerMesh &mesh )
+{
+    const int corners[ 6 ][ 2 ] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 0 }, { 1, 1 }, { 0, 1 } };
+
+    for( int face = 0; face < 6; face++ )
+    {
+        int axis = face / 2;
+        float sign = face % 2 ? 1.f : -1.f;
+        for( int j = 0; j < side; j++ )
+        {
+            for( int i = 0; i < side; i++ )
+            {
+                for( int k = 0; k < 6; k++ )
+                {
+                    float a = 2.f * ( i + corners[ k ][ 0 ] ) / side - 1, b = 2.f * ( j + corners[ k ][ 1 ] ) / side - 1;
+                    float p[ 3 ], n[ 3 ] = { 0, 0, 0 };
+                    p[ axis ] = sign;
+                    p[ ( axis + 1 ) % 3 ] = a;
+                    p[ ( axis + 2 ) % 3 ] = b;
+                    n[ axis ] = sign;
+                    mesh.addCorner( Point3f( p[ 0 ], p[ 1 ], p[ 2 ] ), Point3f( n[ 0 ], n[ 1 ], n[ 2 ] ),
+                                    Point2f( ( a + 1 ) / 2, ( b + 1 ) / 2 ) );
+                }
+            }
+        }
+    }
+}
+
+// Los triangulos de mesh en cualquier orden, como sale un modelo armado por partes
+static void shuffle( CornerMesh &mesh, uint64 seed )
+{
+    RNG rng( seed );
+    for( int t = mesh.triangles() - 1; t > 0; t-- )
+    {
+        int other = rng.uniform( 0, t + 1 );
+        std::swap_ranges( &mesh.positions[ t * 9 ], &mesh.positions[ t * 9 ] + 9, &mesh.positions[ other * 9 ] );
+        std::swap_ranges( &mesh.normals[ t * 9 ], &mesh.normals[ t * 9 ] + 9, &mesh.normals[ other * 9 ] );
+        std::swap_ranges( &mesh.texCoords[ t * 6 ], &mesh.texCoords[ t * 6 ] + 6, &mesh.texCoords[ other * 6 ] );
+    }
+}
+
+// Los 8 floats de un vertice de CompiledMesh para la esquina corner de mesh
+static vector< float > cornerVertex( const CornerMesh &mesh, int corner )
+{
+    vector< float > vertex( &mesh.positions[ corner * 3 ], &mesh.positions[ corner * 3 ] + 3 );
+    vertex.insert( vertex.end(), &mesh.normals[ corner * 3 ], &mesh.normals[ corner * 3 ] + 3 );
+    vertex.insert( vertex.end(), &mesh.texCoords[ corner * 2 ], &mesh.texCoords[ corner * 2 ] + 2 );
+    return vertex;
+}
+
+/**
+ * Indices de mesh con los vertices iguales unidos pero los triangulos en el orden original: lo que dibujaria la
+ * malla sin el orden para la cache.
+ */
+static void weldedIndices( const CornerMesh &mesh, vector< unsigned int > &indices )
+{
+    map< vector< float >, unsigned int > vertices;
+    indices.clear();
+    for( int c = 0; c < mesh.triangles() * 3; c++ )
+    {
+        map< vector< float >, unsigned int >::iterator found =
+            vertices.insert( make_pair( cornerVertex( mesh, c ), ( unsigned int )vertices.size() ) ).first;
+        indices.push_back( found->second );
+    }
+}
+
+// Un triangulo como 24 floats, empezando por su esquina menor para no depender de cual es la primera
+static vector< float > canonicalTriangle( const vector< float > &a, const vector< float > &b, const vector< float > &c )
+{
+    const vector< float > *corners[ 3 ] = { &a, &b, &c };
+    int first = 0;
+    for( int k = 1; k < 3; k++ )
+        if( *corners[ k ] < *corners[ first ] ) first = k;
+
+    vector< float > triangle;
+    for( int k = 0; k < 3; k++ )
+        triangle.insert( triangle.end(), corners[ ( first + k ) % 3 ]->begin(), corners[ ( first + k ) % 3 ]->end() );
+    return triangle;
+}
+
+/**
+ * Si compiled tiene los mismos triangulos que mesh, con los mismos atributos y la misma orientacion, en
+ * cualquier orden.
+ */
+static bool sameTriangles( const CornerMesh &mesh, const CompiledMesh &compiled )
+{
+    int triangles = mesh.triangles();
+    if( ( int )compiled.indices.size() != triangles * 3 ) return false;
+
+    vector< vector< float > > original, result;
+    for( int t = 0; t < triangles; t++ )
+    {
+        original.push_back( canonicalTriangle( cornerVertex( mesh, t * 3 ), cornerVertex( mesh, t * 3 + 1 ),
+                                               cornerVertex( mesh, t * 3 + 2 ) ) );
+
+        vector< float > corners[ 3 ];
+        for( int k = 0; k < 3; k++ )
+        {
+            unsigned int index = compiled.indices[ t * 3 + k ];
+            if( ( int )index >= compiled.vertexCount() ) return false;
+            const float *vertex = &compiled.vertices[ index * CompiledMesh::VERTEX_FLOATS ];
+            corners[ k ].assign( vertex, vertex + CompiledMesh::VERTEX_FLOATS );
+        }
+        result.push_back( canonicalTriangle( corners[ 0 ], corners[ 1 ], corners[ 2 ] ) );
+    }
+
+    std::sort( original.begin(), original.end() );
+    std::sort( result.begin(), result.end() );
+    return original == result;
+}
+
+/**
+ * MeshCompiler::compile contra lo que subia Model antes: tres arreglos con los atributos de cada esquina ( 32
+ * bytes por esquina ) dibujados con glDrawArrays, que transforma cada esquina ( ACMR 3 ). Por malla se da la
+ * memoria en la GPU antes y despues, el ACMR de la cache simulada de MeshCompiler::CACHE_SIZE vertices con los
+ * vertices unidos en el orden original y en el de compile(), y el tiempo de compile(). Termina con error si la
+ * malla compilada no tiene los mismos triangulos o si el orden nuevo transforma mas vertices que el original.
+ */
+int benchMesh( int argc, char **argv )
+{
+    if( ! noOptions( "mesh", argc, argv ) ) return 1;
+
+    const char *names[] = { "esfera 32x64", "esfera 128x256", "esfera desordenada", "cubo 6x40x40",
+                            "esfera 192x384" };
+    int failures = 0;
+
+    for( int m = 0; m < 5; m++ )
+    {
+        CornerMesh mesh;
+        if( m == 0 ) sphere( 32, 64, mesh );
+        else if( m == 1 ) sphere( 128, 256, mesh );
+        else if( m == 2 )
+        {
+            sphere( 128, 256, mesh );
+            shuffle( mesh, 1 );
+        }
+        else if( m == 3 ) cube( 40, mesh );
+        else sphere( 192, 384, mesh );  // mas de 65536 vertices: indices de 32 bits
+
+        CompiledMesh compiled;
+        double time = bestTime( [ & ]()
+        {
+            MeshCompiler::compile( &mesh.positions[ 0 ], &mesh.normals[ 0 ], &mesh.texCoords[ 0 ], mesh.triangles(),
+                                   compiled );
+        }, 3 );
+
+        vector< unsigned int > welded;
+        weldedIndices( mesh, welded );
+        double weldedRatio = MeshCompiler::averageCacheMissRatio( welded, MeshCompiler::CACHE_SIZE );
+        double ratio = MeshCompiler::averageCacheMissRatio( compiled.indices, MeshCompiler::CACHE_SIZE );
+
+        bool different = ! sameTriangles( mesh, compiled );
+        bool worse = ratio > weldedRatio;
+
+        printf( "%-18s %6d triangulos  %6d vertices  %7.1f KB -> %6.1f KB%s  ACMR 3.00 -> %.2f unidos -> %.2f "
+                "ordenados  compile %7.2f ms%s%s\n", names[ m ], mesh.triangles(), compiled.vertexCount(),
+                mesh.triangles() * 3 * 32 / 1024.0, compiled.bytes() / 1024.0,
+                compiled.shortIndices() ? "" : " ( 32 bits )", weldedRatio, ratio, time,
+                different ? "  DISTINTA" : "", worse ? "  PEOR" : "" );
+
+        if( different || worse ) failures++;
+    }
+
+    return failures ? 1 : 0;
+}
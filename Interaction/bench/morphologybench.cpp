@@ -0,0 +1,68 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "morphology.h"
+#include "skinsegmenter.h"
+
+/**
+ * Apertura con la cruz de Morphology contra erode() y dilate() de OpenCV con getStructuringElement( MORPH_CROSS ),
+ * como lo hacia Scene::process. Se prueba la mascara de piel de la imagen natural y una mascara de ruido ( la
+ * que mas cambia entre pixeles vecinos ), con tamanios impares para ejercitar los bordes de las franjas.
+ */
+int benchMorphology( int argc, char **argv )
+{
+    vector< Size > sizes;
+    if( ! parseSizes( argc, argv, { Size( 641, 479 ), Size( 1920, 1080 ) }, sizes ) ) return 1;
+
+    const int radii[] = { 3, 9, 15 };
+    Morphology morphology;
+    int failures = 0;
+
+    for( unsigned int s = 0; s < sizes.size(); s++ )
+    {
+        for( int natural = 1; natural >= 0; natural-- )
+        {
+            Mat frame, mask;
+            testImage( frame, sizes[ s ], true, 1 + s );
+            if( natural ) SkinSegmenter::segment( frame, mask, 0, 140 );
+            else
+            {
+                mask.create( sizes[ s ], CV_8UC1 );
+                RNG( 7 + s ).fill( mask, RNG::UNIFORM, 0, 2 );
+                mask *= 255;
+            }
+
+            for( int r = 0; r < 3; r++ )
+            {
+                int radius = radii[ r ];
+                Mat element = getStructuringElement( MORPH_CROSS, Size( 2 * radius + 1, 2 * radius + 1 ),
+                                                     Point( radius, radius ) );
+
+                Mat reference, opened, eroded, dilated;
+                double referenceTime = bestTime( [ & ]()
+                {
+                    erode( mask, reference, element );
+                    dilate( reference, reference, element );
+                } );
+                double time = bestTime( [ & ]() { morphology.openCross( mask, opened, radius ); } );
+
+                Mat referenceEroded, referenceDilated;
+                erode( mask, referenceEroded, element );
+                dilate( mask, referenceDilated, element );
+                morphology.erodeCross( mask, eroded, radius );
+                morphology.dilateCross( mask, dilated, radius );
+
+                int different = countNonZero( reference != opened ) + countNonZero( referenceEroded != eroded ) +
+                                countNonZero( referenceDilated != dilated );
+
+                printf( "%dx%d %-6s radio %2d  erode+dilate %6.2f ms  openCross %6.2f ms  ( %.1fx )%s\n",
+                        sizes[ s ].width, sizes[ s ].height, natural ? "piel" : "ruido", radius, referenceTime, time,
+                        referenceTime / time, different ? "  DISTINTA" : "" );
+
+                if( different ) failures++;
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,146 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "aruco/planarposesolver.h"
+
+/**
+ * Un cuadro de la secuencia sintetica: la pose real de la mano, los cuatro puntos del modelo y sus proyecciones.
+ */
+struct PoseFrame
+{
+    Mat rvec, tvec;
+    vector< Point3f > object;
+    vector< Point2f > image;
+};
+
+/**
+ * frames cuadros de una mano que se mueve frente a la camara, como los resuelve Scene: los cuatro puntos de
+ * HandTracker::handModel ( pixeles / 5000, en z = 0 ) a 0.10 - 0.18 metros, con inclinaciones de hasta 0.9
+ * radianes y el giro en el plano libre, que cambian de a poco entre cuadros. Se proyectan con camera y
+ * distortion y se les suma ruido de desviacion noise pixeles.
+ */
+static void syntheticPoses( int frames, double noise, const Mat &camera, const Mat &distortion, uint64 seed,
+                            vector< PoseFrame > &poses )
+{
+    const double LIMIT = 0.9;
+    const float palm[ 4 ][ 2 ] = { { -150, -60 }, { -50, 120 }, { 60, 110 }, { 150, -40 } };
+    RNG rng( seed );
+
+    double tiltX = 0.3, tiltY = -0.2, spin = 0;
+    Vec3d position( 0, 0, 0.14 );
+    poses.resize( frames );
+    for( int f = 0; f < frames; f++ )
+    {
+        tiltX = std::max( -LIMIT, std::min( LIMIT, tiltX + rng.gaussian( 0.02 ) ) );
+        tiltY = std::max( -LIMIT, std::min( LIMIT, tiltY + rng.gaussian( 0.02 ) ) );
+        spin += rng.gaussian( 0.03 );
+        position[ 0 ] = std::max( -0.03, std::min( 0.03, position[ 0 ] + rng.gaussian( 0.002 ) ) );
+        position[ 1 ] = std::max( -0.02, std::min( 0.02, position[ 1 ] + rng.gaussian( 0.002 ) ) );
+        position[ 2 ] = std::max( 0.10, std::min( 0.18, position[ 2 ] + rng.gaussian( 0.002 ) ) );
+
+        // La palma mira a la camara ( media vuelta en y ) y despues se inclina y gira
+        Mat flip, rx, ry, rz;
+        Rodrigues( Mat( Vec3d( 0, CV_PI, 0 ) ), flip );
+        Rodrigues( Mat( Vec3d( tiltX, 0, 0 ) ), rx );
+        Rodrigues( Mat( Vec3d( 0, tiltY, 0 ) ), ry );
+        Rodrigues( Mat( Vec3d( 0, 0, spin ) ), rz );
+        PoseFrame &pose = poses[ f ];
+        Rodrigues( Mat( flip * rx * ry * rz ), pose.rvec );
+        pose.tvec = Mat( position, true );
+
+        pose.object.resize( 4 );
+        for( int c = 0; c < 4; c++ )
+            pose.object[ c ] = Point3f( ( palm[ c ][ 0 ] + rng.uniform( -10.f, 10.f ) ) / 5000,
+                                        ( palm[ c ][ 1 ] + rng.uniform( -10.f, 10.f ) ) / 5000, 0 );
+        projectPoints( pose.object, pose.rvec, pose.tvec, camera, distortion, pose.image );
+        for( int c = 0; c < 4; c++ )
+            pose.image[ c ] += Point2f( float( rng.gaussian( noise ) ), float( rng.gaussian( noise ) ) );
+    }
+}
+
+// Angulo en grados entre dos rotaciones dadas como vectores de Rodrigues
+static double rotationError( const Mat &rvec, const Mat &truth )
+{
+    Mat r, t;
+    Rodrigues( rvec, r );
+    Rodrigues( truth, t );
+    double cosine = ( trace( t.t() * r )[ 0 ] - 1 ) / 2;
+    return acos( std::max( -1.0, std::min( 1.0, cosine ) ) ) * 180 / CV_PI;
+}
+
+// Error medio en grados y cantidad de cuadros con la pose dada vuelta ( mas de 20 grados de error )
+static void rotationErrors( const vector< PoseFrame > &poses, const vector< Mat > &rvecs, double &mean, int &flips )
+{
+    mean = 0;
+    flips = 0;
+    for( unsigned int f = 0; f < poses.size(); f++ )
+    {
+        double error = rotationError( rvecs[ f ], poses[ f ].rvec );
+        mean += error;
+        if( error > 20 ) flips++;
+    }
+    mean /= poses.size();
+}
+
+/**
+ * aruco::PlanarPoseSolver contra solvePnP(), que usaba Marker::calculateExtrinsicsHandMatrix, sobre 3000 cuadros
+ * de una mano sintetica con 0.5, 1 y 2 pixeles de ruido. El solver se usa como en Scene, uno solo para toda la
+ * secuencia, asi que empieza de la pose del cuadro anterior. Se da el error medio de la rotacion, los cuadros con
+ * la pose dada vuelta y el tiempo por cuadro. Termina con error si PlanarPoseSolver da vuelta la pose en mas
+ * cuadros que solvePnP o si su error medio es mas de un 10% mayor.
+ */
+int benchPose( int argc, char **argv )
+{
+    if( ! noOptions( "pose", argc, argv ) ) return 1;
+
+    const int FRAMES = 3000;
+    const double noises[] = { 0.5, 1, 2 };
+    Mat camera = ( Mat_< double >( 3, 3 ) << 640, 0, 320, 0, 640, 240, 0, 0, 1 );
+    Mat distortion = ( Mat_< double >( 5, 1 ) << 0.05, -0.1, 0.001, -0.001, 0 );
+    int failures = 0;
+
+    for( int n = 0; n < 3; n++ )
+    {
+        vector< PoseFrame > poses;
+        syntheticPoses( FRAMES, noises[ n ], camera, distortion, 11 + n, poses );
+
+        vector< Mat > reference( FRAMES ), solved( FRAMES );
+        double referenceTime = bestTime( [ & ]()
+        {
+            Mat tvec;
+            for( int f = 0; f < FRAMES; f++ )
+                solvePnP( poses[ f ].object, poses[ f ].image, camera, distortion, reference[ f ], tvec );
+        }, 3 ) / FRAMES;
+
+        aruco::PlanarPoseSolver solver;
+        int unsolved = 0;
+        double solverTime = bestTime( [ & ]()
+        {
+            solver.reset();
+            unsolved = 0;
+            for( int f = 0; f < FRAMES; f++ )
+            {
+                Vec3d rvec, tvec;
+                if( ! solver.solve( &poses[ f ].object[ 0 ].x, &poses[ f ].image[ 0 ], camera, distortion,
+                                    rvec.val, tvec.val ) ) unsolved++;
+                solved[ f ] = Mat( rvec, true );
+            }
+        }, 3 ) / FRAMES;
+
+        double referenceMean, mean;
+        int referenceFlips, flips;
+        rotationErrors( poses, reference, referenceMean, referenceFlips );
+        rotationErrors( poses, solved, mean, flips );
+        bool worse = unsolved || flips > referenceFlips || mean > 1.1 * referenceMean;
+
+        printf( "ruido %.1f px, %d cuadros: solvePnP %.1f us, error medio %.3f grados, %d dados vuelta\n",
+                noises[ n ], FRAMES, referenceTime * 1000, referenceMean, referenceFlips );
+        printf( "  PlanarPoseSolver ( %d pasos ) %.1f us ( %.1fx ), error medio %.3f grados, %d dados vuelta%s\n",
+                solver.getRefinementIterations(), solverTime * 1000, referenceTime / solverTime, mean, flips,
+                worse ? "  PEOR" : "" );
+
+        if( worse ) failures++;
+    }
+
+    return failures ? 1 : 0;
+}
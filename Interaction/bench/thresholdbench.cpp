@@ -0,0 +1,62 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "aruco/adaptivethreshold.h"
+
+/**
+ * Umbral adaptativo de una pasada de aruco::AdaptiveThreshold contra adaptiveThreshold( ADAPTIVE_THRESH_MEAN_C,
+ * THRESH_BINARY_INV ), que es lo que usaba MarkerDetector::thresHold con ADPT_THRES. Sin submuestreo tiene que
+ * dar lo mismo pixel a pixel; con submuestreo solo se informa cuantos pixeles cambian.
+ */
+int benchThreshold( int argc, char **argv )
+{
+    vector< Size > sizes;
+    if( ! parseSizes( argc, argv, { Size( 640, 480 ), Size( 1280, 720 ), Size( 1920, 1080 ) }, sizes ) ) return 1;
+
+    // 7 y 7 son los parametros por defecto de MarkerDetector; C no entero ejercita el redondeo
+    const int blockSizes[] = { 7, 19, 31 };
+    const double constants[] = { 7, 7.5 };
+    aruco::AdaptiveThreshold engine;
+    int failures = 0;
+
+    for( unsigned int s = 0; s < sizes.size(); s++ )
+    {
+        for( int natural = 1; natural >= 0; natural-- )
+        {
+            Mat frame, grey;
+            testImage( frame, sizes[ s ], natural, 1 + s );
+            cvtColor( frame, grey, CV_BGR2GRAY );
+
+            for( int b = 0; b < 3; b++ )
+            {
+                for( int c = 0; c < 2; c++ )
+                {
+                    int blockSize = blockSizes[ b ];
+                    double C = constants[ c ];
+
+                    Mat reference, out, subsampled;
+                    double referenceTime = bestTime( [ & ]()
+                    {
+                        adaptiveThreshold( grey, reference, 255, ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV,
+                                           blockSize, C );
+                    } );
+                    double time = bestTime( [ & ]() { engine.apply( grey, out, blockSize, C ); } );
+                    double subsampledTime = bestTime( [ & ]() { engine.apply( grey, subsampled, blockSize, C, true ); } );
+
+                    int different = countNonZero( reference != out );
+                    int approximate = countNonZero( reference != subsampled );
+
+                    printf( "%dx%d %-6s bloque %2d C %3.1f  OpenCV %6.2f ms  una pasada %6.2f ms ( %.1fx )  "
+                            "submuestreo %6.2f ms ( %.2f%% distinto )%s\n",
+                            sizes[ s ].width, sizes[ s ].height, natural ? "camara" : "ruido", blockSize, C,
+                            referenceTime, time, referenceTime / time, subsampledTime,
+                            100.0 * approximate / sizes[ s ].area(), different ? "  DISTINTA" : "" );
+
+                    if( different ) failures++;
+                }
+            }
+        }
+    }
+
+    return failures ? 1 : 0;
+}
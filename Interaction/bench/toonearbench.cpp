@@ -0,0 +1,100 @@
+#include <cstdio>
+
+#include "bench.h"
+#include "aruco/toonearpairs.h"
+
+/**
+ * Los mismos buffers que usa findTooNearPairs en MarkerDetector::Workspace.
+ */
+struct TooNearBuffers
+{
+    vector< Point2f > centers;
+    vector< int > cellX, cellY, cellStart, cellItems, pairStart;
+    vector< pair< int, int > > pairs;
+};
+
+/**
+ * Lo que hacia MarkerDetector::removeTooNearCandidates antes de la grilla: todos los pares, en orden.
+ */
+static void allNearPairs( const vector< vector< Point2f > > &candidates, vector< pair< int, int > > &pairs )
+{
+    pairs.clear();
+    for( unsigned int i = 0; i < candidates.size(); i++ )
+    {
+        for( unsigned int j = i + 1; j < candidates.size(); j++ )
+        {
+            float dist = 0;
+            for( int c = 0; c < 4; c++ )
+                dist += sqrt( ( candidates[ i ][ c ].x - candidates[ j ][ c ].x ) * ( candidates[ i ][ c ].x - candidates[ j ][ c ].x ) +
+                              ( candidates[ i ][ c ].y - candidates[ j ][ c ].y ) * ( candidates[ i ][ c ].y - candidates[ j ][ c ].y ) );
+            dist /= 4;
+            if( dist < 10 ) pairs.push_back( pair< int, int >( i, j ) );
+        }
+    }
+}
+
+/**
+ * Candidatos parecidos a los de un cuadro con muchos marcadores: cuadrilateros de 12 a 80 pixeles repartidos en
+ * una imagen de 1920x1080, y un tercio de ellos repetidos con las esquinas corridas hasta 12 pixeles, como los
+ * que encuentran varias pasadas del umbral sobre el mismo marcador ( algunos quedan a menos de 10 y otros no ).
+ */
+static void randomCandidates( int count, uint64 seed, vector< vector< Point2f > > &candidates )
+{
+    RNG rng( seed );
+    candidates.clear();
+
+    while( ( int )candidates.size() < count )
+    {
+        if( ! candidates.empty() && rng.uniform( 0, 3 ) == 0 )
+        {
+            vector< Point2f > copy = candidates[ rng.uniform( 0, ( int )candidates.size() ) ];
+            for( int c = 0; c < 4; c++ ) copy[ c ] += Point2f( rng.uniform( -12.f, 12.f ), rng.uniform( -12.f, 12.f ) );
+            candidates.push_back( copy );
+            continue;
+        }
+
+        Point2f center( rng.uniform( 0.f, 1920.f ), rng.uniform( 0.f, 1080.f ) );
+        float side = rng.uniform( 12.f, 80.f ), angle = rng.uniform( 0.f, float( CV_PI ) );
+        vector< Point2f > quad( 4 );
+        for( int c = 0; c < 4; c++ )
+        {
+            float a = angle + c * float( CV_PI ) / 2;
+            quad[ c ] = center + Point2f( cos( a ), sin( a ) ) * ( side * 0.7f ) +
+                        Point2f( rng.uniform( -2.f, 2.f ), rng.uniform( -2.f, 2.f ) );
+        }
+        candidates.push_back( quad );
+    }
+}
+
+/**
+ * findTooNearPairs ( la grilla de MarkerDetector::removeTooNearCandidates ) contra comparar todos los pares, con
+ * 50 a 2000 candidatos. Los pares tienen que ser los mismos y en el mismo orden.
+ */
+int benchTooNear( int argc, char **argv )
+{
+    if( ! noOptions( "toonear", argc, argv ) ) return 1;
+
+    const int counts[] = { 50, 200, 500, 1000, 2000 };
+    TooNearBuffers work;
+    int failures = 0;
+
+    for( int k = 0; k < 5; k++ )
+    {
+        vector< vector< Point2f > > candidates;
+        randomCandidates( counts[ k ], 1 + k, candidates );
+
+        vector< pair< int, int > > reference;
+        double referenceTime = bestTime( [ & ]() { allNearPairs( candidates, reference ); } );
+        double time = bestTime( [ & ]() { aruco::findTooNearPairs( candidates, work ); } );
+
+        bool different = work.pairs != reference;
+
+        printf( "%4d candidatos  %4d pares  todos los pares %8.3f ms  grilla %6.3f ms ( %.1fx )%s\n",
+                counts[ k ], ( int )reference.size(), referenceTime, time, referenceTime / time,
+                different ? "  DISTINTA" : "" );
+
+        if( different ) failures++;
+    }
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,141 @@
+#ifndef FRAMERING_H
+#define FRAMERING_H
+
+#include <QAtomicInt>
+#include <algorithm>
+
+/**
+ * Cola circular sin locks para un solo productor y un solo consumidor ( un hilo cada uno ), de hasta
+ * N elementos.
+ *
+ * Los elementos se intercambian en lugar de copiarse: push() deja en item lo que tenia el casillero y pop()
+ * devuelve el elemento guardado dejando a cambio lo que tenia item. Asi los buffers de las Mat circulan entre
+ * los hilos sin reservar memoria en cada cuadro. Por eso lo que se entrega no puede compartir datos con otra
+ * Mat: el productor va a volver a escribir sobre ese buffer cuando le toque el casillero de nuevo.
+ *
+ * Si la cola esta llena push() no guarda nada. Para cuadros, donde tiene que ganar el mas nuevo, esta
+ * TripleBuffer.
+ */
+template< class T, int N >
+class FrameRing
+{
+public:
+
+    FrameRing() : head( 0 ), tail( 0 ), droppedCount( 0 )
+    {
+    }
+
+    /**
+     * Solo desde el hilo productor. Devuelve false si la cola estaba llena ( el elemento queda en item ).
+     */
+    bool push( T &item )
+    {
+        int h = head.load();
+        int next = ( h + 1 ) % ( N + 1 );
+
+        if( next == tail.loadAcquire() )
+        {
+            droppedCount.fetchAndAddRelaxed( 1 );
+            return false;
+        }
+
+        using std::swap;
+        swap( slots[ h ], item );
+
+        head.storeRelease( next );
+        return true;
+    }
+
+    /**
+     * Solo desde el hilo consumidor. Devuelve false si la cola estaba vacia.
+     */
+    bool pop( T &item )
+    {
+        int t = tail.load();
+
+        if( t == head.loadAcquire() ) return false;
+
+        using std::swap;
+        swap( slots[ t ], item );
+
+        tail.storeRelease( ( t + 1 ) % ( N + 1 ) );
+        return true;
+    }
+
+    // Elementos que no entraron porque la cola estaba llena
+    int dropped() const { return droppedCount.load(); }
+
+private:
+
+    T slots[ N + 1 ];
+    QAtomicInt head, tail;
+    QAtomicInt droppedCount;
+};
+
+/**
+ * Triple buffer sin locks para un solo productor y un solo consumidor: un casillero es del productor, otro del
+ * consumidor y el tercero es el pendiente, el ultimo que entrego el productor. push() y pop() cambian su
+ * casillero por el pendiente con un solo intercambio atomico, asi que el productor nunca espera ni rechaza nada:
+ * si el consumidor no se llevo el pendiente, el nuevo lo reemplaza y el viejo se cuenta como descartado. Siempre
+ * se procesa o se muestra el ultimo cuadro disponible.
+ *
+ * Los elementos se intercambian como en FrameRing, con las mismas condiciones para las Mat.
+ */
+template< class T >
+class TripleBuffer
+{
+public:
+
+    TripleBuffer() : producerSlot( 0 ), consumerSlot( 1 ), pending( 2 ), droppedCount( 0 )
+    {
+    }
+
+    /**
+     * Solo desde el hilo productor. Devuelve false si reemplazo un elemento que el consumidor no habia sacado;
+     * ese elemento queda en item. Si no, en item queda lo que el consumidor devolvio.
+     */
+    bool push( T &item )
+    {
+        using std::swap;
+        swap( slots[ producerSlot ], item );
+
+        int previous = pending.fetchAndStoreOrdered( producerSlot | FRESH );
+        producerSlot = previous & INDEX;
+        swap( slots[ producerSlot ], item );
+
+        if( ! ( previous & FRESH ) ) return true;
+
+        droppedCount.fetchAndAddRelaxed( 1 );
+        return false;
+    }
+
+    /**
+     * Solo desde el hilo consumidor. Deja en item lo ultimo que entrego el productor y se queda con lo que tenia
+     * item. Devuelve false si no llego nada desde la llamada anterior.
+     */
+    bool pop( T &item )
+    {
+        if( ! ( pending.loadAcquire() & FRESH ) ) return false;
+
+        consumerSlot = pending.fetchAndStoreOrdered( consumerSlot ) & INDEX;
+
+        using std::swap;
+        swap( slots[ consumerSlot ], item );
+        return true;
+    }
+
+    // Elementos que push() reemplazo antes de que el consumidor los sacara
+    int dropped() const { return droppedCount.load(); }
+
+private:
+
+    // pending guarda el indice del casillero y si tiene algo que el consumidor todavia no saco
+    enum { INDEX = 3, FRESH = 4 };
+
+    T slots[ 3 ];
+    int producerSlot, consumerSlot;     // Cada uno lo usa un solo hilo
+    QAtomicInt pending;
+    QAtomicInt droppedCount;
+};
+
+#endif // FRAMERING_H
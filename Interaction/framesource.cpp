@@ -0,0 +1,182 @@
+#include "framesource.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+
+FrameSource *FrameSource::open( const string &spec )
+{
+    if( spec.compare( 0, 7, "camera:" ) == 0 )
+    {
+        CameraSource *source = new CameraSource( atoi( spec.c_str() + 7 ) );
+        if( source->isOpened() ) return source;
+        delete source;
+        return NULL;
+    }
+
+    if( spec.compare( 0, 9, "synthetic" ) == 0 )
+    {
+        Size size( 640, 480 );
+        if( spec.size() > 10 && spec[ 9 ] == ':' )
+            sscanf( spec.c_str() + 10, "%dx%d", &size.width, &size.height );
+
+        if( size.width < 160 || size.height < 120 ) return NULL;
+        return new SyntheticSource( size );
+    }
+
+    if( spec.find( '%' ) != string::npos )
+    {
+        ImageSequenceSource *source = new ImageSequenceSource( spec );
+        if( source->isOpened() ) return source;
+        delete source;
+        return NULL;
+    }
+
+    VideoFileSource *source = new VideoFileSource( spec );
+    if( source->isOpened() ) return source;
+    delete source;
+    return NULL;
+}
+
+double FrameSource::now()
+{
+    return getTickCount() / getTickFrequency();
+}
+
+CameraSource::CameraSource( int device ) : videoCapture( device )
+{
+}
+
+bool CameraSource::read( Mat &frame )
+{
+    return videoCapture.read( frame ) && ! frame.empty();
+}
+
+Size CameraSource::frameSize()
+{
+    return Size( videoCapture.get( CV_CAP_PROP_FRAME_WIDTH ), videoCapture.get( CV_CAP_PROP_FRAME_HEIGHT ) );
+}
+
+bool CameraSource::isOpened()
+{
+    return videoCapture.isOpened();
+}
+
+VideoFileSource::VideoFileSource( const string &path ) : videoCapture( path )
+{
+}
+
+bool VideoFileSource::read( Mat &frame )
+{
+    return videoCapture.read( frame ) && ! frame.empty();
+}
+
+Size VideoFileSource::frameSize()
+{
+    return Size( videoCapture.get( CV_CAP_PROP_FRAME_WIDTH ), videoCapture.get( CV_CAP_PROP_FRAME_HEIGHT ) );
+}
+
+bool VideoFileSource::isOpened()
+{
+    return videoCapture.isOpened();
+}
+
+ImageSequenceSource::ImageSequenceSource( const string &pattern ) : pattern( pattern ),
+                                                                    index( 0 )
+{
+    // Las secuencias exportadas suelen empezar en 0 o en 1
+    first = imread( path( 0 ) );
+    if( first.empty() )
+    {
+        index = 1;
+        first = imread( path( 1 ) );
+    }
+}
+
+string ImageSequenceSource::path( int index )
+{
+    char buffer[ 1024 ];
+    snprintf( buffer, sizeof( buffer ), pattern.c_str(), index );
+    return buffer;
+}
+
+bool ImageSequenceSource::read( Mat &frame )
+{
+    if( ! first.empty() )
+    {
+        // La primera ya se leyo para saber el tamanio
+        frame = first;
+        first = Mat();
+    }
+    else
+    {
+        frame = imread( path( index ) );
+    }
+
+    if( frame.empty() ) return false;
+
+    index++;
+    return true;
+}
+
+Size ImageSequenceSource::frameSize()
+{
+    if( ! first.empty() ) return first.size();
+
+    Mat image = imread( path( index ) );
+    return image.size();
+}
+
+bool ImageSequenceSource::isOpened()
+{
+    return ! first.empty();
+}
+
+SyntheticSource::SyntheticSource( Size size ) : size( size ),
+                                                index( 0 )
+{
+}
+
+bool SyntheticSource::read( Mat &frame )
+{
+    // Fondo gris y una mano abierta color piel ( palma y cinco dedos ) que va y viene por la imagen y abre
+    // y cierra un poco los dedos. Solo depende de index, asi dos corridas dan los mismos cuadros.
+
+    frame.create( size, CV_8UC3 );
+    frame.setTo( Scalar( 120, 120, 120 ) );
+
+    const Scalar skin( 90, 110, 200 );
+    const double t = index * 0.05;
+
+    int palm = std::min( size.width, size.height ) / 8;
+    Point center( size.width / 2 + int( size.width / 6 * sin( t ) ),
+                  size.height * 3 / 5 + int( size.height / 12 * cos( 0.7 * t ) ) );
+
+    // Antebrazo hasta el borde de abajo
+    rectangle( frame, Point( center.x - palm * 2 / 3, center.y ), Point( center.x + palm * 2 / 3, size.height ),
+               skin, CV_FILLED );
+    circle( frame, center, palm, skin, CV_FILLED );
+
+    double spread = 0.30 + 0.05 * sin( 0.5 * t );
+    for( int i = 0; i < 5; i++ )
+    {
+        // Del pulgar ( a la izquierda, mas corto ) al menique
+        double angle = CV_PI / 2 + ( 2 - i ) * spread + ( i == 0 ? 0.35 : 0 );
+        double length = palm * ( i == 0 ? 1.3 : ( i == 2 ? 2.0 : 1.8 ) );
+
+        Point base = center + Point( int( palm * 0.8 * cos( angle ) ), - int( palm * 0.8 * sin( angle ) ) );
+        Point tip = center + Point( int( length * cos( angle ) ), - int( length * sin( angle ) ) );
+
+        line( frame, base, tip, skin, std::max( 3, palm / 3 ) );
+        circle( frame, tip, std::max( 2, palm / 6 ), skin, CV_FILLED );
+    }
+
+    index++;
+    return true;
+}
+
+Size SyntheticSource::frameSize()
+{
+    return size;
+}
@@ -0,0 +1,117 @@
+#ifndef FRAMESOURCE_H
+#define FRAMESOURCE_H
+
+#include <string>
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Origen de cuadros BGR para el procesamiento: la camara, un video grabado, una secuencia de imagenes o una
+ * mano sintetica. Lo usan CaptureThread y el programa de replay.
+ */
+class FrameSource
+{
+public:
+
+    virtual ~FrameSource()
+    {
+    }
+
+    /**
+     * Deja el proximo cuadro en frame. Devuelve false si no hay ( fin del video, camara desconectada ).
+     */
+    virtual bool read( Mat &frame ) = 0;
+
+    virtual Size frameSize() = 0;
+
+    /**
+     * Abre el origen descripto por spec:
+     *   camera:N            la camara N
+     *   synthetic[:WxH]     una mano dibujada que se mueve, siempre igual ( por defecto 640x480 )
+     *   algo%04d.png        una secuencia de imagenes, empezando en 0 o en 1
+     *   cualquier otra cosa un archivo de video
+     * Devuelve NULL si no se puede abrir.
+     */
+    static FrameSource *open( const string &spec );
+
+    /**
+     * Segundos desde un origen fijo, con el reloj monotono de OpenCV. Es el reloj de las marcas de tiempo de los
+     * cuadros ( CaptureThread ) y de PoseFilter.
+     */
+    static double now();
+};
+
+class CameraSource : public FrameSource
+{
+public:
+
+    CameraSource( int device );
+
+    bool read( Mat &frame );
+    Size frameSize();
+
+    bool isOpened();
+
+private:
+
+    VideoCapture videoCapture;
+};
+
+class VideoFileSource : public FrameSource
+{
+public:
+
+    VideoFileSource( const string &path );
+
+    bool read( Mat &frame );
+    Size frameSize();
+
+    bool isOpened();
+
+private:
+
+    VideoCapture videoCapture;
+};
+
+class ImageSequenceSource : public FrameSource
+{
+public:
+
+    /**
+     * pattern es un formato de printf con el numero de imagen, por ejemplo "../Files/mano%03d.png".
+     */
+    ImageSequenceSource( const string &pattern );
+
+    bool read( Mat &frame );
+    Size frameSize();
+
+    bool isOpened();
+
+private:
+
+    string pattern;
+    int index;
+    Mat first;
+
+    string path( int index );
+};
+
+class SyntheticSource : public FrameSource
+{
+public:
+
+    SyntheticSource( Size size );
+
+    bool read( Mat &frame );
+    Size frameSize();
+
+private:
+
+    Size size;
+    int index;
+};
+
+#endif // FRAMESOURCE_H
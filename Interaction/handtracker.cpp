@@ -0,0 +1,477 @@
+#include "handtracker.h"
+#include "profiler.h"
+
+HandTracker::HandTracker() : minimumA( -1 ),
+                             maximumA( -1 ),
+                             pyramidLevel( 0 ),
+                             drawing( true ),
+                             lastFingers( 0 )
+{
+}
+
+void HandTracker::setSkinRange( int minimumA, int maximumA )
+{
+    this->minimumA = minimumA;
+    this->maximumA = maximumA;
+}
+
+void HandTracker::setPyramidLevel( int level )
+{
+    pyramidLevel = level;
+}
+
+void HandTracker::setDrawing( bool drawing )
+{
+    this->drawing = drawing;
+}
+
+double HandTracker::distance( Point a, Point b )
+{
+    return ( a.x - b.x ) * ( a.x - b.x ) + ( a.y - b.y ) * ( a.y - b.y );
+}
+
+vector< float > HandTracker::handModel( const HandResult &hand )
+{
+    vector< float > model;
+
+    if( hand.relevants.size() != 12 ) return model;
+
+    // Puntas de los dedos 10, 9, 2 y 1 respecto del centro de la palma, en el plano z = 0
+    const int indices[ 4 ] = { 10, 9, 2, 1 };
+    for( int i = 0; i < 4; i++ )
+    {
+        model.push_back( hand.relevants.at( indices[ i ] ).x - hand.baricenter.x );
+        model.push_back( hand.baricenter.y - hand.relevants.at( indices[ i ] ).y );
+        model.push_back( 0 );
+    }
+
+    for( unsigned int i = 0; i < model.size(); i++ )
+        model[ i ] /= 5000.0;
+
+    return model;
+}
+
+bool HandTracker::estimatePose( const HandResult &hand, const vector< float > &model,
+                                const CameraParameters &camera, Marker &marker,
+                                PlanarPoseSolver *solver )
+{
+    if( model.size() != 12 || hand.relevants.size() != 12 )
+    {
+        if( solver ) solver->reset();
+        return false;
+    }
+
+    vector< Point2f > corners;
+    corners.push_back( hand.relevants.at( 10 ) );
+    corners.push_back( hand.relevants.at( 9 ) );
+    corners.push_back( hand.relevants.at( 2 ) );
+    corners.push_back( hand.relevants.at( 1 ) );
+
+    marker = Marker( corners, 1 );
+
+    marker.calculateExtrinsicsHandMatrix( 0.08f,
+                                          camera.CameraMatrix,
+                                          model,
+                                          camera.Distorsion,
+                                          true,
+                                          solver );
+    return true;
+}
+
+void HandTracker::process( Mat &frame, HandResult &result )
+{
+    PROFILE_SCOPE( PROCESS );
+
+    vector< Point > &relevants = result.relevants;
+
+    // Todo el procesamiento se hace dentro de la ventana alrededor de la mano del cuadro anterior. Con
+    // pyramidLevel > 0 la ventana se reduce scale veces antes de segmentar. Los contornos y el cierre convexo
+    // se pasan a coordenadas de la imagen completa multiplicando por scale y sumando offset, asi las areas,
+    // distancias y profundidades de mas abajo siguen en pixeles de la imagen completa.
+
+    const int level = pyramidLevel;
+    const int scale = 1 << level;
+
+    Rect roi = roiTracker.next( frame.size() );
+    roi.x -= roi.x % scale;
+    roi.y -= roi.y % scale;
+    roi.width -= roi.width % scale;
+    roi.height -= roi.height % scale;
+
+    Point offset = roi.tl() + Point( scale / 2, scale / 2 );
+
+    Mat window = frame( roi );
+
+    PROFILE_START( SEGMENTATION );
+
+    if( level > 0 )
+    {
+        // Copia limpia para refinar los puntos antes de que se dibuje sobre frame
+        window.copyTo( pyramidSource );
+        cv::resize( window, pyramidWindow, Size( roi.width / scale, roi.height / scale ), 0, 0, INTER_AREA );
+        window = pyramidWindow;
+    }
+
+    // Filtramos por color. Solo se controla el a del Lab ( setSkinRange ), calculado directamente desde el BGR
+    // ( ver SkinSegmenter; SkinLUT da lo mismo pero es mas lento, medido con bench skin ).
+    // ( Lo del Emi elegia hue, sat y val haciendo clic en la pantalla sobre la imagen en HSV )
+
+    SkinSegmenter::segment( window, skinMask, minimumA, maximumA );
+
+    PROFILE_STOP( SEGMENTATION );
+
+    Mat binary = skinMask;
+
+    // Erosion y dilatacion de la imagen binaria
+
+//    Mat matrix = ( Mat_< uchar >( 7, 7 ) << 0,0,1,1,1,0,0,
+//                                            0,1,1,1,1,1,0,
+//                                            1,1,1,1,1,1,1,
+//                                            1,1,1,1,1,1,1,
+//                                            1,1,1,1,1,1,1,
+//                                            0,1,1,1,1,1,0,
+//                                            0,0,1,1,1,0,0);
+
+    // Cruz de 19x19 ( MORPH_CROSS ), separada en pasadas horizontal y vertical
+
+    PROFILE_START( MORPHOLOGY );
+
+    int erosion_size = 9;
+    morphology.openCross( binary, binary, erosion_size / scale );
+
+    PROFILE_STOP( MORPHOLOGY );
+
+    // findContours modifica binary, la mascara queda para la miniatura y para mask()
+    binary.copyTo( handMask );
+
+    // Cierre convexo, con los extremos de cada fila en lugar de todos los pixeles ( ver rowExtents )
+
+    PROFILE_START( HULL );
+
+    vector< Point > points;
+    rowExtents( binary, points, scale, offset );
+
+    vector< Point > hull;
+    hull.clear();
+
+    if( points.size() > 0 )
+        convexHull( Mat( points ), hull, false );
+
+    PROFILE_STOP( HULL );
+
+    // Dibujamos extremos
+
+    int minimumDistance = 3000;
+
+    vector< Point > baricenters;
+
+    if( hull.size() > 1 )
+    {
+        if( distance( hull.at( 0 ), hull.at( ( hull.size() - 1 ) ) ) > minimumDistance )
+        {
+            baricenters.push_back( hull.at( 0 ) );
+        }
+    }
+
+    for( unsigned int i = 1; i < hull.size(); i++ )
+    {
+        if( distance( hull.at( i ), hull.at( i - 1 ) ) > minimumDistance )
+        {
+            baricenters.push_back( hull.at( i ) );
+        }
+    }
+
+    // Centro de masa segun cierre convexo
+
+    if( baricenters.size() > 0 )
+    {
+        baricenter.x = 0;
+        baricenter.y = 0;
+
+        for( unsigned int i = 0; i < baricenters.size(); i++ )
+        {
+            baricenter.x += baricenters.at( i ).x;
+            baricenter.y += baricenters.at( i ).y;
+        }
+
+        baricenter.x /= baricenters.size();
+        baricenter.y /= baricenters.size();
+
+        // Dibuja el centro de la palma
+//        circle( frame, baricenter, 10 , Scalar( 255, 0, 255 ), 2 );
+
+        // Dibuja lineas grises desde el centro a los bordes
+        for( unsigned int i = 0; i < baricenters.size(); i++ )
+        {
+            if( drawing ) line( frame, baricenters.at( i ), baricenter, Scalar( 128, 128, 128 ), 1 );
+        }
+    }
+
+    // Dibujamos bordes, Entre las puntas de los dedos
+    if( drawing && hull.size() > 1 )
+        line( frame, hull.at( 0 ), hull.at( ( hull.size() - 1 ) ), Scalar( 128, 128, 128 ), 1 );
+
+    double distanciaEuclidian = 0;
+    double sumatoriaDistancia = 0;
+    double sumatoriaVarianzaDistancia = 0;
+    float promediaDistancia = 0;
+    float varianzaDistancia = 0;
+
+    // Dibujamos bordes, Entre las puntas de los dedos
+    for( unsigned int i = 1; i < hull.size(); i++ )
+    {
+        if( drawing ) line( frame, hull.at( i ), hull.at( i - 1 ), Scalar( 128, 128, 128 ), 1 );
+
+        distanciaEuclidian = cv::norm(hull.at( i ) - hull.at( i - 1 ));//Euclidian distance
+        sumatoriaDistancia += distanciaEuclidian;
+//        qDebug() << "distanciaEuclidian=" << distanciaEuclidian;
+
+    }
+
+    promediaDistancia = sumatoriaDistancia/(hull.size()-1);
+//    qDebug() << "promediaDistancia=" << promediaDistancia;
+
+    for( unsigned int i = 1; i < hull.size(); i++ )
+    {
+
+        distanciaEuclidian = cv::norm(hull.at( i ) - hull.at( i - 1 ));//Euclidian distance
+        sumatoriaVarianzaDistancia = sumatoriaVarianzaDistancia +
+                (distanciaEuclidian-promediaDistancia) * (distanciaEuclidian-promediaDistancia);
+//        qDebug() << "sumatoriaVarianzaDistancia=" << sumatoriaVarianzaDistancia;
+
+    }
+
+    varianzaDistancia = sqrt(sumatoriaVarianzaDistancia/(hull.size()-1));
+    result.hullDeviation = varianzaDistancia;
+
+
+    // Buscamos los contornos en la imagen binaria
+    PROFILE_START( CONTOURS );
+
+    vector< vector< Point > > contours;
+    findContours( binary, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE );
+
+    for( unsigned int i = 0; i < contours.size(); i++ )
+        for( unsigned int j = 0; j < contours[i].size(); j++ )
+            contours[i][j] = contours[i][j] * scale + offset;
+
+    PROFILE_STOP( CONTOURS );
+
+    PROFILE_START( DEFECTS );
+
+    relevants.clear();
+    int fingers = 1;
+
+    Rect handBox;
+
+    for( unsigned int i = 0 ; i < contours.size(); i++ )
+    {
+        // Ignoramos las areas insignificantes
+        if( contourArea( contours[i] ) >= 3000 )
+        {
+            // En OpenCV 2.4 el | de Rect no ignora el rectangulo vacio
+            Rect box = boundingRect( contours[i] );
+            handBox = handBox.area() > 0 ? ( handBox | box ) : box;
+
+            // Detectamos cierre convexo en el contorno actual
+            vector<vector< Point > > hulls( 1 );
+            vector<vector< int > > hullsI( 1 );
+            convexHull( Mat( contours[i] ), hulls[0], false );
+            convexHull( Mat( contours[i] ), hullsI[0], false );
+
+            // Buscamos defectos de convexidad
+            vector< Vec4i > defects;
+            if ( hullsI[0].size() > 0 )
+            {
+                convexityDefects( contours[i], hullsI[0], defects );
+                if( defects.size() >= 3 )
+                {
+                    float umbral = 0;  // umbral para la profundidad de la concavidad
+                    float sumatoria = 0;
+                    float promedio = 0;
+                    float varianza = 0;
+
+                    // Para el promedio
+                    for( unsigned int j = 0; j < defects.size(); j++ )
+                    {
+                        float depth = defects[j][3] / 256;
+
+                        sumatoria += depth;
+                    }
+                    promedio = sumatoria/defects.size();
+//                    qDebug() << "Promedio = " << promedio;
+
+                    sumatoria = 0;  // Ponemos en cero para usarla para la varianza
+
+                    // Para la varianza
+                    for( unsigned int j = 0; j < defects.size(); j++ )
+                    {
+                        float depth = defects[j][3] / 256;
+                        sumatoria = sumatoria + (depth-promedio) * (depth-promedio);
+                    }
+
+                    varianza = sqrt(sumatoria/defects.size());
+//                    qDebug() << "Varianza = " << varianza;
+
+                    for( unsigned int j = 0; j < defects.size(); j++ )
+                    {
+                        // the farthest from the convex hull point within the defect
+                        float depth = defects[j][3] / 256;
+
+
+
+//                        qDebug() << depth;
+
+                        // Filtramos por profundidad
+//                        if( depth > 100 )  // Umbral para que no detecte valle en la muneca
+//                        if( depth > 70 )
+                        if( depth > promedio )
+                        {
+                            // Entra a este if cada vez que supere esta depth, deberia detectar 4 depth que superen
+                            // este umbral. Es decir, detectar los 4 valles. Si el antebrazo se muestra mucho,
+                            // entonces quizas se detecte un valle mas, que parezca un sexto dedo.
+
+                            // Cuando la mano se aleja, los depth no llegan a superar el umbral. Deberia fijarse
+                            // como umbral un porcentaje y no una distancia fija.
+
+                            // Valles = convexity defects = defectos de convexidad
+                            // Envoltura convexa = convex hull
+
+                            int startidx = defects[j][0];
+                            Point ptStart( contours[i][startidx] );
+
+                            int endidx = defects[j][1];
+                            Point ptEnd( contours[i][endidx] );
+
+                            int faridx = defects[j][2];
+                            Point ptFar( contours[i][faridx] );
+
+                            if( level > 0 )
+                            {
+                                ptStart = refinePoint( ptStart, roi.tl(), scale );
+                                ptFar = refinePoint( ptFar, roi.tl(), scale );
+                                ptEnd = refinePoint( ptEnd, roi.tl(), scale );
+                            }
+
+//                            qDebug() << "cv::norm(ptStart - ptEnd)"  << cv::norm(ptStart - ptEnd);
+
+
+//                            if ( cv::norm(ptStart - ptEnd) < varianzaDistancia )  {
+
+                            if( drawing )
+                            {
+                                circle( frame, ptStart, 8, Scalar( 255, 0, 0 ), 2 );
+                                circle( frame, ptFar, 8, Scalar( 0, 255, 0 ), 2 );
+                                circle( frame, ptEnd, 8, Scalar( 0, 0, 255 ), 2 );
+                            }
+//                            }
+
+                            relevants.push_back( ptStart );
+                            relevants.push_back( ptFar );
+                            relevants.push_back( ptEnd );
+
+                            fingers++;
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    PROFILE_STOP( DEFECTS );
+
+    if( drawing && fingers > 1 )
+    {
+        putText( frame, format( "Dedos: %d", fingers ), Point( 10, 30 ), 1, 2, Scalar( 255, 0, 0 ) );
+    }
+
+    // Aca se detecta la interaccion para cambiar de modelo a dibujar
+    result.fingers = fingers;
+    result.changeModel = fingers == 5  && lastFingers == 4;
+
+    lastFingers = fingers;
+
+    roiTracker.update( handBox );
+    result.window = roi;
+    result.baricenter = baricenter;
+
+    if( ! drawing ) return;
+
+    // Mostramos miniatura, con la mascara de la ventana en su lugar dentro de la imagen
+    Mat mask = Mat::zeros( frame.rows, frame.cols, CV_8UC1 );
+    Mat maskWindow = mask( roi );
+    cv::resize( handMask, maskWindow, roi.size(), 0, 0, INTER_NEAREST );
+    Mat preview( mask.rows, mask.cols, CV_8UC3 );
+    cvtColor( mask, preview, CV_GRAY2BGR );
+    Mat previewResized( 96, 128, CV_8UC3 );
+    cv::resize( preview, previewResized, previewResized.size(), 0, 0, INTER_CUBIC );
+    previewResized.copyTo( frame( Rect( frame.cols - 135, frame.rows - 103, 128, 96 ) ) );
+}
+
+void HandTracker::rowExtents( const Mat &mask, vector< Point > &points, int scale, Point offset )
+{
+    points.clear();
+    points.reserve( 2 * mask.rows );
+
+    for( int i = 0; i < mask.rows; i++ )
+    {
+        const uchar *row = mask.ptr< uchar >( i );
+
+        int left = 0;
+        while( left < mask.cols && row[ left ] != 255 ) left++;
+
+        if( left == mask.cols ) continue;
+
+        int right = mask.cols - 1;
+        while( row[ right ] != 255 ) right--;
+
+        points.push_back( Point( left, i ) * scale + offset );
+        if( right != left ) points.push_back( Point( right, i ) * scale + offset );
+    }
+}
+
+Point HandTracker::refinePoint( Point coarse, Point origin, int scale )
+{
+    // El punto de la imagen reducida puede estar corrido hasta unos scale pixeles del borde real. Se repite
+    // segmentacion y apertura en una ventana chica de la imagen completa ( con lugar para la cruz de la
+    // apertura ) y se toma el pixel de borde mas cercano.
+
+    int erosion_size = 9;
+    int search = 2 * scale;
+    int half = search + 2 * erosion_size + 1;
+
+    Point center = coarse - origin;
+    Rect window( center.x - half, center.y - half, 2 * half + 1, 2 * half + 1 );
+    window &= Rect( 0, 0, pyramidSource.cols, pyramidSource.rows );
+
+    if( window.area() == 0 ) return coarse;
+
+    SkinSegmenter::segment( pyramidSource( window ), refineMask, minimumA, maximumA );
+    refineMorphology.openCross( refineMask, refineMask, erosion_size );
+
+    center -= window.tl();
+
+    Point best = coarse;
+    double bestDistance = search * search * 2 + 1;
+
+    for( int i = std::max( 1, center.y - search ); i <= std::min( refineMask.rows - 2, center.y + search ); i++ )
+    {
+        const uchar *row = refineMask.ptr< uchar >( i );
+
+        for( int j = std::max( 1, center.x - search ); j <= std::min( refineMask.cols - 2, center.x + search ); j++ )
+        {
+            if( row[ j ] != 255 ) continue;
+
+            bool border = row[ j - 1 ] == 0 || row[ j + 1 ] == 0 ||
+                          refineMask.ptr< uchar >( i - 1 )[ j ] == 0 || refineMask.ptr< uchar >( i + 1 )[ j ] == 0;
+
+            if( border && distance( Point( j, i ), center ) < bestDistance )
+            {
+                bestDistance = distance( Point( j, i ), center );
+                best = Point( j, i ) + window.tl() + origin;
+            }
+        }
+    }
+
+    return best;
+}
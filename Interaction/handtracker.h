@@ -0,0 +1,131 @@
+#ifndef HANDTRACKER_H
+#define HANDTRACKER_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <aruco/aruco.h>
+
+#include "skinsegmenter.h"
+#include "morphology.h"
+#include "roitracker.h"
+
+using namespace cv;
+using namespace std;
+using namespace aruco;
+
+/**
+ * Lo que encuentra HandTracker en un cuadro. Todas las coordenadas son de la imagen completa.
+ */
+struct HandResult
+{
+    vector< Point > relevants;  // ptStart, ptFar y ptEnd de cada valle encontrado
+    Point baricenter;           // Centro de la palma segun el cierre convexo ( el del ultimo cuadro que lo tuvo )
+    int fingers;                // 1 + cantidad de valles
+    bool changeModel;           // Se abrio la mano: 5 dedos despues de 4
+    float hullDeviation;        // Desvio de las distancias entre vertices del cierre convexo
+    Rect window;                // Ventana de la imagen que se proceso
+
+    HandResult() : fingers( 0 ), changeModel( false ), hullDeviation( 0 )
+    {
+    }
+};
+
+inline void swap( HandResult &a, HandResult &b )
+{
+    a.relevants.swap( b.relevants );
+    std::swap( a.baricenter, b.baricenter );
+    std::swap( a.fingers, b.fingers );
+    std::swap( a.changeModel, b.changeModel );
+    std::swap( a.hullDeviation, b.hullDeviation );
+    std::swap( a.window, b.window );
+}
+
+/**
+ * Deteccion de la mano y de los valles entre los dedos, sin interfaz: segmentacion de piel, apertura,
+ * cierre convexo, contornos y defectos de convexidad. Lo usan Scene ( en el hilo de procesamiento ) y el
+ * programa de replay.
+ *
+ * Guarda estado entre cuadros ( la ventana alrededor de la mano, la cantidad de dedos del cuadro anterior ),
+ * asi que cada secuencia de cuadros necesita su propio HandTracker.
+ */
+class HandTracker
+{
+public:
+
+    HandTracker();
+
+    /**
+     * Rango del canal a del Lab que NO es piel ( Skin::minimumHue y Skin::maximumHue ).
+     */
+    void setSkinRange( int minimumA, int maximumA );
+
+    /**
+     * Busca la mano en la imagen reducida 2^level veces, ver Scene::pyrDown().
+     */
+    void setPyramidLevel( int level );
+
+    /**
+     * Si se dibujan sobre frame el cierre convexo, los valles, la cantidad de dedos y la miniatura de la
+     * mascara. Por defecto si.
+     */
+    void setDrawing( bool drawing );
+
+    void process( Mat &frame, HandResult &result );
+
+    /**
+     * Modelo de la mano ( 4 puntos 3D, 12 valores ) a partir de un cuadro con la mano abierta ( 4 valles ).
+     * Vacio si hand no tiene 12 relevants.
+     */
+    static vector< float > handModel( const HandResult &hand );
+
+    /**
+     * Pose de la mano respecto de la camara con el modelo de handModel(). Devuelve false si hand no tiene
+     * 12 relevants o el modelo no es valido; si no, deja Rvec y Tvec en marker. solver guarda la pose de un
+     * cuadro para el siguiente ( ver PlanarPoseSolver ), se olvida cuando no hay mano.
+     */
+    static bool estimatePose( const HandResult &hand, const vector< float > &model,
+                              const CameraParameters &camera, Marker &marker,
+                              PlanarPoseSolver *solver = NULL );
+
+    /**
+     * Mascara de piel ya abierta del ultimo process(), en coordenadas de la ventana ( result.window, reducida
+     * 2^level veces ): 255 en la mano.
+     */
+    const Mat &mask() const
+    {
+        return handMask;
+    }
+
+    /**
+     * Primer y ultimo pixel en 255 de cada fila de mask ( uno solo si coinciden ), multiplicados por scale y
+     * corridos offset. Los del medio de cada fila nunca son vertices del cierre convexo, asi que convexHull()
+     * de estos puntos da lo mismo que el de todos los pixeles de la mano, con solo 2 puntos por fila.
+     */
+    static void rowExtents( const Mat &mask, vector< Point > &points, int scale = 1, Point offset = Point() );
+
+private:
+
+    int minimumA, maximumA;
+    int pyramidLevel;
+    bool drawing;
+
+    Mat skinMask;
+    Mat handMask;
+    Morphology morphology;
+    RoiTracker roiTracker;
+
+    // Busqueda en la imagen reducida y refinamiento de relevants en la imagen completa
+    Mat pyramidSource, pyramidWindow;
+    Mat refineMask;
+    Morphology refineMorphology;
+    Point refinePoint( Point coarse, Point origin, int scale );
+
+    Point baricenter;
+    int lastFingers;
+
+    static double distance( Point a, Point b );
+};
+
+#endif // HANDTRACKER_H
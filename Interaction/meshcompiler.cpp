@@ -0,0 +1,269 @@
+#include "meshcompiler.h"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+namespace
+{
+
+const int VERTEX_FLOATS = CompiledMesh::VERTEX_FLOATS;
+const int CACHE_SIZE = MeshCompiler::CACHE_SIZE;
+
+/**
+ * Tabla de hash abierta de vertices: guarda el indice de cada vertice distinto y los compara por sus bytes.
+ */
+class VertexTable
+{
+public:
+
+    VertexTable( const std::vector< float > &vertices, int capacity ) : vertices( vertices )
+    {
+        size = 1;
+        while( size < ( unsigned int )( 2 * capacity ) ) size *= 2;
+        slots.assign( size, -1 );
+    }
+
+    // Indice del vertice igual a vertex ( VERTEX_FLOATS floats ), o -1 si es nuevo y queda guardado como index
+    int find( const float *vertex, int index )
+    {
+        unsigned int slot = hash( vertex ) & ( size - 1 );
+
+        while( slots[ slot ] >= 0 )
+        {
+            if( ! memcmp( &vertices[ slots[ slot ] * VERTEX_FLOATS ], vertex, VERTEX_FLOATS * sizeof( float ) ) )
+                return slots[ slot ];
+            slot = ( slot + 1 ) & ( size - 1 );
+        }
+
+        slots[ slot ] = index;
+        return -1;
+    }
+
+private:
+
+    const std::vector< float > &vertices;
+    std::vector< int > slots;
+    unsigned int size;
+
+    // FNV-1a sobre los bytes del vertice
+    static unsigned int hash( const float *vertex )
+    {
+        const unsigned char *bytes = ( const unsigned char * )vertex;
+        unsigned int h = 2166136261u;
+        for( unsigned int i = 0; i < VERTEX_FLOATS * sizeof( float ); i++ ) h = ( h ^ bytes[ i ] ) * 16777619u;
+        return h;
+    }
+};
+
+/**
+ * Puntaje de un vertice segun su lugar en la cache ( -1 si no esta ) y los triangulos que le quedan, con las
+ * constantes del articulo de Forsyth.
+ */
+float vertexScore( int cachePosition, int remaining )
+{
+    if( remaining == 0 ) return -1;
+
+    float score = 0;
+
+    if( cachePosition >= 0 )
+    {
+        // Los tres del ultimo triangulo tienen un puntaje fijo, para no favorecer tiras largas
+        if( cachePosition < 3 ) score = 0.75f;
+        else score = pow( 1 - ( cachePosition - 3 ) / float( CACHE_SIZE - 3 ), 1.5f );
+    }
+
+    // Los vertices con pocos triangulos pendientes conviene terminarlos, para que no queden sueltos al final
+    return score + 2 * pow( float( remaining ), -0.5f );
+}
+
+}
+
+void MeshCompiler::compile( const float *positions, const float *normals, const float *texCoords, int triangles,
+                            CompiledMesh &mesh )
+{
+    mesh.vertices.clear();
+    mesh.indices.clear();
+    mesh.vertices.reserve( triangles * 3 * VERTEX_FLOATS );
+    mesh.indices.reserve( triangles * 3 );
+
+    VertexTable table( mesh.vertices, triangles * 3 );
+
+    for( int corner = 0; corner < triangles * 3; corner++ )
+    {
+        float vertex[ VERTEX_FLOATS ];
+        for( int i = 0; i < 3; i++ )
+        {
+            vertex[ i ] = positions[ corner * 3 + i ];
+            vertex[ 3 + i ] = normals[ corner * 3 + i ];
+        }
+        vertex[ 6 ] = texCoords ? texCoords[ corner * 2 ] : 0;
+        vertex[ 7 ] = texCoords ? texCoords[ corner * 2 + 1 ] : 0;
+
+        // Se comparan los bytes: -0 y 0 tienen que ser el mismo numero
+        for( int i = 0; i < VERTEX_FLOATS; i++ ) vertex[ i ] += 0.0f;
+
+        int index = mesh.vertexCount();
+        int found = table.find( vertex, index );
+
+        if( found >= 0 ) mesh.indices.push_back( found );
+        else
+        {
+            mesh.vertices.insert( mesh.vertices.end(), vertex, vertex + VERTEX_FLOATS );
+            mesh.indices.push_back( index );
+        }
+    }
+
+    optimizeVertexCache( mesh.indices, mesh.vertexCount() );
+
+    // Los vertices en el orden en que aparecen en los indices
+    std::vector< int > newIndex( mesh.vertexCount(), -1 );
+    std::vector< float > ordered( mesh.vertices.size() );
+    int next = 0;
+
+    for( unsigned int i = 0; i < mesh.indices.size(); i++ )
+    {
+        unsigned int &index = mesh.indices[ i ];
+        if( newIndex[ index ] < 0 )
+        {
+            newIndex[ index ] = next;
+            std::copy( &mesh.vertices[ index * VERTEX_FLOATS ], &mesh.vertices[ index * VERTEX_FLOATS ] + VERTEX_FLOATS,
+                       &ordered[ next * VERTEX_FLOATS ] );
+            next++;
+        }
+        index = newIndex[ index ];
+    }
+
+    mesh.vertices.swap( ordered );
+}
+
+void MeshCompiler::optimizeVertexCache( std::vector< unsigned int > &indices, int vertexCount )
+{
+    const int triangleCount = indices.size() / 3;
+    if( triangleCount == 0 ) return;
+
+    // Triangulos de cada vertice, en un solo arreglo: los de v van de first[ v ] a first[ v + 1 ]
+    std::vector< int > remaining( vertexCount, 0 );
+    for( unsigned int i = 0; i < indices.size(); i++ ) remaining[ indices[ i ] ]++;
+
+    std::vector< int > first( vertexCount + 1, 0 );
+    for( int v = 0; v < vertexCount; v++ ) first[ v + 1 ] = first[ v ] + remaining[ v ];
+
+    std::vector< int > adjacency( indices.size() );
+    std::vector< int > filled( first.begin(), first.end() - 1 );
+    for( int t = 0; t < triangleCount; t++ )
+        for( int k = 0; k < 3; k++ ) adjacency[ filled[ indices[ t * 3 + k ] ]++ ] = t;
+
+    std::vector< int > cachePosition( vertexCount, -1 );
+    std::vector< float > score( vertexCount );
+    for( int v = 0; v < vertexCount; v++ ) score[ v ] = vertexScore( -1, remaining[ v ] );
+
+    std::vector< bool > emitted( triangleCount, false );
+
+    // Cache LRU: los tres del ultimo triangulo entran antes de sacar los viejos, por eso tiene 3 lugares de mas
+    int cache[ CACHE_SIZE + 3 ], cacheCount = 0;
+
+    std::vector< unsigned int > result;
+    result.reserve( indices.size() );
+
+    int best = -1;
+    int cursor = 0;
+
+    for( int done = 0; done < triangleCount; done++ )
+    {
+        // Si ningun vertice de la cache tiene triangulos pendientes se sigue por el primero que no se emitio. No es
+        // el de mas puntaje de toda la malla, pero asi el algoritmo queda lineal
+        if( best < 0 )
+        {
+            while( emitted[ cursor ] ) cursor++;
+            best = cursor;
+        }
+
+        emitted[ best ] = true;
+
+        int newCache[ CACHE_SIZE + 3 ], newCount = 0;
+
+        for( int k = 0; k < 3; k++ )
+        {
+            int v = indices[ best * 3 + k ];
+            result.push_back( v );
+            newCache[ newCount++ ] = v;
+
+            // El triangulo deja de estar pendiente para sus vertices
+            remaining[ v ]--;
+            for( int a = first[ v ]; a < first[ v ] + remaining[ v ] + 1; a++ )
+                if( adjacency[ a ] == best )
+                {
+                    std::swap( adjacency[ a ], adjacency[ first[ v ] + remaining[ v ] ] );
+                    break;
+                }
+        }
+
+        for( int i = 0; i < cacheCount; i++ )
+        {
+            int v = cache[ i ];
+            if( v != newCache[ 0 ] && v != newCache[ 1 ] && v != newCache[ 2 ] ) newCache[ newCount++ ] = v;
+        }
+
+        // Los que salen de la cache pierden su puntaje por posicion
+        for( int i = CACHE_SIZE; i < newCount; i++ )
+        {
+            cachePosition[ newCache[ i ] ] = -1;
+            score[ newCache[ i ] ] = vertexScore( -1, remaining[ newCache[ i ] ] );
+        }
+
+        cacheCount = std::min( newCount, ( int )CACHE_SIZE );
+        std::copy( newCache, newCache + cacheCount, cache );
+
+        for( int i = 0; i < cacheCount; i++ )
+        {
+            cachePosition[ cache[ i ] ] = i;
+            score[ cache[ i ] ] = vertexScore( i, remaining[ cache[ i ] ] );
+        }
+
+        // Solo cambian los puntajes de los triangulos de los vertices de la cache, y entre ellos esta el proximo
+        best = -1;
+        float bestScore = 0;
+
+        for( int i = 0; i < cacheCount; i++ )
+        {
+            int v = cache[ i ];
+            for( int a = first[ v ]; a < first[ v ] + remaining[ v ]; a++ )
+            {
+                int t = adjacency[ a ];
+                float s = score[ indices[ t * 3 ] ] + score[ indices[ t * 3 + 1 ] ] + score[ indices[ t * 3 + 2 ] ];
+
+                if( s > bestScore )
+                {
+                    bestScore = s;
+                    best = t;
+                }
+            }
+        }
+    }
+
+    indices.swap( result );
+}
+
+double MeshCompiler::averageCacheMissRatio( const std::vector< unsigned int > &indices, int cacheSize )
+{
+    if( indices.empty() ) return 0;
+
+    unsigned int maximum = *std::max_element( indices.begin(), indices.end() );
+
+    // Momento en que entro cada vertice a la cache FIFO; esta si entro hace menos de cacheSize fallos
+    std::vector< long > entered( maximum + 1, -1 );
+    long misses = 0;
+
+    for( unsigned int i = 0; i < indices.size(); i++ )
+    {
+        long &time = entered[ indices[ i ] ];
+        if( time < 0 || misses - time >= cacheSize )
+        {
+            time = misses;
+            misses++;
+        }
+    }
+
+    return misses / ( indices.size() / 3.0 );
+}
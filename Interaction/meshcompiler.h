@@ -0,0 +1,75 @@
+#ifndef MESHCOMPILER_H
+#define MESHCOMPILER_H
+
+#include <vector>
+
+/**
+ * Malla lista para subir a la GPU: un solo arreglo de vertices intercalados ( posicion, normal y coordenadas de
+ * textura de cada vertice juntas ) y la lista de indices de los triangulos.
+ */
+struct CompiledMesh
+{
+    enum { VERTEX_FLOATS = 8 };             // x y z, nx ny nz, s t
+
+    std::vector< float > vertices;          // VERTEX_FLOATS por vertice
+    std::vector< unsigned int > indices;    // 3 por triangulo
+
+    int vertexCount() const
+    {
+        return vertices.size() / VERTEX_FLOATS;
+    }
+
+    // Si los indices entran en 16 bits ( GL_UNSIGNED_SHORT )
+    bool shortIndices() const
+    {
+        return vertexCount() <= 65536;
+    }
+
+    // Bytes de los dos buffers en la GPU
+    int bytes() const
+    {
+        return vertices.size() * sizeof( float ) + indices.size() * ( shortIndices() ? 2 : 4 );
+    }
+};
+
+/**
+ * Convierte los triangulos de un modelo, con los atributos repetidos en cada esquina ( como los arma
+ * Scene::prepareModels a partir de lib3ds ), en una CompiledMesh:
+ *
+ *   1. Une los vertices identicos: las esquinas con la misma posicion, normal y coordenadas de textura pasan a
+ *      ser un solo vertice. Las normales de lib3ds ya respetan los grupos de suavizado, asi que se unen solo los
+ *      vertices que se dibujarian igual.
+ *   2. Ordena los triangulos para aprovechar la cache de vertices ya transformados de la GPU, con el algoritmo
+ *      de Tom Forsyth ( "Linear-Speed Vertex Cache Optimisation", 2006 ): siempre se sigue por el triangulo con
+ *      mas puntaje, que es mayor para los vertices usados recien y para los que les quedan pocos triangulos.
+ *   3. Renumera los vertices en el orden en que los usan los triangulos, para que la lectura del buffer de
+ *      vertices sea lo mas secuencial posible.
+ *
+ * Sin OpenGL: la subida y el dibujo estan en Model.
+ */
+class MeshCompiler
+{
+public:
+
+    // Tamanio de la cache que simula el algoritmo de Forsyth
+    enum { CACHE_SIZE = 32 };
+
+    /**
+     * positions y normals tienen 9 floats por triangulo, texCoords 6 ( o NULL, y quedan en 0 ).
+     */
+    static void compile( const float *positions, const float *normals, const float *texCoords, int triangles,
+                         CompiledMesh &mesh );
+
+    /**
+     * Reordena los triangulos de indices ( de vertexCount vertices ) para la cache de vertices.
+     */
+    static void optimizeVertexCache( std::vector< unsigned int > &indices, int vertexCount );
+
+    /**
+     * Cantidad media de vertices transformados por triangulo con una cache FIFO de cacheSize vertices ( ACMR ).
+     * Va de 0.5 ( ideal en una malla grande ) a 3 ( sin ningun vertice compartido ).
+     */
+    static double averageCacheMissRatio( const std::vector< unsigned int > &indices, int cacheSize );
+};
+
+#endif // MESHCOMPILER_H
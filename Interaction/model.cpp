@@ -0,0 +1,172 @@
+#include "model.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+Model::Model( QString name, QObject *parent ) : QObject( parent ),
+                                                name ( name ),
+                                                textureId( 0 ),
+                                                totalFaces( 0 ),
+                                                model( NULL ),
+                                                genVertexArrays( NULL ),
+                                                bindVertexArray( NULL ),
+                                                deleteVertexArrays( NULL ),
+                                                vertexBuffer( 0 ), indexBuffer( 0 ), vertexArray( 0 ),
+                                                indexType( GL_UNSIGNED_SHORT ),
+                                                indexCount( 0 ),
+                                                bufferBytes( 0 )
+{
+    QString modelUri = "../Models/" + name;
+    if( QFile::exists( modelUri ) ) model = lib3ds_file_load( modelUri.toStdString().c_str() );
+}
+
+Model::~Model()
+{
+    if( model != NULL ) lib3ds_file_free( model );
+
+    // Solo si upload() llego a correr, que es el que inicializa las funciones de GL
+    if( vertexArray ) deleteVertexArrays( 1, &vertexArray );
+    if( vertexBuffer ) glDeleteBuffers( 1, &vertexBuffer );
+    if( indexBuffer ) glDeleteBuffers( 1, &indexBuffer );
+}
+
+void Model::getFaces()
+{
+    if( !model ) return;
+
+    totalFaces = 0;
+    Lib3dsMesh * mesh;
+    for( mesh = model->meshes; mesh != NULL; mesh = mesh->next ) totalFaces += mesh->faces;
+}
+
+bool Model::compile( CompiledMesh &mesh )
+{
+    getFaces();
+    if( !model || !totalFaces ) return false;
+
+    // Los atributos de cada esquina de cada cara, como los daba lib3ds
+    std::vector< float > vertices( totalFaces * 9 );
+    std::vector< float > normals( totalFaces * 9 );
+    std::vector< float > texCoords( totalFaces * 6, 0 );
+
+    unsigned int finishedFaces = 0;
+
+    for( Lib3dsMesh *mesh = model->meshes; mesh != NULL ; mesh = mesh->next )
+    {
+        if( ! mesh->faces ) continue;
+
+        lib3ds_mesh_calculate_normals( mesh, ( Lib3dsVector * )&normals[ finishedFaces * 9 ] );
+        for( unsigned int currentFace = 0; currentFace < mesh->faces ; currentFace++ )
+        {
+            Lib3dsFace * face = &mesh->faceL[ currentFace ];
+            for( unsigned int i = 0; i < 3; i++ )
+            {
+                // No todos los meshes tienen coordenadas de textura
+                if( face->points[ i ] < mesh->texels )
+                    memcpy( &texCoords[ ( finishedFaces * 3 + i ) * 2 ],
+                            mesh->texelL[ face->points[ i ] ],
+                            sizeof( Lib3dsTexel ) );
+
+                memcpy( &vertices[ ( finishedFaces * 3 + i ) * 3 ],
+                        mesh->pointL[ face->points[ i ] ].pos,
+                        sizeof( Lib3dsVector ) );
+            }
+            finishedFaces++;
+        }
+    }
+
+    MeshCompiler::compile( &vertices[ 0 ], &normals[ 0 ], &texCoords[ 0 ], totalFaces, mesh );
+    return true;
+}
+
+void Model::upload( const CompiledMesh &mesh )
+{
+    initializeGLFunctions();
+
+    const QGLContext *context = QGLContext::currentContext();
+
+    // Con getProcAddress no alcanza: algunos drivers devuelven punteros para funciones que no soportan
+    const char *version = ( const char * )glGetString( GL_VERSION );
+    const char *extensions = ( const char * )glGetString( GL_EXTENSIONS );
+    if( ( version && atoi( version ) >= 3 ) || ( extensions && strstr( extensions, "GL_ARB_vertex_array_object" ) ) )
+    {
+        genVertexArrays = ( GenVertexArrays )context->getProcAddress( "glGenVertexArrays" );
+        bindVertexArray = ( BindVertexArray )context->getProcAddress( "glBindVertexArray" );
+        deleteVertexArrays = ( DeleteVertexArrays )context->getProcAddress( "glDeleteVertexArrays" );
+    }
+
+    glGenBuffers( 1, &vertexBuffer );
+    glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+    glBufferData( GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof( float ), &mesh.vertices[ 0 ], GL_STATIC_DRAW );
+
+    indexCount = mesh.indices.size();
+
+    // Con menos de 65536 vertices los indices van en 16 bits: la mitad de memoria y de lectura
+    std::vector< GLushort > shortIndices;
+    const void *indices = &mesh.indices[ 0 ];
+    int indexBytes = indexCount * sizeof( GLuint );
+    indexType = GL_UNSIGNED_INT;
+
+    if( mesh.shortIndices() )
+    {
+        shortIndices.assign( mesh.indices.begin(), mesh.indices.end() );
+        indices = &shortIndices[ 0 ];
+        indexBytes = indexCount * sizeof( GLushort );
+        indexType = GL_UNSIGNED_SHORT;
+    }
+
+    glGenBuffers( 1, &indexBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW );
+
+    bufferBytes = mesh.vertices.size() * sizeof( float ) + indexBytes;
+
+    if( genVertexArrays && bindVertexArray && deleteVertexArrays )
+    {
+        genVertexArrays( 1, &vertexArray );
+        bindVertexArray( vertexArray );
+        setPointers();
+        bindVertexArray( 0 );
+    }
+
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+void Model::draw()
+{
+    if( !indexCount ) return;
+
+    if( vertexArray ) bindVertexArray( vertexArray );
+    else setPointers();
+
+    glDrawElements( GL_TRIANGLES, indexCount, indexType, NULL );
+
+    if( vertexArray ) bindVertexArray( 0 );
+    else
+    {
+        glDisableClientState( GL_VERTEX_ARRAY );
+        glDisableClientState( GL_NORMAL_ARRAY );
+        glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+    }
+
+    glBindBuffer( GL_ARRAY_BUFFER, 0 );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, 0 );
+}
+
+void Model::setPointers()
+{
+    const GLsizei stride = CompiledMesh::VERTEX_FLOATS * sizeof( float );
+
+    glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+
+    glEnableClientState( GL_VERTEX_ARRAY );
+    glEnableClientState( GL_NORMAL_ARRAY );
+    glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+
+    glVertexPointer( 3, GL_FLOAT, stride, ( const GLvoid * )0 );
+    glNormalPointer( GL_FLOAT, stride, ( const GLvoid * )( 3 * sizeof( float ) ) );
+    glTexCoordPointer( 2, GL_FLOAT, stride, ( const GLvoid * )( 6 * sizeof( float ) ) );
+}
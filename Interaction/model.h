@@ -3,10 +3,28 @@
 
 #include <QFile>
 #include <QGLWidget>
+#include <QGLFunctions>
 #include <lib3ds/file.h>
 #include <lib3ds/mesh.h>
 
-class Model : public QObject
+#include "meshcompiler.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+/**
+ * Modelo 3ds. El archivo se lee en el constructor; compile() lo pasa a una CompiledMesh ( vertices unidos y
+ * triangulos ordenados para la cache ) y upload() la sube a un buffer de vertices intercalados y uno de indices,
+ * asi draw() dibuja todo con un solo glDrawElements.
+ *
+ * Si el driver tiene vertex array objects ( GL 3.0 o GL_ARB_vertex_array_object ) la configuracion de los
+ * punteros queda guardada en un VAO en upload(), si no draw() la arma cada vez.
+ *
+ * upload(), draw() y el destructor, que libera los buffers y el VAO, se llaman desde el hilo de GL con el
+ * contexto activo.
+ */
+class Model : public QObject, protected QGLFunctions
 {
     Q_OBJECT
 
@@ -17,26 +35,48 @@ public:
     int totalFaces;
 
     Lib3dsFile *model;
-    GLuint vertexVBO, normalVBO, texCoordVBO;
 
-    Model( QString name, QObject *parent = 0 ) : QObject( parent ), name ( name ), textureId( 0 ), totalFaces( 0 )
+    Model( QString name, QObject *parent = 0 );
+
+    virtual ~Model();
+
+    void getFaces();
+
+    /**
+     * Arma la malla de todos los meshes del archivo, con las normales de lib3ds. Devuelve false si no hay
+     * archivo o no tiene caras.
+     */
+    bool compile( CompiledMesh &mesh );
+
+    /**
+     * Sube mesh a la GPU. Despues de esto el archivo ya no hace falta.
+     */
+    void upload( const CompiledMesh &mesh );
+
+    void draw();
+
+    // Bytes de los buffers en la GPU, 0 si todavia no se subio
+    int bytes() const
     {
-        QString modelUri = "../Models/" + name;
-        if( QFile::exists( modelUri ) ) model = lib3ds_file_load( modelUri.toStdString().c_str() );
+        return bufferBytes;
     }
 
-    virtual void CreateVBO() { }
+private:
 
-    virtual ~Model() { if( model != NULL ) lib3ds_file_free( model ); }
+    typedef void ( APIENTRY *GenVertexArrays )( GLsizei n, GLuint *arrays );
+    typedef void ( APIENTRY *BindVertexArray )( GLuint array );
+    typedef void ( APIENTRY *DeleteVertexArrays )( GLsizei n, const GLuint *arrays );
 
-    void getFaces()
-    {
-        if( !model ) return;
+    GenVertexArrays genVertexArrays;
+    BindVertexArray bindVertexArray;
+    DeleteVertexArrays deleteVertexArrays;
 
-        totalFaces = 0;
-        Lib3dsMesh * mesh;
-        for( mesh = model->meshes; mesh != NULL; mesh = mesh->next ) totalFaces += mesh->faces;
-    }
+    GLuint vertexBuffer, indexBuffer, vertexArray;
+    GLenum indexType;
+    int indexCount;
+    int bufferBytes;
+
+    void setPointers();
 };
 
 #endif // MODEL_H
@@ -0,0 +1,224 @@
+#include "morphology.h"
+
+#include <cstring>
+#include <algorithm>
+
+#if defined( __SSE2__ )
+#include <emmintrin.h>
+#define MORPHOLOGY_SSE2
+#endif
+
+// Ancho de las franjas de columnas de la pasada vertical
+#define MORPHOLOGY_STRIP 128
+
+// Filas que procesa juntas la pasada horizontal ( una por byte de un registro SSE2 )
+#define MORPHOLOGY_BAND 16
+
+namespace
+{
+
+struct MinOp
+{
+    static uchar neutral() { return 255; }
+    static uchar apply( uchar a, uchar b ) { return a < b ? a : b; }
+#ifdef MORPHOLOGY_SSE2
+    static __m128i apply( __m128i a, __m128i b ) { return _mm_min_epu8( a, b ); }
+#endif
+};
+
+struct MaxOp
+{
+    static uchar neutral() { return 0; }
+    static uchar apply( uchar a, uchar b ) { return a > b ? a : b; }
+#ifdef MORPHOLOGY_SSE2
+    static __m128i apply( __m128i a, __m128i b ) { return _mm_max_epu8( a, b ); }
+#endif
+};
+
+int roundUp( int n, int multiple )
+{
+    return ( ( n + multiple - 1 ) / multiple ) * multiple;
+}
+
+// out[ x ] = op( a[ x ], b[ x ] ). out puede ser a o b.
+template< class Op >
+inline void combine( const uchar *a, const uchar *b, uchar *out, int w )
+{
+    int x = 0;
+#ifdef MORPHOLOGY_SSE2
+    for( ; x + 16 <= w; x += 16 )
+    {
+        __m128i va = _mm_loadu_si128( ( const __m128i * )( a + x ) );
+        __m128i vb = _mm_loadu_si128( ( const __m128i * )( b + x ) );
+        _mm_storeu_si128( ( __m128i * )( out + x ), Op::apply( va, vb ) );
+    }
+#endif
+    for( ; x < w; x++ ) out[ x ] = Op::apply( a[ x ], b[ x ] );
+}
+
+// Transpone un bloque de 16x16 bytes
+void transpose16( const uchar *src, int srcStep, uchar *dst, int dstStep )
+{
+#ifdef MORPHOLOGY_SSE2
+    __m128i r[ 16 ], t[ 16 ];
+    for( int i = 0; i < 16; i++ ) r[ i ] = _mm_loadu_si128( ( const __m128i * )( src + i * srcStep ) );
+
+    for( int i = 0; i < 8; i++ )
+    {
+        t[ i ] = _mm_unpacklo_epi8( r[ 2 * i ], r[ 2 * i + 1 ] );
+        t[ i + 8 ] = _mm_unpackhi_epi8( r[ 2 * i ], r[ 2 * i + 1 ] );
+    }
+    for( int i = 0; i < 8; i++ )
+    {
+        r[ i ] = _mm_unpacklo_epi16( t[ 2 * i ], t[ 2 * i + 1 ] );
+        r[ i + 8 ] = _mm_unpackhi_epi16( t[ 2 * i ], t[ 2 * i + 1 ] );
+    }
+    for( int i = 0; i < 8; i++ )
+    {
+        t[ i ] = _mm_unpacklo_epi32( r[ 2 * i ], r[ 2 * i + 1 ] );
+        t[ i + 8 ] = _mm_unpackhi_epi32( r[ 2 * i ], r[ 2 * i + 1 ] );
+    }
+    for( int i = 0; i < 8; i++ )
+    {
+        r[ i ] = _mm_unpacklo_epi64( t[ 2 * i ], t[ 2 * i + 1 ] );
+        r[ i + 8 ] = _mm_unpackhi_epi64( t[ 2 * i ], t[ 2 * i + 1 ] );
+    }
+
+    // Despues de las 4 rondas la fila j de la salida quedo en r[ j ] con los indices en orden de bits invertido
+    static const int order[ 16 ] = { 0, 8, 4, 12, 2, 10, 6, 14, 1, 9, 5, 13, 3, 11, 7, 15 };
+    for( int j = 0; j < 16; j++ ) _mm_storeu_si128( ( __m128i * )( dst + j * dstStep ), r[ order[ j ] ] );
+#else
+    for( int i = 0; i < 16; i++ )
+        for( int j = 0; j < 16; j++ )
+            dst[ j * dstStep + i ] = src[ i * srcStep + j ];
+#endif
+}
+
+/**
+ * van Herk sobre una secuencia e de length elementos ( length multiplo de k = 2 * radius + 1 ) donde cada
+ * elemento es una fila de w bytes separadas por step. g acumula hacia adelante y h hacia atras dentro de
+ * cada bloque de k, y la ventana [ i, i + k ) de e es op( h[ i ], g[ i + k - 1 ] ).
+ */
+template< class Op >
+void vanHerk( const uchar * const *e, uchar *g, uchar *h, int length, int k, int w, int step )
+{
+    for( int block = 0; block < length; block += k )
+    {
+        memcpy( g + block * step, e[ block ], w );
+        for( int i = block + 1; i < block + k; i++ )
+            combine< Op >( g + ( i - 1 ) * step, e[ i ], g + i * step, w );
+
+        memcpy( h + ( block + k - 1 ) * step, e[ block + k - 1 ], w );
+        for( int i = block + k - 2; i >= block; i-- )
+            combine< Op >( h + ( i + 1 ) * step, e[ i ], h + i * step, w );
+    }
+}
+
+/**
+ * Pasada horizontal. Se toman bandas de 16 filas ( extendidas con radius valores neutros de cada lado ) y se
+ * transponen de a bloques de 16x16, asi cada columna de la banda queda en 16 bytes seguidos y van Herk
+ * avanza de a 16 filas a la vez, igual que la pasada vertical.
+ */
+template< class Op >
+void horizontalPass( const Mat &src, Mat &dst, int radius, std::vector< uchar > &buffer )
+{
+    const int n = src.cols, k = 2 * radius + 1;
+    const int columns = roundUp( n, 16 );
+    const int length = roundUp( columns + 2 * radius, k );
+    const int width = roundUp( length, 16 );
+
+    buffer.resize( 4 * width * MORPHOLOGY_BAND );
+    uchar *band = &buffer[ 0 ];
+    uchar *e = band + width * MORPHOLOGY_BAND;
+    uchar *g = e + width * MORPHOLOGY_BAND;
+    uchar *h = g + width * MORPHOLOGY_BAND;
+
+    // Los elementos de la secuencia son las columnas transpuestas
+    std::vector< const uchar * > sequence( length );
+    for( int i = 0; i < length; i++ ) sequence[ i ] = e + i * MORPHOLOGY_BAND;
+
+    dst.create( src.rows, src.cols, CV_8UC1 );
+
+    for( int y0 = 0; y0 < src.rows; y0 += MORPHOLOGY_BAND )
+    {
+        const int b = std::min( MORPHOLOGY_BAND, src.rows - y0 );
+
+        memset( band, Op::neutral(), width * MORPHOLOGY_BAND );
+        for( int j = 0; j < b; j++ ) memcpy( band + j * width + radius, src.ptr< uchar >( y0 + j ), n );
+
+        for( int c = 0; c < width; c += 16 ) transpose16( band + c, width, e + c * MORPHOLOGY_BAND, MORPHOLOGY_BAND );
+
+        vanHerk< Op >( &sequence[ 0 ], g, h, length, k, MORPHOLOGY_BAND, MORPHOLOGY_BAND );
+
+        // La salida transpuesta va a e, que ya no se usa, y se vuelve a transponer sobre la banda
+        combine< Op >( h, g + 2 * radius * MORPHOLOGY_BAND, e, columns * MORPHOLOGY_BAND );
+
+        for( int c = 0; c < columns; c += 16 ) transpose16( e + c * MORPHOLOGY_BAND, MORPHOLOGY_BAND, band + c, width );
+
+        for( int j = 0; j < b; j++ ) memcpy( dst.ptr< uchar >( y0 + j ), band + j * width, n );
+    }
+}
+
+/**
+ * Pasada vertical: van Herk con filas enteras de una franja de columnas como elementos. Combina el
+ * resultado con la pasada horizontal y lo escribe en dst. Cada franja se lee entera antes de escribirla,
+ * por lo que dst puede ser src.
+ */
+template< class Op >
+void verticalPass( const Mat &src, const Mat &horizontal, Mat &dst, int radius, std::vector< uchar > &buffer )
+{
+    const int n = src.rows, k = 2 * radius + 1, length = roundUp( n + 2 * radius, k );
+
+    buffer.resize( ( 2 * length + 1 ) * MORPHOLOGY_STRIP );
+    uchar *g = &buffer[ 0 ], *h = g + length * MORPHOLOGY_STRIP, *neutralRow = h + length * MORPHOLOGY_STRIP;
+
+    memset( neutralRow, Op::neutral(), MORPHOLOGY_STRIP );
+
+    std::vector< const uchar * > sequence( length );
+
+    dst.create( src.rows, src.cols, CV_8UC1 );
+
+    for( int x0 = 0; x0 < src.cols; x0 += MORPHOLOGY_STRIP )
+    {
+        const int w = std::min( MORPHOLOGY_STRIP, src.cols - x0 );
+
+        for( int i = 0; i < length; i++ )
+        {
+            int y = i - radius;
+            sequence[ i ] = ( y >= 0 && y < n ) ? src.ptr< uchar >( y ) + x0 : neutralRow;
+        }
+
+        vanHerk< Op >( &sequence[ 0 ], g, h, length, k, w, MORPHOLOGY_STRIP );
+
+        for( int y = 0; y < n; y++ )
+        {
+            uchar *out = dst.ptr< uchar >( y ) + x0;
+            combine< Op >( h + y * MORPHOLOGY_STRIP, g + ( y + 2 * radius ) * MORPHOLOGY_STRIP, out, w );
+            combine< Op >( out, horizontal.ptr< uchar >( y ) + x0, out, w );
+        }
+    }
+}
+
+}
+
+void Morphology::erodeCross( const Mat &src, Mat &dst, int radius )
+{
+    CV_Assert( src.type() == CV_8UC1 && radius >= 0 );
+
+    horizontalPass< MinOp >( src, horizontal, radius, rowBuffer );
+    verticalPass< MinOp >( src, horizontal, dst, radius, columnBuffer );
+}
+
+void Morphology::dilateCross( const Mat &src, Mat &dst, int radius )
+{
+    CV_Assert( src.type() == CV_8UC1 && radius >= 0 );
+
+    horizontalPass< MaxOp >( src, horizontal, radius, rowBuffer );
+    verticalPass< MaxOp >( src, horizontal, dst, radius, columnBuffer );
+}
+
+void Morphology::openCross( const Mat &src, Mat &dst, int radius )
+{
+    erodeCross( src, eroded, radius );
+    dilateCross( eroded, dst, radius );
+}
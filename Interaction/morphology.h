@@ -0,0 +1,41 @@
+#ifndef MORPHOLOGY_H
+#define MORPHOLOGY_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/**
+ * Erosion y dilatacion con el elemento MORPH_CROSS de ( 2 * radius + 1 ) x ( 2 * radius + 1 ) para mascaras
+ * CV_8UC1, con el mismo resultado que erode() y dilate() de OpenCV con el borde por defecto.
+ *
+ * La cruz es la union de un segmento horizontal y uno vertical, asi que la erosion es el minimo entre una
+ * pasada horizontal y una vertical ( y la dilatacion el maximo ). Cada pasada usa el algoritmo de van Herk /
+ * Gil-Werman: maximos y minimos acumulados por bloques de 2 * radius + 1, unas 3 comparaciones por pixel
+ * sin importar el radio. La pasada vertical recorre la imagen por franjas de columnas, de a filas enteras
+ * de la franja, para que el compilador la vectorice y los buffers queden en cache.
+ *
+ * Guarda los buffers de trabajo entre llamadas: conviene tener un objeto por hilo y reusarlo.
+ */
+class Morphology
+{
+public:
+
+    void erodeCross( const Mat &src, Mat &dst, int radius );
+    void dilateCross( const Mat &src, Mat &dst, int radius );
+
+    /**
+     * Apertura: erodeCross() y despues dilateCross() con el mismo radio. src y dst pueden ser la misma Mat.
+     */
+    void openCross( const Mat &src, Mat &dst, int radius );
+
+private:
+
+    std::vector< uchar > rowBuffer;
+    std::vector< uchar > columnBuffer;
+    Mat horizontal;
+    Mat eroded;
+};
+
+#endif // MORPHOLOGY_H
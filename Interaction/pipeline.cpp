@@ -0,0 +1,151 @@
+#include "pipeline.h"
+#include "scene.h"
+#include "profiler.h"
+
+CaptureThread::CaptureThread( int device, CaptureRing *frames, QObject *parent ) : QThread( parent ),
+                                                                                   source( new CameraSource( device ) ),
+                                                                                   frames( frames ),
+                                                                                   requestedDevice( device ),
+                                                                                   running( 0 )
+{
+}
+
+CaptureThread::CaptureThread( FrameSource *source, CaptureRing *frames, QObject *parent ) : QThread( parent ),
+                                                                                   source( source ),
+                                                                                   frames( frames ),
+                                                                                   requestedDevice( -1 ),
+                                                                                   running( 0 )
+{
+}
+
+CaptureThread::~CaptureThread()
+{
+    stop();
+    delete source;
+}
+
+Size CaptureThread::frameSize()
+{
+    return source->frameSize();
+}
+
+void CaptureThread::setDevice( int device )
+{
+    requestedDevice.store( device );
+}
+
+void CaptureThread::stop()
+{
+    running.store( 0 );
+    wait();
+}
+
+void CaptureThread::run()
+{
+    running.store( 1 );
+
+    int device = requestedDevice.load();
+    CapturedFrame captured;
+
+    while( running.load() )
+    {
+        if( requestedDevice.load() != device )
+        {
+            device = requestedDevice.load();
+            delete source;
+            source = new CameraSource( device );
+        }
+
+        // Con la camara la lectura bloquea hasta que llega un cuadro, eso marca el ritmo de este hilo
+        PROFILE_START( CAPTURE );
+        bool read = source->read( captured.frame );
+        PROFILE_STOP( CAPTURE );
+
+        if( ! read )
+        {
+            msleep( 10 );
+            continue;
+        }
+
+        // La lectura vuelve cuando llega el cuadro: es la mejor aproximacion al momento de la captura
+        captured.time = FrameSource::now();
+
+        // Si el procesamiento no tomo el cuadro anterior, este lo reemplaza y el anterior se pierde
+        if( ! frames->push( captured ) ) PROFILE_COUNT( DROPPED, 1 );
+    }
+}
+
+ProcessThread::ProcessThread( Scene *scene, CaptureRing *frames, ResultRing *results, QObject *parent ) :
+                                                                                   QThread( parent ),
+                                                                                   scene( scene ),
+                                                                                   frames( frames ),
+                                                                                   results( results ),
+                                                                                   texture( NULL ),
+                                                                                   running( 0 )
+{
+}
+
+ProcessThread::~ProcessThread()
+{
+    stop();
+}
+
+void ProcessThread::stop()
+{
+    running.store( 0 );
+    wait();
+}
+
+void ProcessThread::setTexture( StreamingTexture *texture )
+{
+    this->texture = texture;
+}
+
+void ProcessThread::run()
+{
+    running.store( 1 );
+
+    FrameResult result;
+    CapturedFrame captured;
+
+    // Casillero de la textura pedido pero todavia sin un cuadro que haya llegado al hilo de GL
+    int spareSlot = -1;
+
+    while( running.load() )
+    {
+        // captured.frame ( el buffer anterior de result.frame ) vuelve a la cola de captura y trae el cuadro mas nuevo
+        if( ! frames->pop( captured ) )
+        {
+            usleep( 500 );
+            continue;
+        }
+
+        std::swap( result.frame, captured.frame );
+        result.time = captured.time;
+
+        scene->process( result );
+
+        // Se copia la imagen ya dibujada ( no la de la captura ) y el hilo de GL solo lanza la subida
+        result.pboSlot = -1;
+        if( texture )
+        {
+            if( spareSlot < 0 ) spareSlot = texture->acquireSlot();
+
+            if( spareSlot >= 0 && texture->writeSlot( spareSlot, result.frame ) )
+            {
+                result.pboSlot = spareSlot;
+                spareSlot = -1;
+            }
+        }
+
+        if( ! results->push( result ) )
+        {
+            PROFILE_COUNT( DROPPED, 1 );
+
+            // Reemplazo un resultado que el hilo de GL no llego a mostrar, que vuelve en result: su casillero es de
+            // este hilo y se usa con el proximo cuadro. Si ya habia otro es porque writeSlot() no acepta el tamanio
+            // de los cuadros, y los casilleros no se usan mas
+            if( result.pboSlot >= 0 && spareSlot < 0 ) spareSlot = result.pboSlot;
+        }
+    }
+}
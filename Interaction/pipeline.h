@@ -0,0 +1,150 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <vector>
+#include <QThread>
+#include <QAtomicInt>
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "framering.h"
+#include "framesource.h"
+#include "streamingtexture.h"
+#include "handtracker.h"
+#include "posefilter.h"
+
+using namespace cv;
+using namespace std;
+
+class Scene;
+
+/**
+ * Un cuadro de la camara con el momento en que llego ( FrameSource::now() ).
+ */
+struct CapturedFrame
+{
+    Mat frame;
+    double time;
+
+    CapturedFrame() : time( 0 )
+    {
+    }
+};
+
+inline void swap( CapturedFrame &a, CapturedFrame &b )
+{
+    std::swap( a.frame, b.frame );
+    std::swap( a.time, b.time );
+}
+
+/**
+ * Lo que el hilo de procesamiento le pasa al de dibujo por cada cuadro. El hilo de dibujo no lo modifica: todo lo
+ * que depende de la imagen ( la mano y su pose ) se calcula antes de entrar en la cola, y paintGL solo dibuja.
+ */
+struct FrameResult
+{
+    Mat frame;                  // Imagen de la camara con lo dibujado por HandTracker::process
+    double time;                // Captura de frame
+    HandResult hand;
+    HandPose pose;              // Filtrada, paintGL la extrapola hasta el momento de mostrarla
+    int textureIndex, modelIndex;
+    int pboSlot;                // Casillero de la textura de la camara con frame ya copiado, o -1
+
+    FrameResult() : time( 0 ), textureIndex( 0 ), modelIndex( 0 ), pboSlot( -1 )
+    {
+    }
+};
+
+inline void swap( FrameResult &a, FrameResult &b )
+{
+    std::swap( a.frame, b.frame );
+    std::swap( a.time, b.time );
+    swap( a.hand, b.hand );
+    std::swap( a.pose, b.pose );
+    std::swap( a.textureIndex, b.textureIndex );
+    std::swap( a.modelIndex, b.modelIndex );
+    std::swap( a.pboSlot, b.pboSlot );
+}
+
+typedef TripleBuffer< CapturedFrame > CaptureRing;
+typedef TripleBuffer< FrameResult > ResultRing;
+
+/**
+ * Hilo de captura: lee la camara ( o cualquier FrameSource ) sin parar y deja los cuadros en frames. Si el
+ * procesamiento viene atrasado, cada cuadro reemplaza al que no llego a tomar y ese se descarta.
+ */
+class CaptureThread : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    CaptureThread( int device, CaptureRing *frames, QObject *parent = 0 );
+
+    /**
+     * Lee de source en lugar de una camara. El hilo se queda con source. setDevice() vuelve a la camara.
+     */
+    CaptureThread( FrameSource *source, CaptureRing *frames, QObject *parent = 0 );
+    ~CaptureThread();
+
+    /**
+     * Tamanio de los cuadros del origen. Solo antes de start().
+     */
+    Size frameSize();
+
+    /**
+     * Pide cambiar de camara. El hilo la abre antes de la proxima lectura.
+     */
+    void setDevice( int device );
+
+    void stop();
+
+protected:
+
+    void run();
+
+private:
+
+    FrameSource *source;
+    CaptureRing *frames;
+
+    QAtomicInt requestedDevice;
+    QAtomicInt running;
+};
+
+/**
+ * Hilo de procesamiento: toma el cuadro mas nuevo de frames, lo pasa por Scene::process y deja el resultado
+ * en results, de donde lo toma el hilo de GL en cada refresco ( Scene::slot_updateScene ). Si hay una textura con
+ * mapeo persistente, tambien deja el cuadro ya copiado en uno de sus PBO.
+ */
+class ProcessThread : public QThread
+{
+    Q_OBJECT
+
+public:
+
+    ProcessThread( Scene *scene, CaptureRing *frames, ResultRing *results, QObject *parent = 0 );
+    ~ProcessThread();
+
+    void stop();
+
+    /**
+     * Textura donde copiar cada cuadro procesado. Solo antes de start().
+     */
+    void setTexture( StreamingTexture *texture );
+
+protected:
+
+    void run();
+
+private:
+
+    Scene *scene;
+    CaptureRing *frames;
+    ResultRing *results;
+    StreamingTexture *texture;
+
+    QAtomicInt running;
+};
+
+#endif // PIPELINE_H
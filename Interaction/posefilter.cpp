@@ -0,0 +1,187 @@
+#include "posefilter.h"
+
+#include <cmath>
+#include <algorithm>
+#include <aruco/planarposesolver.h>
+
+using aruco::PlanarPoseSolver;
+
+// a * b^T de dos rotaciones por filas
+static void multiplyTransposed( const double a[ 9 ], const double b[ 9 ], double c[ 9 ] )
+{
+    for( int i = 0; i < 3; i++ )
+        for( int j = 0; j < 3; j++ )
+            c[ i * 3 + j ] = a[ i * 3 ] * b[ j * 3 ] + a[ i * 3 + 1 ] * b[ j * 3 + 1 ] + a[ i * 3 + 2 ] * b[ j * 3 + 2 ];
+}
+
+// R = exp( w ) * R
+static void rotate( const double w[ 3 ], double R[ 9 ] )
+{
+    double E[ 9 ], result[ 9 ];
+    PlanarPoseSolver::rodriguesToMatrix( w, E );
+
+    for( int i = 0; i < 3; i++ )
+        for( int j = 0; j < 3; j++ )
+            result[ i * 3 + j ] = E[ i * 3 ] * R[ j ] + E[ i * 3 + 1 ] * R[ 3 + j ] + E[ i * 3 + 2 ] * R[ 6 + j ];
+
+    std::copy( result, result + 9, R );
+}
+
+// Vector de rotacion que lleva from a to: to = exp( w ) * from
+static void difference( const double to[ 9 ], const double from[ 9 ], double w[ 3 ] )
+{
+    double D[ 9 ];
+    multiplyTransposed( to, from, D );
+    PlanarPoseSolver::matrixToRodrigues( D, w );
+}
+
+static double norm( const double v[ 3 ] )
+{
+    return sqrt( v[ 0 ] * v[ 0 ] + v[ 1 ] * v[ 1 ] + v[ 2 ] * v[ 2 ] );
+}
+
+void HandPose::predict( double displayTime, double R[ 9 ], double t[ 3 ] ) const
+{
+    double lead = std::min( std::max( displayTime - time, 0.0 ), maximumLead );
+
+    std::copy( rotation, rotation + 9, R );
+
+    if( lead > 0 )
+    {
+        double w[ 3 ] = { angularVelocity[ 0 ] * lead, angularVelocity[ 1 ] * lead, angularVelocity[ 2 ] * lead };
+        rotate( w, R );
+    }
+    for( int i = 0; i < 3; i++ ) t[ i ] = translation[ i ] + velocity[ i ] * lead;
+}
+
+void HandPose::modelView( double displayTime, double modelview[ 16 ] ) const
+{
+    double R[ 9 ], t[ 3 ];
+    predict( displayTime, R, t );
+
+    // La fila de z va negada: OpenGL mira hacia -z
+    for( int i = 0; i < 3; i++ )
+    {
+        double sign = i == 2 ? -1 : 1;
+        for( int j = 0; j < 3; j++ ) modelview[ i + j * 4 ] = sign * R[ i * 3 + j ];
+        modelview[ i + 3 * 4 ] = sign * t[ i ];
+    }
+    modelview[ 3 + 0 * 4 ] = 0;
+    modelview[ 3 + 1 * 4 ] = 0;
+    modelview[ 3 + 2 * 4 ] = 0;
+    modelview[ 3 + 3 * 4 ] = 1;
+}
+
+PoseFilter::PoseFilter() : translationCutoff( 1 ), translationBeta( 60 ),
+                           rotationCutoff( 0.5 ), rotationBeta( 4 ),
+                           derivativeCutoff( 1 ),
+                           maximumLead( 0 ), speedThreshold( 0.1 ), angularSpeedThreshold( 1 ),
+                           resetInterval( 0.5 ),
+                           enabled( true ),
+                           initialized( false ),
+                           lastTime( 0 )
+{
+}
+
+void PoseFilter::setTranslationParameters( double minimumCutoff, double beta )
+{
+    translationCutoff = minimumCutoff;
+    translationBeta = beta;
+}
+
+void PoseFilter::setRotationParameters( double minimumCutoff, double beta )
+{
+    rotationCutoff = minimumCutoff;
+    rotationBeta = beta;
+}
+
+void PoseFilter::setDerivativeCutoff( double cutoff )
+{
+    derivativeCutoff = cutoff;
+}
+
+void PoseFilter::setEnabled( bool enabled )
+{
+    if( enabled != this->enabled ) reset();
+    this->enabled = enabled;
+}
+
+void PoseFilter::setPrediction( double maximumLead, double speedThreshold, double angularSpeedThreshold )
+{
+    this->maximumLead = std::max( 0.0, maximumLead );
+    this->speedThreshold = speedThreshold;
+    this->angularSpeedThreshold = angularSpeedThreshold;
+}
+
+void PoseFilter::reset()
+{
+    initialized = false;
+}
+
+// Peso de la medida nueva en un pasabajos de primer orden con frecuencia de corte cutoff, para un paso dt
+double PoseFilter::smoothing( double dt, double cutoff )
+{
+    double tau = 1 / ( 2 * CV_PI * cutoff );
+    return 1 / ( 1 + tau / dt );
+}
+
+void PoseFilter::predictionVelocity( const double v[ 3 ], double threshold, double result[ 3 ] )
+{
+    double speed2 = v[ 0 ] * v[ 0 ] + v[ 1 ] * v[ 1 ] + v[ 2 ] * v[ 2 ];
+    double gain = speed2 > 0 ? speed2 / ( speed2 + threshold * threshold ) : 0;
+
+    for( int i = 0; i < 3; i++ ) result[ i ] = gain * v[ i ];
+}
+
+void PoseFilter::update( const Mat &rvec, const Mat &tvec, double time, HandPose &pose )
+{
+    double r[ 3 ], measuredRotation[ 9 ], measuredTranslation[ 3 ];
+    for( int i = 0; i < 3; i++ )
+    {
+        r[ i ] = rvec.at< float >( i );
+        measuredTranslation[ i ] = tvec.at< float >( i );
+    }
+    PlanarPoseSolver::rodriguesToMatrix( r, measuredRotation );
+
+    double dt = time - lastTime;
+
+    if( ! enabled || ! initialized || dt <= 0 || dt > resetInterval )
+    {
+        std::copy( measuredRotation, measuredRotation + 9, rotation );
+        std::copy( measuredTranslation, measuredTranslation + 3, translation );
+        std::fill( angularVelocity, angularVelocity + 3, 0.0 );
+        std::fill( velocity, velocity + 3, 0.0 );
+    }
+    else
+    {
+        // Las velocidades salen de la pose filtrada anterior y no de la medida anterior: en reposo las dos dan
+        // lo mismo, y asi no hace falta guardar la medida
+        double a = smoothing( dt, derivativeCutoff );
+
+        double w[ 3 ];
+        difference( measuredRotation, rotation, w );
+        for( int i = 0; i < 3; i++ )
+        {
+            angularVelocity[ i ] += a * ( w[ i ] / dt - angularVelocity[ i ] );
+            velocity[ i ] += a * ( ( measuredTranslation[ i ] - translation[ i ] ) / dt - velocity[ i ] );
+        }
+
+        double b = smoothing( dt, rotationCutoff + rotationBeta * norm( angularVelocity ) );
+        for( int i = 0; i < 3; i++ ) w[ i ] *= b;
+        rotate( w, rotation );
+
+        b = smoothing( dt, translationCutoff + translationBeta * norm( velocity ) );
+        for( int i = 0; i < 3; i++ ) translation[ i ] += b * ( measuredTranslation[ i ] - translation[ i ] );
+    }
+
+    initialized = enabled;
+    lastTime = time;
+
+    pose.valid = true;
+    pose.time = time;
+    std::copy( rotation, rotation + 9, pose.rotation );
+    std::copy( translation, translation + 3, pose.translation );
+    predictionVelocity( angularVelocity, angularSpeedThreshold, pose.angularVelocity );
+    predictionVelocity( velocity, speedThreshold, pose.velocity );
+    pose.maximumLead = enabled ? maximumLead : 0;
+}
@@ -0,0 +1,116 @@
+#ifndef POSEFILTER_H
+#define POSEFILTER_H
+
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/**
+ * Pose de la mano de un cuadro ya filtrada, con su velocidad para extrapolarla hasta el momento en que se muestra.
+ */
+struct HandPose
+{
+    bool valid;                     // false si en el cuadro no hubo mano abierta o todavia no hay modelo
+    double time;                    // Captura del cuadro, en segundos de FrameSource::now()
+    double rotation[ 9 ];           // Por filas, como la de Marker::Rvec
+    double translation[ 3 ];
+    double angularVelocity[ 3 ];    // rad/s, vector de rotacion en el sistema de la camara
+    double velocity[ 3 ];           // m/s
+    double maximumLead;             // Hasta cuanto despues de time se extrapola, 0 si no hay prediccion
+
+    HandPose() : valid( false ), time( 0 ), maximumLead( 0 )
+    {
+    }
+
+    /**
+     * Pose en el momento displayTime: se mueve con las velocidades desde time hasta displayTime, sin pasar de
+     * maximumLead.
+     */
+    void predict( double displayTime, double rotation[ 9 ], double translation[ 3 ] ) const;
+
+    /**
+     * Lo mismo como matriz de OpenGL ( como Marker::glGetModelViewMatrix ).
+     */
+    void modelView( double displayTime, double modelview[ 16 ] ) const;
+};
+
+/**
+ * Filtro One Euro ( Casiez, Roussel y Vogel, CHI 2012 ) de la pose de la mano.
+ *
+ * Es un pasabajos de primer orden cuya frecuencia de corte crece con la velocidad: minimumCutoff + beta * |v|.
+ * Con la mano quieta corta abajo y saca el temblor de los puntos de los valles; con la mano en movimiento corta
+ * arriba y casi no agrega retardo. La velocidad se estima con las diferencias entre cuadros, pasadas por otro
+ * pasabajos fijo ( derivativeCutoff ).
+ *
+ * La traslacion se filtra como un vector. La rotacion se filtra sobre la esfera de rotaciones: en cada cuadro se
+ * toma la rotacion que lleva la filtrada a la medida ( un vector de Rodrigues chico ) y se avanza una fraccion de
+ * ella, asi no hay saltos al pasar por angulos de 180 grados.
+ *
+ * Las velocidades filtradas quedan en HandPose para predecir la pose al momento de mostrarla
+ * ( setPrediction() ), y asi esconder el retardo de la captura y el procesamiento.
+ *
+ * Los tiempos son los de captura de cada cuadro, no hace falta que lleguen a intervalos regulares. Si pasa mas
+ * de resetInterval entre dos medidas el filtro vuelve a empezar.
+ */
+class PoseFilter
+{
+public:
+
+    PoseFilter();
+
+    /**
+     * Frecuencias de corte en Hz; beta en Hz por m/s para la traslacion y por rad/s para la rotacion. Con
+     * beta = 0 es un pasabajos comun. Por defecto 1 Hz y 60 para la traslacion, 0.5 Hz y 4 para la rotacion, y
+     * 1 Hz para las velocidades.
+     */
+    void setTranslationParameters( double minimumCutoff, double beta );
+    void setRotationParameters( double minimumCutoff, double beta );
+    void setDerivativeCutoff( double cutoff );
+
+    /**
+     * Si es false la pose pasa sin filtrar y sin velocidad. Por defecto true.
+     */
+    void setEnabled( bool enabled );
+
+    /**
+     * Hasta cuantos segundos despues de la captura se puede extrapolar la pose ( HandPose::maximumLead ).
+     * 0 desactiva la prediccion, que es lo que viene por defecto.
+     *
+     * Con la mano quieta la velocidad estimada es puro ruido, y extrapolarla vuelve a meter el temblor que saco
+     * el filtro. Por eso la velocidad que se usa para predecir se multiplica por |v|^2 / ( |v|^2 + umbral^2 ):
+     * casi cero por debajo de speedThreshold ( m/s ) y angularSpeedThreshold ( rad/s ), entera bien por encima.
+     */
+    void setPrediction( double maximumLead, double speedThreshold = 0.1, double angularSpeedThreshold = 1 );
+
+    /**
+     * Agrega la medida de un cuadro ( rvec y tvec CV_32F como los de Marker ) capturado en time y deja en pose
+     * el resultado filtrado.
+     */
+    void update( const Mat &rvec, const Mat &tvec, double time, HandPose &pose );
+
+    /**
+     * Olvida la pose anterior, por ejemplo cuando se pierde la mano.
+     */
+    void reset();
+
+private:
+
+    double translationCutoff, translationBeta;
+    double rotationCutoff, rotationBeta;
+    double derivativeCutoff;
+    double maximumLead, speedThreshold, angularSpeedThreshold;
+    double resetInterval;
+    bool enabled;
+
+    bool initialized;
+    double lastTime;
+    double rotation[ 9 ];
+    double translation[ 3 ];
+    double angularVelocity[ 3 ];
+    double velocity[ 3 ];
+
+    static double smoothing( double dt, double cutoff );
+    static void predictionVelocity( const double v[ 3 ], double threshold, double result[ 3 ] );
+};
+
+#endif // POSEFILTER_H
@@ -0,0 +1,202 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <QFile>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+
+namespace
+{
+
+QElapsedTimer startedTimer()
+{
+    QElapsedTimer timer;
+    timer.start();
+    return timer;
+}
+
+// La inicializacion de un static local es segura entre hilos: el primero que llega lo arranca y los demas esperan
+QElapsedTimer &profilerClock()
+{
+    static QElapsedTimer timer = startedTimer();
+    return timer;
+}
+
+// Percentil q ( 0 a 1 ) de durations ya ordenado, en milisegundos
+double percentile( const std::vector< qint64 > &durations, double q )
+{
+    size_t index = std::min( durations.size() - 1, ( size_t )( q * durations.size() ) );
+    return durations[ index ] / 1e6;
+}
+
+}
+
+Profiler::Profiler() : ringCount( 0 ),
+                       lastAggregate( -1 ),
+                       output( "../Files/profile" )
+{
+    for( int i = 0; i < MAX_THREADS; i++ ) rings[ i ] = NULL;
+
+    profilerClock();
+}
+
+Profiler &Profiler::instance()
+{
+    static Profiler profiler;
+    return profiler;
+}
+
+qint64 Profiler::now()
+{
+    return profilerClock().nsecsElapsed();
+}
+
+const char *Profiler::stageName( int stage )
+{
+    static const char *names[ STAGES ] = { "capture", "segmentation", "morphology", "hull", "contours", "defects",
+                                           "process", "pose", "upload", "paint" };
+    return names[ stage ];
+}
+
+const char *Profiler::counterName( int counter )
+{
+    static const char *names[ COUNTERS ] = { "shown", "dropped", "duplicated", "late" };
+    return names[ counter ];
+}
+
+Profiler::SampleRing *Profiler::localRing()
+{
+    if( ringIndex.hasLocalData() ) return rings[ ringIndex.localData() ];
+
+    QMutexLocker locker( &registerMutex );
+
+    int index = ringCount.load();
+    if( index >= MAX_THREADS ) return NULL;
+
+    rings[ index ] = new SampleRing;
+    ringCount.storeRelease( index + 1 );
+    ringIndex.setLocalData( index );
+
+    return rings[ index ];
+}
+
+void Profiler::record( Stage stage, qint64 start )
+{
+    SampleRing *ring = instance().localRing();
+    if( ! ring ) return;
+
+    Sample sample;
+    sample.stage = stage;
+    sample.duration = now() - start;
+
+    // Si el hilo de la interfaz no llega a juntar las muestras, las nuevas se pierden
+    ring->push( sample );
+}
+
+void Profiler::count( Counter counter, int n )
+{
+    instance().counters[ counter ].fetchAndAddRelaxed( n );
+}
+
+bool Profiler::aggregate( int intervalMs )
+{
+    qint64 current = now();
+
+    if( lastAggregate < 0 )
+    {
+        lastAggregate = current;
+        return false;
+    }
+
+    double seconds = ( current - lastAggregate ) / 1e9;
+    if( seconds * 1000 < intervalMs ) return false;
+
+    lastAggregate = current;
+
+    std::vector< qint64 > durations[ STAGES ];
+
+    int count = ringCount.loadAcquire();
+    for( int i = 0; i < count; i++ )
+    {
+        Sample sample;
+        while( rings[ i ]->pop( sample ) ) durations[ sample.stage ].push_back( sample.duration );
+    }
+
+    QFile csv( output + ".csv" );
+    bool header = ! csv.exists();
+    csv.open( QIODevice::Append | QIODevice::Text );
+    QTextStream csvStream( &csv );
+    if( header ) csvStream << "time,stage,count,fps,p50_ms,p95_ms,p99_ms\n";
+
+    QFile json( output + ".json" );
+    json.open( QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text );
+    QTextStream jsonStream( &json );
+    jsonStream << "{\n  \"time\": " << current / 1e9 << ",\n  \"stages\": {";
+
+    lines.clear();
+    bool first = true;
+
+    for( int stage = 0; stage < STAGES; stage++ )
+    {
+        std::vector< qint64 > &stageDurations = durations[ stage ];
+        if( stageDurations.empty() ) continue;
+
+        std::sort( stageDurations.begin(), stageDurations.end() );
+
+        double fps = stageDurations.size() / seconds;
+        double p50 = percentile( stageDurations, 0.50 );
+        double p95 = percentile( stageDurations, 0.95 );
+        double p99 = percentile( stageDurations, 0.99 );
+
+        csvStream << current / 1e9 << "," << stageName( stage ) << "," << stageDurations.size() << ","
+                  << fps << "," << p50 << "," << p95 << "," << p99 << "\n";
+
+        jsonStream << ( first ? "\n" : ",\n" ) << "    \"" << stageName( stage ) << "\": { \"count\": "
+                   << stageDurations.size() << ", \"fps\": " << fps << ", \"p50_ms\": " << p50
+                   << ", \"p95_ms\": " << p95 << ", \"p99_ms\": " << p99 << " }";
+        first = false;
+
+        lines << QString( "%1 %2 fps  p50 %3  p95 %4  p99 %5 ms" ).arg( stageName( stage ), -12 )
+                                                                   .arg( fps, 5, 'f', 1 )
+                                                                   .arg( p50, 6, 'f', 2 )
+                                                                   .arg( p95, 6, 'f', 2 )
+                                                                   .arg( p99, 6, 'f', 2 );
+    }
+
+    // Los contadores van en las mismas columnas, con la cantidad por segundo en fps y sin percentiles
+    jsonStream << "\n  },\n  \"counters\": {";
+
+    QString counterLine = "frames";
+
+    for( int counter = 0; counter < COUNTERS; counter++ )
+    {
+        int n = counters[ counter ].fetchAndStoreRelaxed( 0 );
+        double rate = n / seconds;
+
+        csvStream << current / 1e9 << "," << counterName( counter ) << "," << n << "," << rate << ",,,\n";
+
+        jsonStream << ( counter ? ",\n" : "\n" ) << "    \"" << counterName( counter ) << "\": { \"count\": " << n
+                   << ", \"per_second\": " << rate << " }";
+
+        counterLine += QString( "  %1 %2/s" ).arg( counterName( counter ) ).arg( rate, 0, 'f', 1 );
+    }
+
+    jsonStream << "\n  }\n}\n";
+
+    lines << counterLine;
+
+    return true;
+}
+
+QStringList Profiler::summary() const
+{
+    return lines;
+}
+
+void Profiler::setOutput( const QString &path )
+{
+    output = path;
+}
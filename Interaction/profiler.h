@@ -0,0 +1,142 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QString>
+#include <QStringList>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QThreadStorage>
+
+#include "framering.h"
+
+/**
+ * Medicion de tiempos por etapa.
+ *
+ * Cada hilo guarda sus muestras en su propia cola sin locks y el hilo de la interfaz las junta cada tanto
+ * ( aggregate() ), calcula p50, p95, p99 y cuadros por segundo de cada etapa y los escribe en un CSV ( una fila
+ * por etapa y periodo ) y en un JSON ( el ultimo periodo ). summary() da las mismas cifras para mostrar en
+ * pantalla.
+ *
+ * Ademas hay contadores de cuadros ( count() ): los mostrados, los que se perdieron en alguna cola, los
+ * refrescos de la pantalla sin cuadro nuevo y los que llegaron tarde. Se escriben junto con las etapas, como
+ * cantidad y cantidad por segundo en el periodo.
+ *
+ * Solo se compila con ENABLE_PROFILER ( qmake CONFIG+=profiler ). Sin eso las macros de abajo no generan
+ * codigo.
+ */
+class Profiler
+{
+public:
+
+    enum Stage { CAPTURE, SEGMENTATION, MORPHOLOGY, HULL, CONTOURS, DEFECTS, PROCESS, POSE, UPLOAD, PAINT, STAGES };
+
+    enum Counter { SHOWN, DROPPED, DUPLICATED, LATE, COUNTERS };
+
+    static Profiler &instance();
+
+    // Nanosegundos desde que arranco el programa
+    static qint64 now();
+
+    /**
+     * Guarda la duracion de stage desde start hasta ahora. Desde cualquier hilo.
+     */
+    static void record( Stage stage, qint64 start );
+
+    /**
+     * Suma n a counter. Desde cualquier hilo.
+     */
+    static void count( Counter counter, int n = 1 );
+
+    /**
+     * Desde un solo hilo. Si pasaron al menos intervalMs desde la ultima vez, junta las muestras de todos los
+     * hilos, actualiza summary() y escribe los archivos. Devuelve true si lo hizo.
+     */
+    bool aggregate( int intervalMs = 1000 );
+
+    QStringList summary() const;
+
+    /**
+     * Archivos de salida sin la extension: se escriben path.csv y path.json.
+     */
+    void setOutput( const QString &path );
+
+private:
+
+    enum { MAX_THREADS = 16, RING_SIZE = 4096 };
+
+    struct Sample
+    {
+        int stage;
+        qint64 duration;
+    };
+
+    typedef FrameRing< Sample, RING_SIZE > SampleRing;
+
+    QAtomicInt counters[ COUNTERS ];
+
+    // Cada hilo registra su cola la primera vez que mide algo
+    SampleRing *rings[ MAX_THREADS ];
+    QAtomicInt ringCount;
+    QMutex registerMutex;
+    QThreadStorage< int > ringIndex;
+
+    qint64 lastAggregate;
+    QStringList lines;
+    QString output;
+
+    Profiler();
+    SampleRing *localRing();
+
+    static const char *stageName( int stage );
+    static const char *counterName( int counter );
+};
+
+/**
+ * Mide desde la construccion hasta el final del bloque.
+ */
+class ProfilerScope
+{
+public:
+
+    ProfilerScope( Profiler::Stage stage ) : stage( stage ), start( Profiler::now() )
+    {
+    }
+
+    ~ProfilerScope()
+    {
+        Profiler::record( stage, start );
+    }
+
+private:
+
+    Profiler::Stage stage;
+    qint64 start;
+};
+
+#ifdef ENABLE_PROFILER
+
+#define PROFILE_CONCAT_( a, b ) a##b
+#define PROFILE_CONCAT( a, b ) PROFILE_CONCAT_( a, b )
+
+// Todo el bloque actual
+#define PROFILE_SCOPE( stage ) ProfilerScope PROFILE_CONCAT( profilerScope, __LINE__ )( Profiler::stage )
+
+// Un tramo dentro de una funcion
+#define PROFILE_START( stage ) qint64 profilerStart##stage = Profiler::now()
+#define PROFILE_STOP( stage ) Profiler::record( Profiler::stage, profilerStart##stage )
+
+#define PROFILE_AGGREGATE() Profiler::instance().aggregate()
+
+#define PROFILE_COUNT( counter, n ) Profiler::count( Profiler::counter, n )
+
+#else
+
+#define PROFILE_SCOPE( stage )
+#define PROFILE_START( stage )
+#define PROFILE_STOP( stage )
+#define PROFILE_AGGREGATE()
+#define PROFILE_COUNT( counter, n )
+
+#endif
+
+#endif // PROFILER_H
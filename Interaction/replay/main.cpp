@@ -0,0 +1,626 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+#include <atomic>
+#include <new>
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/highgui/highgui.hpp>
+
+#include "handtracker.h"
+#include "framesource.h"
+#include "posefilter.h"
+#include "profiler.h"
+
+/**
+ * Corre HandTracker sobre un video, una secuencia de imagenes o la mano sintetica, lo mas rapido posible y
+ * sin ventana, y escribe por cuadro los dedos, los puntos relevantes y la pose de la mano. Sirve para
+ * comparar dos versiones del procesamiento con la misma entrada y para medir cuadros por segundo.
+ *
+ *   replay <origen> [--range min max] [--level n] [--camera archivo.yml] [--output archivo] [--frames n]
+ *                   [--no-draw] [--save carpeta] [--markers lado] [--filter] [--predict ms] [--fps n]
+ *                   [--hull-check] [--compare-level] [--track] [--check-allocations]
+ *
+ * <origen> es lo mismo que acepta FrameSource::open(). El modelo de la mano se toma del primer cuadro con la
+ * mano abierta ( 4 valles ), como la tecla C en la aplicacion.
+ *
+ * Con --filter la pose pasa ademas por PoseFilter y se escribe la filtrada al lado de la medida; con --predict
+ * la filtrada se extrapola ms milisegundos despues de la captura, como la muestra Scene. Los cuadros se toman
+ * capturados a --fps cuadros por segundo ( 30 por defecto ). Al final se compara el temblor de las dos poses
+ * y el retardo de la filtrada respecto de la medida.
+ *
+ * Con --hull-check se compara en cada cuadro el cierre convexo de todos los pixeles de la mascara de la mano
+ * ( como se calculaba antes ) con el de HandTracker::rowExtents(), que tiene que ser identico, y se mide cuanto
+ * tarda cada uno. Termina con error si algun cuadro da distinto.
+ *
+ * Con --compare-level se corre ademas un segundo HandTracker en nivel 0 sobre una copia de cada cuadro, como
+ * referencia del nivel de --level: al final se da en cuantos cuadros coincide la cantidad de dedos, la
+ * distancia de cada punto relevante de la referencia al mas cercano del nivel reducido y el tiempo de cada uno.
+ *
+ * Con --markers se corre MarkerDetector::detect en lugar de HandTracker, con marcadores de lado metros, y por
+ * cuadro se escriben los ids y la traslacion de cada marcador. Con --track ademas, los marcadores se siguen con
+ * MarkerTracker::track y al final se da en cuantos cuadros tuvo que volver a la deteccion completa y el tiempo
+ * de los cuadros seguidos y de los completos por separado.
+ *
+ * Ademas de los tiempos se cuentan las llamadas a new y a malloc durante el procesamiento de cada cuadro. Las de
+ * malloc incluyen las de new y las imagenes de OpenCV, que fastMalloc pide con malloc; se cuentan reemplazando el
+ * malloc de glibc ( memalign y posix_memalign no se cuentan ).
+ *
+ * Con --check-allocations ademas ( solo con --markers, sin --track ), detect() se llama sin pose, y pasados los
+ * primeros WARM_UP_FRAMES cuadros, en los que crecen los buffers, no puede llamar a new en ningun cuadro. Despues
+ * cada cuadro se vuelve a pasar por detect(), y esa segunda llamada tampoco puede llamar a new. Si alguna llama,
+ * se da el cuadro y termina con error. Los malloc de las dos se dan aparte: quedan los de adentro de OpenCV
+ * ( cvFindContours() y approxPolyDP() con contornos largos ). La pose se calcula despues con calculateExtrinsics()
+ * y sus new y malloc ( solvePnP de OpenCV ) tambien se dan aparte; los tiempos de este modo no la incluyen.
+ */
+
+static std::atomic< long > allocations( 0 ), mallocs( 0 );
+
+// Cuadros en los que todavia crecen los buffers de la deteccion, para --check-allocations
+static const int WARM_UP_FRAMES = 30;
+
+// Las de glibc, que hacen el trabajo de las que siguen
+extern "C" void *__libc_malloc( size_t size );
+extern "C" void *__libc_calloc( size_t count, size_t size );
+extern "C" void *__libc_realloc( void *p, size_t size );
+
+extern "C" void *malloc( size_t size )
+{
+    mallocs++;
+    return __libc_malloc( size );
+}
+
+extern "C" void *calloc( size_t count, size_t size )
+{
+    mallocs++;
+    return __libc_calloc( count, size );
+}
+
+extern "C" void *realloc( void *p, size_t size )
+{
+    mallocs++;
+    return __libc_realloc( p, size );
+}
+
+void *operator new( size_t size )
+{
+    allocations++;
+    if( void *p = malloc( size ? size : 1 ) ) return p;
+    throw std::bad_alloc();
+}
+
+void operator delete( void *p ) noexcept
+{
+    free( p );
+}
+
+static void usage()
+{
+    fprintf( stderr, "uso: replay <origen> [--range min max] [--level n] [--camera archivo.yml]\n"
+                     "              [--output archivo] [--frames n] [--no-draw] [--save carpeta] [--markers lado]\n"
+                     "              [--filter] [--predict ms] [--fps n] [--hull-check] [--compare-level] [--track]\n"
+                     "              [--check-allocations]\n"
+                     "origen: camera:N, synthetic[:WxH], patron%%04d.png o un video\n" );
+}
+
+/**
+ * Pose de un cuadro para las estadisticas del final. valid es false si en el cuadro no hubo pose.
+ */
+struct PoseSample
+{
+    bool valid;
+    double rotation[ 9 ];
+    double translation[ 3 ];
+};
+
+// Angulo en grados de la rotacion a * b^T
+static double angleBetween( const double a[ 9 ], const double b[ 9 ] )
+{
+    double trace = 0;
+    for( int i = 0; i < 9; i++ ) trace += a[ i ] * b[ i ];
+    return acos( std::min( 1.0, std::max( -1.0, ( trace - 1 ) / 2 ) ) ) * 180 / CV_PI;
+}
+
+/**
+ * Temblor: valor cuadratico medio de la segunda diferencia entre cuadros seguidos, en milimetros y en grados.
+ * Con la mano quieta o moviendose a velocidad constante es cero, asi que mide sobre todo el ruido de la pose.
+ */
+static void jitter( const vector< PoseSample > &poses, double &translation, double &rotation )
+{
+    double sumTranslation = 0, sumRotation = 0;
+    int count = 0;
+
+    for( unsigned int k = 1; k + 1 < poses.size(); k++ )
+    {
+        const PoseSample &a = poses[ k - 1 ], &b = poses[ k ], &c = poses[ k + 1 ];
+        if( ! a.valid || ! b.valid || ! c.valid ) continue;
+
+        for( int i = 0; i < 3; i++ )
+        {
+            double d = c.translation[ i ] - 2 * b.translation[ i ] + a.translation[ i ];
+            sumTranslation += d * d;
+        }
+
+        // Cambio entre el giro de a a b y el de b a c
+        double first[ 9 ], second[ 9 ];
+        for( int i = 0; i < 3; i++ )
+            for( int j = 0; j < 3; j++ )
+            {
+                first[ i * 3 + j ] = second[ i * 3 + j ] = 0;
+                for( int m = 0; m < 3; m++ )
+                {
+                    first[ i * 3 + j ] += b.rotation[ i * 3 + m ] * a.rotation[ j * 3 + m ];
+                    second[ i * 3 + j ] += c.rotation[ i * 3 + m ] * b.rotation[ j * 3 + m ];
+                }
+            }
+        double angle = angleBetween( second, first );
+        sumRotation += angle * angle;
+        count++;
+    }
+
+    translation = count ? 1000 * sqrt( sumTranslation / count ) : 0;
+    rotation = count ? sqrt( sumRotation / count ) : 0;
+}
+
+/**
+ * Retardo de shown respecto de reference, en cuadros: el corrimiento que hace coincidir mejor las traslaciones,
+ * con una parabola entre los tres mejores. Negativo si shown se adelanta.
+ */
+static double lag( const vector< PoseSample > &reference, const vector< PoseSample > &shown )
+{
+    const int MAXIMUM_SHIFT = 10;
+    double error[ 2 * MAXIMUM_SHIFT + 1 ];
+    int best = 0;
+
+    for( int shift = -MAXIMUM_SHIFT; shift <= MAXIMUM_SHIFT; shift++ )
+    {
+        double sum = 0;
+        int count = 0;
+        for( int k = std::max( 0, shift ); k < ( int )shown.size() && k - shift < ( int )reference.size(); k++ )
+        {
+            const PoseSample &a = shown[ k ], &b = reference[ k - shift ];
+            if( ! a.valid || ! b.valid ) continue;
+
+            for( int i = 0; i < 3; i++ )
+                sum += ( a.translation[ i ] - b.translation[ i ] ) * ( a.translation[ i ] - b.translation[ i ] );
+            count++;
+        }
+        error[ shift + MAXIMUM_SHIFT ] = count ? sum / count : DBL_MAX;
+        if( error[ shift + MAXIMUM_SHIFT ] < error[ best + MAXIMUM_SHIFT ] ) best = shift;
+    }
+
+    if( best == -MAXIMUM_SHIFT || best == MAXIMUM_SHIFT ) return best;
+
+    double left = error[ best + MAXIMUM_SHIFT - 1 ], center = error[ best + MAXIMUM_SHIFT ];
+    double right = error[ best + MAXIMUM_SHIFT + 1 ];
+    double curvature = left - 2 * center + right;
+    if( left == DBL_MAX || right == DBL_MAX || curvature <= 0 ) return best;
+
+    return best + 0.5 * ( left - right ) / curvature;
+}
+
+// Mediana y maximo de counts, que queda ordenado. Cero si esta vacio
+static void medianAndMaximum( vector< long > &counts, long &median, long &maximum )
+{
+    std::sort( counts.begin(), counts.end() );
+    median = counts.empty() ? 0 : counts[ counts.size() / 2 ];
+    maximum = counts.empty() ? 0 : counts.back();
+}
+
+int main( int argc, char **argv )
+{
+    if( argc < 2 )
+    {
+        usage();
+        return 1;
+    }
+
+    string spec = argv[ 1 ];
+    int minimumA = 0, maximumA = 140;
+    int level = 0;
+    string cameraFile = "../Files/CameraParameters.yml";
+    string outputFile;
+    string saveDirectory;
+    int maximumFrames = -1;
+    bool drawing = true;
+    float markerSize = 0;
+    bool filtering = false;
+    double lead = 0;
+    double fps = 30;
+    bool hullCheck = false;
+    bool compareLevel = false;
+    bool tracking = false;
+    bool allocationCheck = false;
+
+    for( int i = 2; i < argc; i++ )
+    {
+        if( ! strcmp( argv[ i ], "--range" ) && i + 2 < argc )
+        {
+            minimumA = atoi( argv[ ++i ] );
+            maximumA = atoi( argv[ ++i ] );
+        }
+        else if( ! strcmp( argv[ i ], "--level" ) && i + 1 < argc ) level = atoi( argv[ ++i ] );
+        else if( ! strcmp( argv[ i ], "--camera" ) && i + 1 < argc ) cameraFile = argv[ ++i ];
+        else if( ! strcmp( argv[ i ], "--output" ) && i + 1 < argc ) outputFile = argv[ ++i ];
+        else if( ! strcmp( argv[ i ], "--frames" ) && i + 1 < argc ) maximumFrames = atoi( argv[ ++i ] );
+        else if( ! strcmp( argv[ i ], "--save" ) && i + 1 < argc ) saveDirectory = argv[ ++i ];
+        else if( ! strcmp( argv[ i ], "--markers" ) && i + 1 < argc ) markerSize = atof( argv[ ++i ] );
+        else if( ! strcmp( argv[ i ], "--no-draw" ) ) drawing = false;
+        else if( ! strcmp( argv[ i ], "--filter" ) ) filtering = true;
+        else if( ! strcmp( argv[ i ], "--predict" ) && i + 1 < argc )
+        {
+            filtering = true;
+            lead = atof( argv[ ++i ] ) / 1000;
+        }
+        else if( ! strcmp( argv[ i ], "--fps" ) && i + 1 < argc ) fps = atof( argv[ ++i ] );
+        else if( ! strcmp( argv[ i ], "--hull-check" ) ) hullCheck = true;
+        else if( ! strcmp( argv[ i ], "--compare-level" ) ) compareLevel = true;
+        else if( ! strcmp( argv[ i ], "--track" ) ) tracking = true;
+        else if( ! strcmp( argv[ i ], "--check-allocations" ) ) allocationCheck = true;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if( tracking && markerSize <= 0 )
+    {
+        fprintf( stderr, "replay: --track necesita --markers\n" );
+        return 1;
+    }
+
+    if( allocationCheck && ( markerSize <= 0 || tracking ) )
+    {
+        fprintf( stderr, "replay: --check-allocations necesita --markers y no va con --track\n" );
+        return 1;
+    }
+
+    FrameSource *source = FrameSource::open( spec );
+    if( ! source )
+    {
+        fprintf( stderr, "replay: no se pudo abrir %s\n", spec.c_str() );
+        return 1;
+    }
+
+    // Sin calibracion no hay pose, pero el resto se puede comparar igual
+    CameraParameters camera;
+    try
+    {
+        camera.readFromXMLFile( cameraFile );
+        camera.resize( source->frameSize() );
+    }
+    catch( cv::Exception & )
+    {
+        fprintf( stderr, "replay: sin parametros de camara ( %s ), no se calcula la pose\n", cameraFile.c_str() );
+    }
+
+    FILE *output = outputFile.empty() ? stdout : fopen( outputFile.c_str(), "w" );
+    if( ! output )
+    {
+        fprintf( stderr, "replay: no se pudo escribir %s\n", outputFile.c_str() );
+        delete source;
+        return 1;
+    }
+
+    HandTracker handTracker;
+    handTracker.setSkinRange( minimumA, maximumA );
+    handTracker.setPyramidLevel( level );
+    handTracker.setDrawing( drawing || ! saveDirectory.empty() );
+
+    MarkerDetector markerDetector;
+    MarkerTracker markerTracker;
+    vector< Marker > markers;
+    vector< double > trackedTimes, fullTimes;
+    int repeatedAllocating = 0, laterAllocating = 0;
+    vector< long > steadyMallocs, repeatedMallocs, extrinsicsAllocations, extrinsicsMallocs;
+
+    vector< float > model;
+    PlanarPoseSolver poseSolver;
+    PoseFilter poseFilter;
+    poseFilter.setPrediction( lead );
+    vector< PoseSample > measuredPoses, filteredPoses;
+    vector< double > times;
+    vector< long > frameAllocations, frameMallocs;
+
+    int hullMismatches = 0;
+    vector< double > cloudHullTimes, extentsHullTimes;
+    vector< Point > cloud, extents, cloudHull, extentsHull;
+
+    HandTracker referenceTracker;
+    referenceTracker.setSkinRange( minimumA, maximumA );
+    referenceTracker.setDrawing( false );
+    HandResult referenceHand;
+    Mat referenceFrame;
+    vector< double > referenceTimes, relevantErrors;
+    int sameFingers = 0;
+
+    Mat frame;
+    HandResult hand;
+
+    if( markerSize > 0 ) fprintf( output, "# cuadro marcadores id tvec(3) ...\n" );
+    else if( filtering ) fprintf( output, "# cuadro dedos relevantes(x,y ...) pose rvec(3) tvec(3) filtrada rvec(3) tvec(3)\n" );
+    else fprintf( output, "# cuadro dedos relevantes(x,y ...) pose rvec(3) tvec(3)\n" );
+
+    int64 start = getTickCount();
+    int index = 0;
+
+    for( ; maximumFrames < 0 || index < maximumFrames; index++ )
+    {
+        if( ! source->read( frame ) ) break;
+
+        if( compareLevel ) frame.copyTo( referenceFrame );
+
+        long allocationsBefore = allocations.load(), mallocsBefore = mallocs.load();
+        int64 before = getTickCount();
+        if( tracking ) markerTracker.track( frame, markers, camera, markerSize );
+        else if( allocationCheck ) markerDetector.detect( frame, markers, camera.CameraMatrix, camera.Distorsion );
+        else if( markerSize > 0 ) markerDetector.detect( frame, markers, camera, markerSize );
+        else handTracker.process( frame, hand );
+        times.push_back( ( getTickCount() - before ) * 1000.0 / getTickFrequency() );
+        frameAllocations.push_back( allocations.load() - allocationsBefore );
+        frameMallocs.push_back( mallocs.load() - mallocsBefore );
+
+        if( tracking ) ( markerTracker.wasFullDetection() ? fullTimes : trackedTimes ).push_back( times.back() );
+
+        if( allocationCheck )
+        {
+            // Cada cuadro distinto del anterior, con los buffers que dejaron los anteriores
+            if( index >= WARM_UP_FRAMES )
+            {
+                steadyMallocs.push_back( frameMallocs.back() );
+                if( frameAllocations.back() > 0 )
+                {
+                    fprintf( stderr, "replay: cuadro %d: detect() llamo a new %ld veces\n", index,
+                             frameAllocations.back() );
+                    laterAllocating++;
+                }
+            }
+
+            // Se usa el mismo vector de marcadores: con otro, sus elementos pedirian memoria
+            allocationsBefore = allocations.load();
+            mallocsBefore = mallocs.load();
+            markerDetector.detect( frame, markers, camera.CameraMatrix, camera.Distorsion );
+            long repeated = allocations.load() - allocationsBefore;
+            repeatedMallocs.push_back( mallocs.load() - mallocsBefore );
+            if( repeated > 0 )
+            {
+                fprintf( stderr, "replay: cuadro %d: detect() llamo a new %ld veces con el mismo cuadro\n", index,
+                         repeated );
+                repeatedAllocating++;
+            }
+
+            // Deja la pose como la calcula detect() con la camara
+            allocationsBefore = allocations.load();
+            mallocsBefore = mallocs.load();
+            if( camera.isValid() )
+                for( unsigned int i = 0; i < markers.size(); i++ )
+                    markers.at( i ).calculateExtrinsics( markerSize, camera, false );
+            extrinsicsAllocations.push_back( allocations.load() - allocationsBefore );
+            extrinsicsMallocs.push_back( mallocs.load() - mallocsBefore );
+        }
+
+        if( markerSize > 0 )
+        {
+            fprintf( output, "%d %d", index, ( int )markers.size() );
+            for( unsigned int i = 0; i < markers.size(); i++ )
+            {
+                fprintf( output, " %d", markers.at( i ).id );
+                if( camera.isValid() )
+                    fprintf( output, " %.6f %.6f %.6f", markers.at( i ).Tvec.at< float >( 0 ),
+                             markers.at( i ).Tvec.at< float >( 1 ), markers.at( i ).Tvec.at< float >( 2 ) );
+            }
+            fprintf( output, "\n" );
+
+            if( ! saveDirectory.empty() )
+            {
+                for( unsigned int i = 0; i < markers.size(); i++ ) markers.at( i ).draw( frame, Scalar( 0, 0, 255 ), 2 );
+                imwrite( format( "%s/%05d.png", saveDirectory.c_str(), index ), frame );
+            }
+
+            PROFILE_AGGREGATE();
+            continue;
+        }
+
+        if( compareLevel )
+        {
+            int64 before = getTickCount();
+            referenceTracker.process( referenceFrame, referenceHand );
+            referenceTimes.push_back( ( getTickCount() - before ) * 1000.0 / getTickFrequency() );
+
+            if( referenceHand.fingers == hand.fingers ) sameFingers++;
+
+            // Cada relevante de la referencia contra el mas cercano del nivel reducido
+            for( unsigned int i = 0; i < referenceHand.relevants.size() && ! hand.relevants.empty(); i++ )
+            {
+                double nearest = DBL_MAX;
+                for( unsigned int j = 0; j < hand.relevants.size(); j++ )
+                    nearest = std::min( nearest, norm( referenceHand.relevants.at( i ) - hand.relevants.at( j ) ) );
+                relevantErrors.push_back( nearest );
+            }
+        }
+
+        if( hullCheck )
+        {
+            const Mat &mask = handTracker.mask();
+
+            int64 before = getTickCount();
+            cloud.clear();
+            for( int j = 0; j < mask.rows; j++ )
+                for( int i = 0; i < mask.cols; i++ )
+                    if( mask.at< uchar >( j, i ) == 255 ) cloud.push_back( Point( i, j ) );
+            cloudHull.clear();
+            if( ! cloud.empty() ) convexHull( Mat( cloud ), cloudHull, false );
+            cloudHullTimes.push_back( ( getTickCount() - before ) * 1000.0 / getTickFrequency() );
+
+            before = getTickCount();
+            HandTracker::rowExtents( mask, extents );
+            extentsHull.clear();
+            if( ! extents.empty() ) convexHull( Mat( extents ), extentsHull, false );
+            extentsHullTimes.push_back( ( getTickCount() - before ) * 1000.0 / getTickFrequency() );
+
+            if( cloudHull != extentsHull )
+            {
+                fprintf( stderr, "replay: cuadro %d: el cierre convexo de los extremos de fila ( %d vertices ) no "
+                                 "es el de todos los pixeles ( %d vertices )\n", index, ( int )extentsHull.size(),
+                         ( int )cloudHull.size() );
+                hullMismatches++;
+            }
+        }
+
+        if( model.empty() ) model = HandTracker::handModel( hand );
+
+        Marker marker;
+        bool pose = camera.isValid() && HandTracker::estimatePose( hand, model, camera, marker, &poseSolver );
+
+        fprintf( output, "%d %d", index, hand.fingers );
+        for( unsigned int i = 0; i < hand.relevants.size(); i++ )
+            fprintf( output, " %d,%d", hand.relevants.at( i ).x, hand.relevants.at( i ).y );
+
+        PoseSample measured, filtered;
+        measured.valid = pose;
+        filtered.valid = pose && filtering;
+
+        if( pose )
+        {
+            fprintf( output, " pose %.6f %.6f %.6f %.6f %.6f %.6f",
+                     marker.Rvec.at< float >( 0 ), marker.Rvec.at< float >( 1 ), marker.Rvec.at< float >( 2 ),
+                     marker.Tvec.at< float >( 0 ), marker.Tvec.at< float >( 1 ), marker.Tvec.at< float >( 2 ) );
+
+            double rvec[ 3 ];
+            for( int i = 0; i < 3; i++ )
+            {
+                rvec[ i ] = marker.Rvec.at< float >( i );
+                measured.translation[ i ] = marker.Tvec.at< float >( i );
+            }
+            PlanarPoseSolver::rodriguesToMatrix( rvec, measured.rotation );
+        }
+
+        if( pose && filtering )
+        {
+            double time = index / fps;
+            HandPose handPose;
+            poseFilter.update( marker.Rvec, marker.Tvec, time, handPose );
+            handPose.predict( time + lead, filtered.rotation, filtered.translation );
+
+            double rvec[ 3 ];
+            PlanarPoseSolver::matrixToRodrigues( filtered.rotation, rvec );
+            fprintf( output, " filtrada %.6f %.6f %.6f %.6f %.6f %.6f", rvec[ 0 ], rvec[ 1 ], rvec[ 2 ],
+                     filtered.translation[ 0 ], filtered.translation[ 1 ], filtered.translation[ 2 ] );
+        }
+        else if( ! pose ) poseFilter.reset();
+
+        fprintf( output, "\n" );
+
+        measuredPoses.push_back( measured );
+        filteredPoses.push_back( filtered );
+
+        if( ! saveDirectory.empty() )
+            imwrite( format( "%s/%05d.png", saveDirectory.c_str(), index ), frame );
+
+        PROFILE_AGGREGATE();
+    }
+
+    double elapsed = ( getTickCount() - start ) / getTickFrequency();
+
+    if( output != stdout ) fclose( output );
+    delete source;
+
+    if( times.empty() )
+    {
+        fprintf( stderr, "replay: %s no tiene cuadros\n", spec.c_str() );
+        return 1;
+    }
+
+    std::sort( times.begin(), times.end() );
+    double p50 = times[ times.size() / 2 ];
+    double p95 = times[ std::min( times.size() - 1, times.size() * 95 / 100 ) ];
+
+    fprintf( stderr, "replay: %d cuadros en %.2f s, %.1f cuadros/s, procesamiento p50 %.2f ms p95 %.2f ms\n",
+             index, elapsed, index / elapsed, p50, p95 );
+
+    // Los primeros cuadros hacen crecer los buffers, despues deberia pedirse poco o nada
+    long firstAllocations = frameAllocations.front(), firstMallocs = frameMallocs.front();
+    frameAllocations.erase( frameAllocations.begin() );
+    frameMallocs.erase( frameMallocs.begin() );
+    long allocationsMedian, allocationsMaximum, mallocsMedian, mallocsMaximum;
+    medianAndMaximum( frameAllocations, allocationsMedian, allocationsMaximum );
+    medianAndMaximum( frameMallocs, mallocsMedian, mallocsMaximum );
+    fprintf( stderr, "replay: new por cuadro: primer cuadro %ld, despues p50 %ld maximo %ld\n", firstAllocations,
+             allocationsMedian, allocationsMaximum );
+    fprintf( stderr, "replay: malloc por cuadro: primer cuadro %ld, despues p50 %ld maximo %ld\n", firstMallocs,
+             mallocsMedian, mallocsMaximum );
+
+    if( tracking )
+    {
+        std::sort( trackedTimes.begin(), trackedTimes.end() );
+        std::sort( fullTimes.begin(), fullTimes.end() );
+        fprintf( stderr, "replay: seguimiento: deteccion completa en %d de %d cuadros ( %.1f%% ); p50 cuadros "
+                         "seguidos %.2f ms, con deteccion completa %.2f ms\n", ( int )fullTimes.size(), index,
+                 100.0 * fullTimes.size() / index, trackedTimes.empty() ? 0 : trackedTimes[ trackedTimes.size() / 2 ],
+                 fullTimes.empty() ? 0 : fullTimes[ fullTimes.size() / 2 ] );
+    }
+
+    if( allocationCheck )
+    {
+        long median, maximum;
+        medianAndMaximum( steadyMallocs, median, maximum );
+        fprintf( stderr, "replay: detect() en cuadros seguidos despues de los primeros %d: new en %d de %d cuadros, "
+                         "malloc p50 %ld maximo %ld por cuadro\n", WARM_UP_FRAMES, laterAllocating,
+                 ( int )steadyMallocs.size(), median, maximum );
+        medianAndMaximum( repeatedMallocs, median, maximum );
+        fprintf( stderr, "replay: detect() repetido con el mismo cuadro: new en %d de %d cuadros, malloc p50 %ld "
+                         "maximo %ld por cuadro\n", repeatedAllocating, ( int )repeatedMallocs.size(), median,
+                 maximum );
+        long mallocMedian, mallocMaximum;
+        medianAndMaximum( extrinsicsAllocations, median, maximum );
+        medianAndMaximum( extrinsicsMallocs, mallocMedian, mallocMaximum );
+        fprintf( stderr, "replay: la pose: new p50 %ld maximo %ld, malloc p50 %ld maximo %ld por cuadro\n", median,
+                 maximum, mallocMedian, mallocMaximum );
+    }
+
+    if( compareLevel && ! referenceTimes.empty() )
+    {
+        std::sort( referenceTimes.begin(), referenceTimes.end() );
+        std::sort( relevantErrors.begin(), relevantErrors.end() );
+
+        double meanError = 0;
+        for( unsigned int i = 0; i < relevantErrors.size(); i++ ) meanError += relevantErrors[ i ];
+        if( ! relevantErrors.empty() ) meanError /= relevantErrors.size();
+
+        fprintf( stderr, "replay: nivel %d contra nivel 0: dedos iguales en %d de %d cuadros; procesamiento p50 "
+                         "%.2f ms contra %.2f ms\n", level, sameFingers, index, p50,
+                 referenceTimes[ referenceTimes.size() / 2 ] );
+        if( ! relevantErrors.empty() )
+            fprintf( stderr, "replay: distancia de los puntos relevantes al nivel 0: media %.2f px, p95 %.2f px, "
+                             "maximo %.2f px ( %d puntos )\n", meanError,
+                     relevantErrors[ std::min( relevantErrors.size() - 1, relevantErrors.size() * 95 / 100 ) ],
+                     relevantErrors.back(), ( int )relevantErrors.size() );
+    }
+
+    if( hullCheck && ! cloudHullTimes.empty() )
+    {
+        std::sort( cloudHullTimes.begin(), cloudHullTimes.end() );
+        std::sort( extentsHullTimes.begin(), extentsHullTimes.end() );
+        fprintf( stderr, "replay: cierre convexo: %d de %d cuadros distintos; p50 todos los pixeles %.3f ms, "
+                         "extremos de fila %.3f ms\n", hullMismatches, ( int )cloudHullTimes.size(),
+                 cloudHullTimes[ cloudHullTimes.size() / 2 ], extentsHullTimes[ extentsHullTimes.size() / 2 ] );
+    }
+
+    if( filtering )
+    {
+        double translation, rotation;
+        jitter( measuredPoses, translation, rotation );
+        fprintf( stderr, "replay: pose medida: temblor %.3f mm %.3f grados\n", translation, rotation );
+
+        jitter( filteredPoses, translation, rotation );
+        fprintf( stderr, "replay: pose filtrada ( prediccion %.0f ms ): temblor %.3f mm %.3f grados, "
+                         "retardo respecto de la medida %.1f ms\n",
+                 lead * 1000, translation, rotation, lag( measuredPoses, filteredPoses ) * 1000 / fps );
+    }
+
+    return hullMismatches || repeatedAllocating || laterAllocating ? 1 : 0;
+}
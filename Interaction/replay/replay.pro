@@ -0,0 +1,61 @@
+#---------------------------------
+#
+# Replay: el procesamiento de la mano sobre video grabado, sin camara ni ventana
+#
+#---------------------------------
+
+QT = core
+
+TARGET   = replay
+TEMPLATE = app
+CONFIG  += console
+CONFIG  -= app_bundle
+
+CONFIG  += c++11
+
+DEFINES += NO_DEBUG_ARUCO
+
+# Tiempos por etapa en ../Files/profile.csv y profile.json: qmake CONFIG+=profiler
+profiler:DEFINES += ENABLE_PROFILER
+
+INCLUDEPATH += ..
+
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_core.so"         # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_highgui.so"      # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_imgproc.so"      # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_objdetect.so"    # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_calib3d.so"      # OpenCV
+unix:LIBS += "/usr/lib/x86_64-linux-gnu/libopencv_ml.so"           # OpenCV
+
+SOURCES += main.cpp \
+           ../handtracker.cpp \
+           ../framesource.cpp \
+           ../posefilter.cpp \
+           ../skinsegmenter.cpp \
+           ../morphology.cpp \
+           ../profiler.cpp \
+           ../aruco/adaptivethreshold.cpp \
+           ../aruco/ar_omp.cpp \
+           ../aruco/arucofidmarkers.cpp \
+           ../aruco/board.cpp \
+           ../aruco/boarddetector.cpp \
+           ../aruco/cameraparameters.cpp \
+           ../aruco/chromaticmask.cpp \
+           ../aruco/cornerrefiner.cpp \
+           ../aruco/cvdrawingutils.cpp \
+           ../aruco/highlyreliablemarkers.cpp \
+           ../aruco/marker.cpp \
+           ../aruco/markerdetector.cpp \
+           ../aruco/markertracker.cpp \
+           ../aruco/planarposesolver.cpp \
+           ../aruco/subpixelcorner.cpp \
+           ../aruco/threadpool.cpp
+
+HEADERS += ../handtracker.h \
+           ../framesource.h \
+           ../posefilter.h \
+           ../skinsegmenter.h \
+           ../morphology.h \
+           ../roitracker.h \
+           ../framering.h \
+           ../profiler.h
@@ -0,0 +1,73 @@
+#ifndef ROITRACKER_H
+#define ROITRACKER_H
+
+#include <algorithm>
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/**
+ * Ventana de la imagen donde buscar la mano en el proximo cuadro.
+ *
+ * Mientras se siga la mano, la ventana es el rectangulo que encierra los contornos grandes del cuadro
+ * anterior, agrandado con un margen. Si la mano se pierde, o cada fullScanInterval cuadros ( para ver si
+ * aparecio otra mano o si la ventana quedo chica ), se vuelve a procesar la imagen entera.
+ */
+class RoiTracker
+{
+public:
+
+    RoiTracker( int minimumPadding = 40, int fullScanInterval = 30 ) : minimumPadding( minimumPadding ),
+                                                                        fullScanInterval( fullScanInterval ),
+                                                                        tracking( false ),
+                                                                        framesSinceFullScan( 0 )
+    {
+    }
+
+    /**
+     * Ventana a procesar en un cuadro de tamanio frameSize, siempre dentro de la imagen.
+     */
+    Rect next( Size frameSize )
+    {
+        Rect full( 0, 0, frameSize.width, frameSize.height );
+
+        if( ! tracking || ++framesSinceFullScan >= fullScanInterval )
+        {
+            framesSinceFullScan = 0;
+            return full;
+        }
+
+        // El margen crece con la mano para acompaniar movimientos rapidos cuando esta cerca de la camara
+        int padX = std::max( minimumPadding, hand.width / 4 );
+        int padY = std::max( minimumPadding, hand.height / 4 );
+
+        Rect window( hand.x - padX, hand.y - padY, hand.width + 2 * padX, hand.height + 2 * padY );
+        window &= full;
+
+        if( window.area() == 0 ) return full;
+        return window;
+    }
+
+    /**
+     * Rectangulo ( en coordenadas de la imagen ) que encierra los contornos grandes encontrados en la ventana.
+     * Vacio si no se encontro ninguno.
+     */
+    void update( const Rect &handBox )
+    {
+        tracking = handBox.area() > 0;
+        hand = handBox;
+    }
+
+    bool isTracking() const { return tracking; }
+
+private:
+
+    int minimumPadding;
+    int fullScanInterval;
+
+    bool tracking;
+    int framesSinceFullScan;
+    Rect hand;
+};
+
+#endif // ROITRACKER_H
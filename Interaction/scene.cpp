@@ -1,11 +1,29 @@
 #include "scene.h"
 #include <QApplication>
 
-Scene::Scene( QWidget *parent ) : QGLWidget( parent ),
+// Lo mas que se extrapola la pose desde la captura del cuadro, en segundos
+#define MAXIMUM_LEAD 0.1
+
+// Intervalo del timer de dibujo si el driver no sincroniza el swap con la pantalla, en milisegundos
+#define FALLBACK_INTERVAL 16
+
+// El swap de buffers espera el refresco de la pantalla ( vsync )
+static QGLFormat vsyncFormat()
+{
+    QGLFormat format = QGLFormat::defaultFormat();
+    format.setSwapInterval( 1 );
+    return format;
+}
+
+Scene::Scene( QWidget *parent ) : QGLWidget( vsyncFormat(), parent ),
                                   device( 1 ),
-                                  videoCapture ( new cv::VideoCapture( device ) ),
 
-                                  sceneTimer ( new QTimer ),
+                                  captureThread( new CaptureThread( device, &capturedFrames, this ) ),
+                                  processThread( new ProcessThread( this, &capturedFrames, &processedFrames, this ) ),
+
+                                  renderTimer( new QTimer( this ) ),
+                                  lastRefresh( 0 ), refreshInterval( 1 / 60.0 ),
+
                                   videoActive( false ),
 
                                   textures( new QVector< Texture * > ),
@@ -15,64 +33,50 @@ Scene::Scene( QWidget *parent ) : QGLWidget( parent ),
                                   cameraParameters( new CameraParameters ),
 
                                   refSkin( new Skin( this ) ),
+                                  pyramidLevel( 0 ),
+                                  showProfile( false ),
 
                                   textureIndex( 0 ), modelIndex(0),
-                                  lastFingers( 0 ),
+                                  modelRequested( 0 ),
+                                  poseFiltering( POSE_PREDICTED ),
+                                  projectionValid( false ),
 
                                   y(0), z(0), rotacion(0)
 {
-    this->setFixedSize( videoCapture->get( CV_CAP_PROP_FRAME_WIDTH ), videoCapture->get( CV_CAP_PROP_FRAME_HEIGHT ) );
+    Size frameSize = captureThread->frameSize();
+    this->setFixedSize( frameSize.width, frameSize.height );
+    viewportSize = frameSize;
 
     cameraParameters->readFromXMLFile( "../Files/CameraParameters.yml" );
 
-    sceneTimer->start( 10 );
-    connect( sceneTimer, SIGNAL( timeout() ), SLOT( slot_updateScene() ) );
+    // Se dibuja una vez por refresco de la pantalla, haya o no un resultado nuevo ( la pose se extrapola igual )
+    renderTimer->setTimerType( Qt::PreciseTimer );
+    connect( renderTimer, SIGNAL( timeout() ), SLOT( slot_updateScene() ) );
 
+    // Los hilos y el timer arrancan al final de initializeGL(), cuando ya estan cargadas las texturas y los modelos
 }
 
-double Scene::distance( Point a, Point b )
+Scene::~Scene()
 {
-    return ( a.x - b.x ) * ( a.x - b.x ) + ( a.y - b.y ) * ( a.y - b.y );
+    processThread->stop();
+    captureThread->stop();
+
+    // Los modelos liberan sus buffers de la GPU al borrarse, asi que necesitan el contexto
+    makeCurrent();
+    qDeleteAll( *models );
+    delete models;
 }
 
 void Scene::calculateMatrix()
 {
-    matrix.clear();
-
-    switch( relevants.size() )
-    {
-        case 3:
-        {
-            break;
-        }
-        case 6:
-        {
-            break;
-        }
-        case 9:
-        {
-            break;
-        }
-        case 12:
-        {
-            matrix.push_back( relevants.at( 10 ).x - baricenter.x );
-            matrix.push_back( baricenter.y - relevants.at( 10 ).y );
-            matrix.push_back( 0 );
-            matrix.push_back( relevants.at( 9 ).x - baricenter.x );
-            matrix.push_back( baricenter.y - relevants.at( 9 ).y );
-            matrix.push_back( 0 );
-            matrix.push_back( relevants.at( 2 ).x - baricenter.x );
-            matrix.push_back( baricenter.y - relevants.at( 2 ).y );
-            matrix.push_back( 0 );
-            matrix.push_back( relevants.at( 1 ).x - baricenter.x );
-            matrix.push_back( baricenter.y - relevants.at( 1 ).y );
-            matrix.push_back( 0 );
-            break;
-        }
-    }
+    modelRequested.store( 1 );
+}
 
-    for( unsigned int i = 0; i < matrix.size(); i++ )
-        matrix.operator []( i ) /= 5000.0;
+void Scene::updateProjection()
+{
+    cv::Size2i sceneSize( RESOLUTION_WIDTH, RESOLUTION_HEIGHT );
+    cameraParameters->glGetProjectionMatrix( sceneSize, viewportSize, projectionMatrix, 0.05, 10 );
+    projectionValid = true;
 }
 
 void Scene::loadTextures()
@@ -115,53 +119,12 @@ void Scene::prepareModels()
     {
         if( !models->at( i ) ) return;
 
-        models->at( i )->getFaces();
-        Lib3dsVector *vertices = new Lib3dsVector[ models->at( i )->totalFaces * 3 ];
-        Lib3dsVector *normals = new Lib3dsVector[ models->at( i )->totalFaces * 3 ];
-        Lib3dsTexel *texCoords = new Lib3dsTexel[ models->at( i )->totalFaces * 3 ];
-        Lib3dsMesh *mesh;
-
-        unsigned int finishedFaces = 0;
-
-        for( mesh = models->at(i)->model->meshes; mesh != NULL ; mesh = mesh->next )
-        {
-            lib3ds_mesh_calculate_normals( mesh, &normals[ finishedFaces * 3 ] );
-            for( unsigned int currentFace = 0; currentFace < mesh->faces ; currentFace++ )
-            {
-                Lib3dsFace * face = &mesh->faceL[ currentFace ];
-                for( unsigned int i = 0; i < 3; i++ )
-                {
-                    if( &mesh->texelL )
-                        memcpy( &texCoords[ finishedFaces*3 + i ],
-                                mesh->texelL[ face->points[ i ] ],
-                                sizeof( Lib3dsTexel ) );
-
-                    memcpy( &vertices[ finishedFaces * 3 + i ],
-                            mesh->pointL[ face->points[ i ] ].pos,
-                            sizeof( Lib3dsVector ) );
-                }
-                finishedFaces++;
-            }
-        }
-
-        glGenBuffers( 1, &models->at(i)->vertexVBO );
-        glBindBuffer( GL_ARRAY_BUFFER, models->at(i)->vertexVBO );
-        glBufferData( GL_ARRAY_BUFFER, sizeof( Lib3dsVector ) * 3 * models->at(i)->totalFaces, vertices, GL_STATIC_DRAW );
-
-        glGenBuffers( 1, &models->at(i)->normalVBO );
-        glBindBuffer( GL_ARRAY_BUFFER, models->at(i)->normalVBO);
-        glBufferData( GL_ARRAY_BUFFER, sizeof( Lib3dsVector ) * 3 * models->at(i)->totalFaces, normals, GL_STATIC_DRAW );
-
-        glGenBuffers( 1, &models->at(i)->texCoordVBO );
-        glBindBuffer( GL_ARRAY_BUFFER, models->at(i)->texCoordVBO);
-        glBufferData( GL_ARRAY_BUFFER, sizeof( Lib3dsTexel ) * 3 * models->at(i)->totalFaces, texCoords, GL_STATIC_DRAW );
-
-        delete vertices;
-        delete normals;
-        delete texCoords;
+        // Vertices unidos, triangulos en orden para la cache y un solo buffer intercalado por modelo
+        CompiledMesh mesh;
+        if( models->at( i )->compile( mesh ) ) models->at( i )->upload( mesh );
 
-        lib3ds_file_free( models->at(i)->model );
-        models->at(i)->model = NULL;
+        if( models->at( i )->model ) lib3ds_file_free( models->at( i )->model );
+        models->at( i )->model = NULL;
     }
 }
 
@@ -210,7 +173,11 @@ void Scene::initializeGL()
     glLightfv( GL_LIGHT1, GL_AMBIENT, lightAmbient );  glLightfv( GL_LIGHT1, GL_DIFFUSE, lightDiffuse );
     glLightfv( GL_LIGHT1, GL_POSITION,lightPosition ); glEnable( GL_LIGHT1 );
 
-    textures->append( new Texture( "CameraTexture" ) );
+    cameraTexture = new StreamingTexture( "CameraTexture" );
+    textures->append( cameraTexture );
+
+    Size frameSize = captureThread->frameSize();
+    cameraTexture->initialize( frameSize.width, frameSize.height );
 
     loadTextures();
     emit message( "Texturas cargadas" );
@@ -221,15 +188,28 @@ void Scene::initializeGL()
 //    Resolver: No existe un decodificador disponible...
 //    loadVideos();
 //    emit message( "Videos cargados" );
+
+    processThread->setTexture( cameraTexture );
+
+    captureThread->start();
+    processThread->start();
+
+    // Sin vsync el timer a 0 ms no pararia nunca
+    renderTimer->start( format().swapInterval() > 0 ? 0 : FALLBACK_INTERVAL );
 }
 
 void Scene::resizeGL( int width, int height )
 {
     glViewport( 0, 0, width, height );
+
+    viewportSize = Size( width, height );
+    projectionValid = false;
 }
 
 void Scene::paintGL()
 {
+    PROFILE_SCOPE( PAINT );
+
     glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
 
     glMatrixMode( GL_PROJECTION );
@@ -257,53 +237,48 @@ void Scene::paintGL()
 
     // Fin: Gráfico de cámara
 
-    glMatrixMode( GL_PROJECTION );
-    double projectionMatrix[16];
-
-    cv::Size2i sceneSize( RESOLUTION_WIDTH, RESOLUTION_HEIGHT );
-    cv::Size2i openGlSize( RESOLUTION_WIDTH, RESOLUTION_HEIGHT );
-    cameraParameters->glGetProjectionMatrix( sceneSize, openGlSize, projectionMatrix, 0.05, 10 );
-
-    glLoadMatrixd( projectionMatrix );
-    glMatrixMode( GL_MODELVIEW );
-    double modelview_matrix[16];
-
-    // Inicio: Graficos sobre la mano abierta
+    // Inicio: Graficos sobre la mano abierta ( la pose ya viene calculada en shown )
 
-    if( matrix.size() == 12 && relevants.size() == 12 )
+    if( shown.pose.valid )
     {
-        vector< Point2f > corners;
-        corners.clear();
-
-        corners.push_back( relevants.at( 10 ) );
-        corners.push_back( relevants.at( 9 ) );
-        corners.push_back( relevants.at( 2 ) );
-        corners.push_back( relevants.at( 1 ) );
+        if( ! projectionValid ) updateProjection();
 
-        Marker marker( corners, 1 );
+        glMatrixMode( GL_PROJECTION );
+        glLoadMatrixd( projectionMatrix );
+        glMatrixMode( GL_MODELVIEW );
 
-        marker.calculateExtrinsicsHandMatrix( 0.08f,
-                                              cameraParameters->CameraMatrix,
-                                              matrix,
-                                              cameraParameters->Distorsion,
-                                              true );
-
-        marker.glGetModelViewMatrix( modelview_matrix );
-        glLoadMatrixd( modelview_matrix );
+        double modelview[ 16 ];
+        shown.pose.modelView( FrameSource::now() + refreshInterval, modelview );
+        glLoadMatrixd( modelview );
 
         // Dibuja imagenes planas
         glTranslatef( 0.005, y, z );
         glRotatef( rotacion, 1, 0, 0 );
 
-//        drawSheet( ( textures->at( textureIndex )->name ), 35 );
-        drawBox( ( textures->at( textureIndex )->name ), 20 );
-//        drawModel( ( models->at( modelIndex )->name ), 8 );
+//        drawSheet( ( textures->at( shown.textureIndex )->name ), 35 );
+        drawBox( ( textures->at( shown.textureIndex )->name ), 20 );
+//        drawModel( ( models->at( shown.modelIndex )->name ), 8 );
 //        drawVideo( "trailer-RF7.mp4", 100, 200 );
 
     }
 
     // Fin: Graficos sobre la mano abierta
 
+#ifdef ENABLE_PROFILER
+    if( showProfile )
+    {
+        glMatrixMode( GL_PROJECTION );
+        glLoadIdentity();
+        glMatrixMode( GL_MODELVIEW );
+        glLoadIdentity();
+        glColor3f( 1, 1, 0 );
+
+        QStringList lines = Profiler::instance().summary();
+        for( int i = 0; i < lines.size(); i++ )
+            renderText( 10, 60 + 15 * i, lines.at( i ), QFont( "Monospace", 9 ) );
+    }
+#endif
+
     glFlush();
 }
 
@@ -314,14 +289,28 @@ void Scene::keyPressEvent( QKeyEvent *event )
         if( device ) device = 0;
         else device = 1;
 
-        videoCapture->release();
-        videoCapture->open( device );
+        captureThread->setDevice( device );
         break;
 
     case Qt::Key_C:
         this->calculateMatrix();
         break;
 
+    case Qt::Key_I:
+        showProfile = ! showProfile;
+        break;
+
+    case Qt::Key_F:
+        poseFiltering.store( ( poseFiltering.load() + 1 ) % 3 );
+        if( poseFiltering.load() == POSE_RAW ) emit message( "Pose sin filtrar" );
+        if( poseFiltering.load() == POSE_FILTERED ) emit message( "Pose filtrada" );
+        if( poseFiltering.load() == POSE_PREDICTED ) emit message( "Pose filtrada con prediccion" );
+        break;
+
+    case Qt::Key_P:
+        this->pyrDown( ( pyramidLevel.load() + 1 ) % 3 );
+        break;
+
     case Qt::Key_Escape:
         qApp->quit();
         break;
@@ -353,6 +342,9 @@ void Scene::keyPressEvent( QKeyEvent *event )
 
 void Scene::mouseMoveEvent( QMouseEvent *event )
 {
+    // Todavia no llego ningun cuadro procesado
+    if( textures->at( 0 )->mat.empty() ) return;
+
     Mat hsvFrame;
     cvtColor( textures->at( 0 )->mat, hsvFrame, CV_BGR2HSV );
 
@@ -361,293 +353,39 @@ void Scene::mouseMoveEvent( QMouseEvent *event )
     this->refSkin->addGoodValue( color[0], color[1], color[2] );
 }
 
-void Scene::process( Mat &frame )
+void Scene::process( FrameResult &result )
 {
-    // Filtramos por color
-
-    Mat hsvFrame;
-//    cvtColor( frame, hsvFrame, CV_BGR2HSV );  // Del Emi
-    cvtColor( frame, hsvFrame, CV_BGR2Lab );  // Del Cesar
-
-    std::vector< uint8_t > mask;
-
-    for( int j = 0; j < hsvFrame.rows; j++ )
-    {
-        for( int i = 0; i < hsvFrame.cols; i++ )
-        {
-            Vec3b color = hsvFrame.at< Vec3b >( Point( i, j ) );
-
-// Esto es del Emi que elige hue, sat y val haciendo clic en la pantalla
-//            if( color[0] >= refSkin->minimumHue && color[0] <= refSkin->maximumHue &&
-//                color[1] >= refSkin->minimumSat && color[1] <= refSkin->maximumSat &&
-//                color[2] >= refSkin->minimumVal && color[2] <= refSkin->maximumVal )
-//            {
-//                mask.push_back( 255 );
-//            }
-//            else
-//            {
-//                mask.push_back( 0 );
-//            }
-
-            // Yo solo controlo el a del Lab sacado de los QSlider
-            if( color[1] >= refSkin->minimumHue && color[1] <= refSkin->maximumHue )
-            {
-                mask.push_back( 0 );
-            }
-            else
-            {
-                mask.push_back( 255 );
-            }
-
-        }
-    }
-
-    Mat binary( Size( hsvFrame.cols, hsvFrame.rows ), CV_8UC1, ( void* )mask.data() );
-
-    // Erosion y dilatacion de la imagen binaria
-
-//    Mat matrix = ( Mat_< uchar >( 7, 7 ) << 0,0,1,1,1,0,0,
-//                                            0,1,1,1,1,1,0,
-//                                            1,1,1,1,1,1,1,
-//                                            1,1,1,1,1,1,1,
-//                                            1,1,1,1,1,1,1,
-//                                            0,1,1,1,1,1,0,
-//                                            0,0,1,1,1,0,0);
-
-    int erosion_size = 9;
-    Mat matrix = getStructuringElement( MORPH_CROSS,
-                                        Size( 2*erosion_size + 1, 2*erosion_size+1 ),
-                                        Point( erosion_size, erosion_size ) );
-
+    // Los rangos se cambian desde la interfaz, aca se toma una copia para todo el cuadro
+    int minimumHue, maximumHue;
+    refSkin->hueRange( minimumHue, maximumHue );
 
-    erode( binary, binary, matrix );
-    dilate( binary, binary, matrix );
+    handTracker.setSkinRange( minimumHue, maximumHue );
+    handTracker.setPyramidLevel( pyramidLevel.load() );
+    handTracker.process( result.frame, result.hand );
 
-    Mat binaryCopy = binary.clone();
+    // La tecla C toma el modelo de la mano de este cuadro
+    if( modelRequested.fetchAndStoreRelaxed( 0 ) ) matrix = HandTracker::handModel( result.hand );
 
-    // Cierre convexo
+    int filtering = poseFiltering.load();
+    poseFilter.setEnabled( filtering != POSE_RAW );
+    poseFilter.setPrediction( filtering == POSE_PREDICTED ? MAXIMUM_LEAD : 0 );
 
-    vector< Point > points;
+    Marker marker;
 
-    for( int i = 0; i < binary.rows; i++ )
+    PROFILE_START( POSE );
+    if( HandTracker::estimatePose( result.hand, matrix, *cameraParameters, marker, &poseSolver ) )
     {
-        for( int j = 0; j < binary.cols; j++ )
-        {
-            if( ( ( int )binary.at< uchar >( i, j ) ) == 255 )
-            {
-                points.push_back( Point( j, i ) );
-            }
-        }
+        poseFilter.update( marker.Rvec, marker.Tvec, result.time, result.pose );
     }
-
-    vector< Point > hull;
-    hull.clear();
-
-    convexHull( Mat( points ), hull, false );
-
-    // Dibujamos extremos
-
-    int minimumDistance = 3000;
-
-    vector< Point > baricenters;
-
-    if( hull.size() > 1 )
+    else
     {
-        if( distance( hull.at( 0 ), hull.at( ( hull.size() - 1 ) ) ) > minimumDistance )
-        {
-            baricenters.push_back( hull.at( 0 ) );
-        }
-    }
-
-    for( unsigned int i = 1; i < hull.size(); i++ )
-    {
-        if( distance( hull.at( i ), hull.at( i - 1 ) ) > minimumDistance )
-        {
-            baricenters.push_back( hull.at( i ) );
-        }
-    }
-
-    // Centro de masa segun cierre convexo
-
-    if( baricenters.size() > 0 )
-    {
-        baricenter.x = 0;
-        baricenter.y = 0;
-
-        for( unsigned int i = 0; i < baricenters.size(); i++ )
-        {
-            baricenter.x += baricenters.at( i ).x;
-            baricenter.y += baricenters.at( i ).y;
-        }
-
-        baricenter.x /= baricenters.size();
-        baricenter.y /= baricenters.size();
-
-        // Dibuja el centro de la palma
-//        circle( frame, baricenter, 10 , Scalar( 255, 0, 255 ), 2 );
-
-        // Dibuja lineas grises desde el centro a los bordes
-        for( unsigned int i = 0; i < baricenters.size(); i++ )
-        {
-            line( frame, baricenters.at( i ), baricenter, Scalar( 128, 128, 128 ), 1 );
-        }
-    }
-
-    // Dibujamos bordes, Entre las puntas de los dedos
-    if( hull.size() > 1 )
-        line( frame, hull.at( 0 ), hull.at( ( hull.size() - 1 ) ), Scalar( 128, 128, 128 ), 1 );
-
-    double distanciaEuclidian = 0;
-    double sumatoriaDistancia = 0;
-    double sumatoriaVarianzaDistancia = 0;
-    float promediaDistancia = 0;
-    float varianzaDistancia = 0;
-
-    // Dibujamos bordes, Entre las puntas de los dedos
-    for( unsigned int i = 1; i < hull.size(); i++ )
-    {
-        line( frame, hull.at( i ), hull.at( i - 1 ), Scalar( 128, 128, 128 ), 1 );
-
-        distanciaEuclidian = cv::norm(hull.at( i ) - hull.at( i - 1 ));//Euclidian distance
-        sumatoriaDistancia += distanciaEuclidian;
-//        qDebug() << "distanciaEuclidian=" << distanciaEuclidian;
-
-    }
-
-    promediaDistancia = sumatoriaDistancia/(hull.size()-1);
-//    qDebug() << "promediaDistancia=" << promediaDistancia;
-
-    for( unsigned int i = 1; i < hull.size(); i++ )
-    {
-
-        distanciaEuclidian = cv::norm(hull.at( i ) - hull.at( i - 1 ));//Euclidian distance
-        sumatoriaVarianzaDistancia = sumatoriaVarianzaDistancia +
-                (distanciaEuclidian-promediaDistancia) * (distanciaEuclidian-promediaDistancia);
-//        qDebug() << "sumatoriaVarianzaDistancia=" << sumatoriaVarianzaDistancia;
-
-    }
-
-    varianzaDistancia = sqrt(sumatoriaVarianzaDistancia/(hull.size()-1));
-    qDebug() << "varianzaDistancia = " << varianzaDistancia;
-
-
-    // Buscamos los contornos en la imagen binaria
-    vector< vector< Point > > contours;
-    findContours( binary, contours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_NONE );
-
-    relevants.clear();
-    int fingers = 1;
-
-    for( unsigned int i = 0 ; i < contours.size(); i++ )
-    {
-        // Ignoramos las areas insignificantes
-        if( contourArea( contours[i] ) >= 3000 )
-        {
-            // Detectamos cierre convexo en el contorno actual
-            vector<vector< Point > > hulls( 1 );
-            vector<vector< int > > hullsI( 1 );
-            convexHull( Mat( contours[i] ), hulls[0], false );
-            convexHull( Mat( contours[i] ), hullsI[0], false );
-
-            // Buscamos defectos de convexidad
-            vector< Vec4i > defects;
-            if ( hullsI[0].size() > 0 )
-            {
-                convexityDefects( contours[i], hullsI[0], defects );
-                if( defects.size() >= 3 )
-                {
-                    qDebug() << "\n==============================";
-
-                    float umbral = 0;  // umbral para la profundidad de la concavidad
-                    float sumatoria = 0;
-                    float promedio = 0;
-                    float varianza = 0;
-
-                    // Para el promedio
-                    for( unsigned int j = 0; j < defects.size(); j++ )
-                    {
-                        float depth = defects[j][3] / 256;
-
-                        sumatoria += depth;
-                    }
-                    promedio = sumatoria/defects.size();
-//                    qDebug() << "Promedio = " << promedio;
-
-                    sumatoria = 0;  // Ponemos en cero para usarla para la varianza
-
-                    // Para la varianza
-                    for( unsigned int j = 0; j < defects.size(); j++ )
-                    {
-                        float depth = defects[j][3] / 256;
-                        sumatoria = sumatoria + (depth-promedio) * (depth-promedio);
-                    }
-
-                    varianza = sqrt(sumatoria/defects.size());
-//                    qDebug() << "Varianza = " << varianza;
-
-                    for( unsigned int j = 0; j < defects.size(); j++ )
-                    {
-                        // the farthest from the convex hull point within the defect
-                        float depth = defects[j][3] / 256;
-
-
-
-//                        qDebug() << depth;
-
-                        // Filtramos por profundidad
-//                        if( depth > 100 )  // Umbral para que no detecte valle en la muneca
-//                        if( depth > 70 )
-                        if( depth > promedio )
-                        {
-                            // Entra a este if cada vez que supere esta depth, deberia detectar 4 depth que superen
-                            // este umbral. Es decir, detectar los 4 valles. Si el antebrazo se muestra mucho,
-                            // entonces quizas se detecte un valle mas, que parezca un sexto dedo.
-
-                            // Cuando la mano se aleja, los depth no llegan a superar el umbral. Deberia fijarse
-                            // como umbral un porcentaje y no una distancia fija.
-
-                            // Valles = convexity defects = defectos de convexidad
-                            // Envoltura convexa = convex hull
-
-                            int startidx = defects[j][0];
-                            Point ptStart( contours[i][startidx] );
-
-                            int endidx = defects[j][1];
-                            Point ptEnd( contours[i][endidx] );
-
-                            int faridx = defects[j][2];
-                            Point ptFar( contours[i][faridx] );
-
-//                            qDebug() << "cv::norm(ptStart - ptEnd)"  << cv::norm(ptStart - ptEnd);
-
-
-//                            if ( cv::norm(ptStart - ptEnd) < varianzaDistancia )  {
-
-                                circle( frame, ptStart, 8, Scalar( 255, 0, 0 ), 2 );
-                                circle( frame, ptFar, 8, Scalar( 0, 255, 0 ), 2 );
-                                circle( frame, ptEnd, 8, Scalar( 0, 0, 255 ), 2 );
-//                            }
-
-                            relevants.push_back( ptStart );
-                            relevants.push_back( ptFar );
-                            relevants.push_back( ptEnd );
-
-                            fingers++;
-                        }
-                    }
-                }
-            }
-        }
-    }
-
-    if( fingers > 1 )
-    {
-        QString text( "Dedos: " + QString::number( fingers ) );
-        putText( frame, text.toStdString(), Point( 10, 30 ), 1, 2, Scalar( 255, 0, 0 ) );
+        poseFilter.reset();
+        result.pose.valid = false;
     }
+    PROFILE_STOP( POSE );
 
     // Aca se detecta la interaccion para cambiar de modelo a dibujar
-    if( fingers == 5  && lastFingers == 4 )
+    if( result.hand.changeModel )
     {
         textureIndex++;
         modelIndex++;
@@ -656,14 +394,8 @@ void Scene::process( Mat &frame )
         if( modelIndex >= models->size() ) modelIndex = 0;
     }
 
-    lastFingers = fingers;
-
-    // Mostramos miniatura
-    Mat preview( binaryCopy.rows, binaryCopy.cols, CV_8UC3 );
-    cvtColor( binaryCopy, preview, CV_GRAY2BGR );
-    Mat previewResized( 96, 128, CV_8UC3 );
-    cv::resize( preview, previewResized, previewResized.size(), 0, 0, INTER_CUBIC );
-    previewResized.copyTo( frame( Rect( frame.cols - 135, frame.rows - 103, 128, 96 ) ) );
+    result.textureIndex = textureIndex;
+    result.modelIndex = modelIndex;
 }
 
 void Scene::drawCamera( int percentage )
@@ -773,21 +505,7 @@ void Scene::drawModel( QString modelName, int percentage )
             glEnable( GL_TEXTURE_2D );
             glBindTexture( GL_TEXTURE_2D, models->at( i )->textureId );
             glScalef( scale, scale, -scale );
-            glEnableClientState( GL_VERTEX_ARRAY );
-            glEnableClientState( GL_NORMAL_ARRAY );
-            glEnableClientState( GL_TEXTURE_COORD_ARRAY );
-
-                glBindBuffer( GL_ARRAY_BUFFER, models->at( i )->normalVBO );
-                glNormalPointer( GL_FLOAT, 0, NULL );
-                glBindBuffer( GL_ARRAY_BUFFER, models->at( i )->texCoordVBO );
-                glTexCoordPointer( 2, GL_FLOAT, 0, NULL );
-                glBindBuffer( GL_ARRAY_BUFFER, models->at( i )->vertexVBO );
-                glVertexPointer( 3, GL_FLOAT, 0, NULL );
-                glDrawArrays( GL_TRIANGLES, 0, models->at( i )->totalFaces * 3 );
-
-            glDisableClientState( GL_VERTEX_ARRAY );
-            glDisableClientState( GL_NORMAL_ARRAY );
-            glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+            models->at( i )->draw();
 
             glDisable( GL_TEXTURE_2D );
         }
@@ -844,8 +562,42 @@ void Scene::decreaseVideoVolume( QString videoName )
 
 void Scene::slot_updateScene()
 {
-    videoCapture->operator >>( textures->operator []( 0 )->mat );
-    process( textures->operator []( 0 )->mat );
-    textures->operator []( 0 )->generateFromMat();
+    // Con vsync este slot corre una vez por refresco de la pantalla
+    double now = FrameSource::now();
+    if( lastRefresh > 0 ) refreshInterval += 0.1 * ( std::min( now - lastRefresh, 0.1 ) - refreshInterval );
+    lastRefresh = now;
+
+    // Algunos drivers aceptan el swap interval y no lo respetan: si se dibuja a mas de 250 cuadros por segundo
+    // se pasa al timer
+    if( renderTimer->interval() == 0 && refreshInterval < 0.004 ) renderTimer->setInterval( FALLBACK_INTERVAL );
+
+    cameraTexture->recycle();
+
+    // Siempre el ultimo resultado: los que reemplazo el hilo de procesamiento ya se contaron como perdidos
+    if( processedFrames.pop( shown ) )
+    {
+        // La imagen pasa a la textura y el buffer anterior de la textura vuelve a circular por las colas
+        std::swap( cameraTexture->mat, shown.frame );
+
+        PROFILE_START( UPLOAD );
+
+        if( shown.pboSlot >= 0 ) cameraTexture->uploadSlot( shown.pboSlot );
+        else cameraTexture->upload();
+
+        PROFILE_STOP( UPLOAD );
+
+        PROFILE_COUNT( SHOWN, 1 );
+
+        // Mas viejo que lo que se puede extrapolar la pose: la escena va a quedar atrasada respecto de la mano
+        if( now - shown.time > MAXIMUM_LEAD ) PROFILE_COUNT( LATE, 1 );
+    }
+    else
+    {
+        // Sin cuadro nuevo la textura queda como esta y solo se vuelve a dibujar la escena con la pose extrapolada
+        PROFILE_COUNT( DUPLICATED, 1 );
+    }
+
     this->updateGL();
+
+    PROFILE_AGGREGATE();
 }
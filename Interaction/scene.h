@@ -9,6 +9,7 @@
 
 #include <QDir>
 #include <QFile>
+#include <QMutex>
 #include <QTimer>
 #include <QVector>
 #include <QGLWidget>
@@ -26,6 +27,9 @@
 #include "texture.h"
 #include "model.h"
 #include "video.h"
+#include "handtracker.h"
+#include "pipeline.h"
+#include "profiler.h"
 
 #include "principal.h"
 
@@ -48,6 +52,9 @@ public:
     int minimumVal;
     int maximumVal;
 
+    // Los rangos se cambian desde la interfaz y se leen desde el hilo de procesamiento
+    QMutex mutex;
+
     Skin( QObject *parent = 0 ) : QObject( parent ),
                                   minimumHue( -1 ),
                                   maximumHue( -1 ),
@@ -59,14 +66,24 @@ public:
     }
 
     void addMinHue( int hue )  {
+        QMutexLocker locker( &mutex );
         minimumHue = hue;
     }
     void addMaxHue( int hue )  {
+        QMutexLocker locker( &mutex );
         maximumHue = hue;
     }
 
+    void hueRange( int &minimum, int &maximum )  {
+        QMutexLocker locker( &mutex );
+        minimum = minimumHue;
+        maximum = maximumHue;
+    }
+
     void addGoodValue( int hue, int sat, int val )
     {
+        QMutexLocker locker( &mutex );
+
         if( minimumHue < 0 || maximumHue < 0 )
         {
             minimumHue = hue; maximumHue = hue;
@@ -100,9 +117,22 @@ class Scene : public QGLWidget, protected QGLFunctions
 private:
 
     int device;
-    VideoCapture *videoCapture;
 
-    QTimer *sceneTimer;
+    // Captura, procesamiento y dibujo en hilos distintos, unidos por colas que se quedan con el ultimo cuadro
+    CaptureRing capturedFrames;
+    ResultRing processedFrames;
+    CaptureThread *captureThread;
+    ProcessThread *processThread;
+
+    // Ultimo resultado recibido, el que se esta mostrando
+    FrameResult shown;
+    StreamingTexture *cameraTexture;
+
+    // Dibujo al ritmo de la pantalla: con vsync el timer vuelve a disparar apenas termina el cuadro anterior y
+    // el swap de buffers espera el refresco. refreshInterval es el tiempo medido entre refrescos
+    QTimer *renderTimer;
+    double lastRefresh, refreshInterval;
+
     bool videoActive;
 
     QVector< Texture * > *textures;
@@ -112,24 +142,45 @@ private:
     CameraParameters *cameraParameters;
 
     Skin *refSkin;
-    Point baricenter;
+    HandTracker handTracker;
 
-    vector< Point > relevants;
-    int textureIndex, modelIndex;
-    int lastFingers;
+    // Nivel de la piramide para handTracker, se cambia desde la interfaz
+    QAtomicInt pyramidLevel;
 
-    double distance( Point a, Point b );
+    // Tiempos por etapa en pantalla ( tecla I, solo con CONFIG+=profiler )
+    bool showProfile;
 
+    // Estado del hilo de procesamiento entre cuadros
+    int textureIndex, modelIndex;
+
+    // Modelo de la mano y pose del cuadro anterior, de donde parte la del siguiente. Solo los usa el hilo de
+    // procesamiento: la tecla C pide el modelo con modelRequested y se toma de la mano del proximo cuadro
     vector< float > matrix;
+    PlanarPoseSolver poseSolver;
+    QAtomicInt modelRequested;
     void calculateMatrix();
 
+    // Filtro de la pose, tambien del hilo de procesamiento. La tecla F recorre sin filtro, filtro, y filtro con
+    // prediccion ( por defecto )
+    enum { POSE_RAW, POSE_FILTERED, POSE_PREDICTED };
+    PoseFilter poseFilter;
+    QAtomicInt poseFiltering;
+
+    // Proyeccion de la camara para el tamanio actual de la ventana. Se recalcula en paintGL solo si cambio el
+    // viewport o los parametros de la camara ( hay que poner projectionValid en false al cambiarlos )
+    double projectionMatrix[ 16 ];
+    Size viewportSize;
+    bool projectionValid;
+    void updateProjection();
+
     void loadTextures();
     void loadModels();
     void prepareModels();
     void loadTexturesForModels();
     void loadVideos();
 
-    void process( Mat &frame );
+    void process( FrameResult &result );
+    friend class ProcessThread;
 
     void drawCamera( int percentage = 100 );
     void drawCameraBox( int percentage = 100 );
@@ -147,6 +198,16 @@ private:
 public:
 
     Scene( QWidget *parent = 0 );
+    ~Scene();
+
+    /**
+     * Busca la mano en la imagen reducida 2^level veces ( 0 es la imagen completa, 1 la mitad, 2 un cuarto ).
+     * Los puntos de relevants se refinan despues en la imagen completa. Con la tecla P se recorren 0, 1 y 2.
+     */
+    void pyrDown( unsigned int level )
+    {
+        pyramidLevel.store( level );
+    }
 
 protected:
 
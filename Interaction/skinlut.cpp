@@ -0,0 +1,107 @@
+#include "skinlut.h"
+#include "skinsegmenter.h"
+
+#include <cstring>
+#include <algorithm>
+
+#define SKINLUT_CELLS       ( 32 * 32 * 32 )
+#define SKINLUT_CELL_COLORS ( 8 * 8 * 8 )
+#define SKINLUT_CELL_BYTES  ( SKINLUT_CELL_COLORS / 8 )
+
+SkinLUT::SkinLUT() : minimumA( -1 ),
+                     maximumA( -1 ),
+                     cells( SKINLUT_CELLS, PENDING ),
+                     blocks( ( 2 + SKINLUT_CELLS ) * SKINLUT_CELL_BYTES ),
+                     blockCount( 2 )
+{
+    // Bloques compartidos por las celdas uniformes
+    memset( &blocks[ INSIDE * SKINLUT_CELL_BYTES ], 0xFF, SKINLUT_CELL_BYTES );
+    memset( &blocks[ OUTSIDE * SKINLUT_CELL_BYTES ], 0x00, SKINLUT_CELL_BYTES );
+}
+
+void SkinLUT::setRange( int minimumA, int maximumA )
+{
+    if( minimumA == this->minimumA && maximumA == this->maximumA ) return;
+
+    this->minimumA = minimumA;
+    this->maximumA = maximumA;
+
+    std::fill( cells.begin(), cells.end(), ( unsigned short )PENDING );
+    blockCount = 2;
+}
+
+/**
+ * Clasifica los 512 colores de la celda ( indice ( R >> 3 ) << 10 | ( G >> 3 ) << 5 | ( B >> 3 ) ) y
+ * devuelve su bloque. Dentro de la celda el color se indexa igual, con los 3 bits bajos de cada canal.
+ */
+unsigned short SkinLUT::fill( int cell )
+{
+    uchar bgr[ SKINLUT_CELL_COLORS * 3 ];
+    uchar mask[ SKINLUT_CELL_COLORS ];
+
+    const int r0 = ( cell >> 10 ) << 3, g0 = ( ( cell >> 5 ) & 31 ) << 3, b0 = ( cell & 31 ) << 3;
+
+    for( int k = 0; k < SKINLUT_CELL_COLORS; k++ )
+    {
+        bgr[ 3 * k ] = ( uchar )( b0 + ( k & 7 ) );
+        bgr[ 3 * k + 1 ] = ( uchar )( g0 + ( ( k >> 3 ) & 7 ) );
+        bgr[ 3 * k + 2 ] = ( uchar )( r0 + ( k >> 6 ) );
+    }
+
+    Mat colors( 1, SKINLUT_CELL_COLORS, CV_8UC3, bgr );
+    Mat colorsMask( 1, SKINLUT_CELL_COLORS, CV_8UC1, mask );
+    SkinSegmenter::segment( colors, colorsMask, minimumA, maximumA );
+
+    int inside = 0;
+    for( int k = 0; k < SKINLUT_CELL_COLORS; k++ ) inside += mask[ k ] == 0;
+
+    unsigned short block;
+    if( inside == SKINLUT_CELL_COLORS ) block = INSIDE;
+    else if( inside == 0 ) block = OUTSIDE;
+    else
+    {
+        uchar *bits = &blocks[ blockCount * SKINLUT_CELL_BYTES ];
+        memset( bits, 0, SKINLUT_CELL_BYTES );
+        for( int k = 0; k < SKINLUT_CELL_COLORS; k++ )
+            if( mask[ k ] == 0 ) bits[ k >> 3 ] |= ( uchar )( 1 << ( k & 7 ) );
+
+        block = ( unsigned short )blockCount++;
+    }
+
+    cells[ cell ] = block;
+    return block;
+}
+
+void SkinLUT::segmentRow( const uchar *src, uchar *dst, int n )
+{
+    for( int i = 0; i < n; i++, src += 3 )
+    {
+        int b = src[ 0 ], g = src[ 1 ], r = src[ 2 ];
+        int cell = ( ( r >> 3 ) << 10 ) | ( ( g >> 3 ) << 5 ) | ( b >> 3 );
+
+        // La unica rama es la de las celdas todavia sin calcular; las uniformes apuntan a los bloques
+        // compartidos de todo 1 o todo 0, asi que se leen igual que las mixtas
+        unsigned short block = cells[ cell ];
+        if( block == PENDING ) block = fill( cell );
+
+        int k = ( ( r & 7 ) << 6 ) | ( ( g & 7 ) << 3 ) | ( b & 7 );
+        int bit = ( blocks[ block * SKINLUT_CELL_BYTES + ( k >> 3 ) ] >> ( k & 7 ) ) & 1;
+        dst[ i ] = ( uchar )( bit - 1 );
+    }
+}
+
+void SkinLUT::segment( const Mat &frame, Mat &mask )
+{
+    CV_Assert( frame.type() == CV_8UC3 );
+
+    mask.create( frame.rows, frame.cols, CV_8UC1 );
+
+    if( frame.isContinuous() && mask.isContinuous() )
+    {
+        segmentRow( frame.ptr< uchar >( 0 ), mask.ptr< uchar >( 0 ), frame.rows * frame.cols );
+        return;
+    }
+
+    for( int j = 0; j < frame.rows; j++ )
+        segmentRow( frame.ptr< uchar >( j ), mask.ptr< uchar >( j ), frame.cols );
+}
@@ -0,0 +1,56 @@
+#ifndef SKINLUT_H
+#define SKINLUT_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/**
+ * Tabla BGR -> { piel, no piel } precalculada a partir del rango de Skin.
+ *
+ * El cubo de colores se divide en 32x32x32 celdas de 8x8x8 colores. Para cada celda se guarda si todos sus
+ * colores estan dentro del rango, si ninguno lo esta, o si es una celda mixta ( las que corta el borde del
+ * rango ), y solo las mixtas tienen su propio bloque de un bit por color. Asi la tabla de celdas ( 64 KB ) queda
+ * en cache y el resultado es exactamente el de SkinSegmenter, con dos lecturas de tabla por pixel ( la celda y
+ * el bit de su bloque ).
+ *
+ * Las celdas se calculan la primera vez que aparece uno de sus colores; cuando cambia el rango ( sliders o
+ * clic en la escena ) solo se marcan como pendientes, sin recalcular nada hasta que hagan falta.
+ *
+ * No se usa en HandTracker: con las tablas de SkinSegmenter en L1 el calculo directo del a es unas dos veces
+ * mas rapido que esta tabla ( bench skin ). Queda para comparar en otras CPUs.
+ */
+class SkinLUT
+{
+public:
+
+    SkinLUT();
+
+    /**
+     * Rango del canal a del Lab que NO es piel ( igual que Skin::minimumHue y Skin::maximumHue ).
+     * Si no cambio, no hace nada.
+     */
+    void setRange( int minimumA, int maximumA );
+
+    /**
+     * Mascara de frame ( CV_8UC3 ) en mask ( CV_8UC1 ): 0 dentro del rango, 255 fuera.
+     */
+    void segment( const Mat &frame, Mat &mask );
+
+private:
+
+    enum { INSIDE = 0, OUTSIDE = 1, PENDING = 0xFFFF };
+
+    int minimumA, maximumA;
+
+    // Bloque de bits ( 1 = dentro del rango ) de cada celda; INSIDE y OUTSIDE son los bloques compartidos
+    std::vector< unsigned short > cells;
+    std::vector< uchar > blocks;
+    int blockCount;
+
+    unsigned short fill( int cell );
+    void segmentRow( const uchar *src, uchar *dst, int n );
+};
+
+#endif // SKINLUT_H
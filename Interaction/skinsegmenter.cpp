@@ -0,0 +1,383 @@
+#include "skinsegmenter.h"
+
+#include <cmath>
+#include <climits>
+#include <vector>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define SKIN_X86
+#include <immintrin.h>
+#endif
+
+// Tablas de la conversion BGR -> Lab de 8 bits de OpenCV 2.4 ( RGB2Lab_b en imgproc/color.cpp )
+
+#define SKIN_XYZ_SHIFT    12
+#define SKIN_GAMMA_SHIFT  3
+#define SKIN_LAB_SHIFT2   ( SKIN_XYZ_SHIFT + SKIN_GAMMA_SHIFT )
+#define SKIN_CBRT_SIZE    ( 256 * 3 / 2 * ( 1 << SKIN_GAMMA_SHIFT ) )
+
+namespace
+{
+
+// Raiz cubica de OpenCV ( cvCbrt ), para que la tabla salga identica a la de cvtColor
+float cbrtOpenCV( float value )
+{
+    union { float f; int i; } v, m;
+
+    v.f = value;
+    int ix = v.i & 0x7fffffff;
+    int s = v.i & 0x80000000;
+    int ex = ( ix >> 23 ) - 127;
+    int shx = ex % 3;
+    shx -= shx >= 0 ? 3 : 0;
+    ex = ( ex - shx ) / 3;
+    v.i = ( ix & ( ( 1 << 23 ) - 1 ) ) | ( ( shx + 127 ) << 23 );
+    float fr = v.f;
+
+    fr = ( float )( ( ( ( ( 45.2548339756803022511987494 * fr +
+                            192.2798368355061050458134625 ) * fr +
+                          119.1654824285581628956914143 ) * fr +
+                        13.43250139086239872172837314 ) * fr +
+                      0.1636161226585754240958355063 ) /
+                    ( ( ( ( 14.80884093219134573786480845 * fr +
+                            151.9714051044435648658557668 ) * fr +
+                          168.5254414101568283957668343 ) * fr +
+                        33.9905941350215598754191872 ) * fr +
+                      1.0 ) );
+
+    m.f = value;
+    v.f = fr;
+    v.i = ( v.i + ( ex << 23 ) + s ) & ( m.i * 2 != 0 ? -1 : 0 );
+    return v.f;
+}
+
+int saturateUShort( float value )
+{
+    int i = ( int )lrintf( value );
+    return i < 0 ? 0 : ( i > USHRT_MAX ? USHRT_MAX : i );
+}
+
+struct LabTables
+{
+    // En int para poder usarlas con gathers de 32 bits
+    int gamma[ 256 ];
+    int cbrt[ SKIN_CBRT_SIZE ];
+
+    // Coeficientes de X e Y para un pixel B, G, R
+    int cx[ 3 ];
+    int cy[ 3 ];
+
+    // Aporte de cada canal a X ( 32 bits altos ) e Y ( 32 bits bajos ), con la gamma ya aplicada.
+    // Sumando las tres entradas se obtienen X e Y juntos; el redondeo va en la tabla del canal B.
+    unsigned long long xy[ 3 ][ 256 ];
+
+    LabTables()
+    {
+        for( int i = 0; i < 256; i++ )
+        {
+            float x = i * ( 1.f / 255.f );
+            gamma[ i ] = saturateUShort( 255.f * ( 1 << SKIN_GAMMA_SHIFT ) *
+                                         ( x <= 0.04045f ? x * ( 1.f / 12.92f )
+                                                         : ( float )std::pow( ( double )( x + 0.055 ) * ( 1. / 1.055 ), 2.4 ) ) );
+        }
+
+        for( int i = 0; i < SKIN_CBRT_SIZE; i++ )
+        {
+            float x = i * ( 1.f / ( 255.f * ( 1 << SKIN_GAMMA_SHIFT ) ) );
+            cbrt[ i ] = saturateUShort( ( 1 << SKIN_LAB_SHIFT2 ) *
+                                        ( x < 0.008856f ? x * 7.787f + 0.13793103448275862f : cbrtOpenCV( x ) ) );
+        }
+
+        // sRGB -> XYZ ( D65 ), X normalizado por el blanco de referencia
+        const float scaleX = ( 1 << SKIN_XYZ_SHIFT ) / 0.950456f;
+        const float scaleY = ( float )( 1 << SKIN_XYZ_SHIFT );
+
+        cx[ 0 ] = ( int )lrintf( 0.180423f * scaleX );
+        cx[ 1 ] = ( int )lrintf( 0.357580f * scaleX );
+        cx[ 2 ] = ( int )lrintf( 0.412453f * scaleX );
+
+        cy[ 0 ] = ( int )lrintf( 0.072169f * scaleY );
+        cy[ 1 ] = ( int )lrintf( 0.715160f * scaleY );
+        cy[ 2 ] = ( int )lrintf( 0.212671f * scaleY );
+
+        const unsigned long long round = 1 << ( SKIN_XYZ_SHIFT - 1 );
+        for( int c = 0; c < 3; c++ )
+        {
+            for( int i = 0; i < 256; i++ )
+            {
+                unsigned long long x = gamma[ i ] * cx[ c ] + ( c == 0 ? round : 0 );
+                unsigned long long y = gamma[ i ] * cy[ c ] + ( c == 0 ? round : 0 );
+                xy[ c ][ i ] = ( x << 32 ) | y;
+            }
+        }
+    }
+};
+
+const LabTables &tables()
+{
+    static const LabTables labTables;
+    return labTables;
+}
+
+int floorDiv( int a, int b )
+{
+    int q = a / b;
+    if( ( a % b != 0 ) && ( ( a < 0 ) != ( b < 0 ) ) ) q--;
+    return q;
+}
+
+/**
+ * El canal a es a = ( 500 * ( fX - fY ) + 128 * 2^15 + 2^14 ) >> 15, creciente en d = fX - fY.
+ * Se traduce una sola vez el rango de a a un rango de d, asi el kernel no multiplica ni satura.
+ * Si el rango es vacio queda dLo > dHi.
+ */
+void rangeOfDifference( int minimumA, int maximumA, int &dLo, int &dHi )
+{
+    const int bias = 128 * ( 1 << SKIN_LAB_SHIFT2 ) + ( 1 << ( SKIN_LAB_SHIFT2 - 1 ) );
+    const int unit = 1 << SKIN_LAB_SHIFT2;
+    const int limit = 1 << 16;  // |fX - fY| nunca llega a este valor
+
+    if( minimumA <= 0 ) dLo = -limit;
+    else if( minimumA > 255 ) dLo = limit + 1;
+    else dLo = -floorDiv( bias - minimumA * unit, 500 );
+
+    if( maximumA >= 255 ) dHi = limit;
+    else if( maximumA < 0 ) dHi = -limit - 1;
+    else dHi = floorDiv( ( maximumA + 1 ) * unit - bias - 1, 500 );
+}
+
+void segmentScalar( const uchar *src, uchar *dst, int n, int dLo, int dHi )
+{
+    const LabTables &t = tables();
+
+    for( int i = 0; i < n; i++, src += 3 )
+    {
+        unsigned long long xy = t.xy[ 0 ][ src[ 0 ] ] + t.xy[ 1 ][ src[ 1 ] ] + t.xy[ 2 ][ src[ 2 ] ];
+        int fX = t.cbrt[ ( unsigned int )( xy >> 32 ) >> SKIN_XYZ_SHIFT ];
+        int fY = t.cbrt[ ( unsigned int )xy >> SKIN_XYZ_SHIFT ];
+        int d = fX - fY;
+
+        dst[ i ] = ( d >= dLo && d <= dHi ) ? 0 : 255;
+    }
+}
+
+#ifdef SKIN_X86
+
+__attribute__(( target( "sse2" ) ))
+void segmentSSE2( const uchar *src, uchar *dst, int n, int dLo, int dHi )
+{
+    const LabTables &t = tables();
+
+    const __m128i cx01 = _mm_setr_epi16( t.cx[ 0 ], t.cx[ 1 ], t.cx[ 0 ], t.cx[ 1 ], t.cx[ 0 ], t.cx[ 1 ], t.cx[ 0 ], t.cx[ 1 ] );
+    const __m128i cy01 = _mm_setr_epi16( t.cy[ 0 ], t.cy[ 1 ], t.cy[ 0 ], t.cy[ 1 ], t.cy[ 0 ], t.cy[ 1 ], t.cy[ 0 ], t.cy[ 1 ] );
+    const short round = 1 << ( SKIN_XYZ_SHIFT - 1 );
+    const __m128i cx2 = _mm_setr_epi16( t.cx[ 2 ], round, t.cx[ 2 ], round, t.cx[ 2 ], round, t.cx[ 2 ], round );
+    const __m128i cy2 = _mm_setr_epi16( t.cy[ 2 ], round, t.cy[ 2 ], round, t.cy[ 2 ], round, t.cy[ 2 ], round );
+    const __m128i one = _mm_set1_epi16( 1 );
+    const __m128i lo = _mm_set1_epi32( dLo );
+    const __m128i hi = _mm_set1_epi32( dHi );
+
+    short b[ 8 ], g[ 8 ], r[ 8 ];
+    int x[ 8 ], y[ 8 ], fx[ 8 ], fy[ 8 ];
+
+    int i = 0;
+    for( ; i + 8 <= n; i += 8, src += 24 )
+    {
+        for( int k = 0; k < 8; k++ )
+        {
+            b[ k ] = ( short )t.gamma[ src[ 3 * k ] ];
+            g[ k ] = ( short )t.gamma[ src[ 3 * k + 1 ] ];
+            r[ k ] = ( short )t.gamma[ src[ 3 * k + 2 ] ];
+        }
+
+        __m128i vb = _mm_loadu_si128( ( const __m128i * )b );
+        __m128i vg = _mm_loadu_si128( ( const __m128i * )g );
+        __m128i vr = _mm_loadu_si128( ( const __m128i * )r );
+
+        // Pares ( B, G ) y ( R, 1 ): cada madd da B*c0 + G*c1 y R*c2 + redondeo en 32 bits
+        __m128i bgLo = _mm_unpacklo_epi16( vb, vg ), bgHi = _mm_unpackhi_epi16( vb, vg );
+        __m128i r1Lo = _mm_unpacklo_epi16( vr, one ), r1Hi = _mm_unpackhi_epi16( vr, one );
+
+        __m128i xLo = _mm_add_epi32( _mm_madd_epi16( bgLo, cx01 ), _mm_madd_epi16( r1Lo, cx2 ) );
+        __m128i xHi = _mm_add_epi32( _mm_madd_epi16( bgHi, cx01 ), _mm_madd_epi16( r1Hi, cx2 ) );
+        __m128i yLo = _mm_add_epi32( _mm_madd_epi16( bgLo, cy01 ), _mm_madd_epi16( r1Lo, cy2 ) );
+        __m128i yHi = _mm_add_epi32( _mm_madd_epi16( bgHi, cy01 ), _mm_madd_epi16( r1Hi, cy2 ) );
+
+        _mm_storeu_si128( ( __m128i * )x, _mm_srli_epi32( xLo, SKIN_XYZ_SHIFT ) );
+        _mm_storeu_si128( ( __m128i * )( x + 4 ), _mm_srli_epi32( xHi, SKIN_XYZ_SHIFT ) );
+        _mm_storeu_si128( ( __m128i * )y, _mm_srli_epi32( yLo, SKIN_XYZ_SHIFT ) );
+        _mm_storeu_si128( ( __m128i * )( y + 4 ), _mm_srli_epi32( yHi, SKIN_XYZ_SHIFT ) );
+
+        for( int k = 0; k < 8; k++ )
+        {
+            fx[ k ] = t.cbrt[ x[ k ] ];
+            fy[ k ] = t.cbrt[ y[ k ] ];
+        }
+
+        __m128i dA = _mm_sub_epi32( _mm_loadu_si128( ( const __m128i * )fx ), _mm_loadu_si128( ( const __m128i * )fy ) );
+        __m128i dB = _mm_sub_epi32( _mm_loadu_si128( ( const __m128i * )( fx + 4 ) ), _mm_loadu_si128( ( const __m128i * )( fy + 4 ) ) );
+
+        __m128i outA = _mm_or_si128( _mm_cmplt_epi32( dA, lo ), _mm_cmpgt_epi32( dA, hi ) );
+        __m128i outB = _mm_or_si128( _mm_cmplt_epi32( dB, lo ), _mm_cmpgt_epi32( dB, hi ) );
+
+        __m128i packed = _mm_packs_epi32( outA, outB );
+        _mm_storel_epi64( ( __m128i * )( dst + i ), _mm_packs_epi16( packed, packed ) );
+    }
+
+    segmentScalar( src, dst + i, n - i, dLo, dHi );
+}
+
+__attribute__(( target( "avx2" ) ))
+void segmentAVX2( const uchar *src, uchar *dst, int n, int dLo, int dHi )
+{
+    const LabTables &t = tables();
+
+    const __m256i offsets = _mm256_setr_epi32( 0, 3, 6, 9, 12, 15, 18, 21 );
+    const __m256i byteMask = _mm256_set1_epi32( 0xFF );
+    const __m256i cx0 = _mm256_set1_epi32( t.cx[ 0 ] ), cx1 = _mm256_set1_epi32( t.cx[ 1 ] ), cx2 = _mm256_set1_epi32( t.cx[ 2 ] );
+    const __m256i cy0 = _mm256_set1_epi32( t.cy[ 0 ] ), cy1 = _mm256_set1_epi32( t.cy[ 1 ] ), cy2 = _mm256_set1_epi32( t.cy[ 2 ] );
+    const __m256i round = _mm256_set1_epi32( 1 << ( SKIN_XYZ_SHIFT - 1 ) );
+    const __m256i lo = _mm256_set1_epi32( dLo );
+    const __m256i hi = _mm256_set1_epi32( dHi );
+
+    // Cada gather lee 4 bytes por pixel: se deja al menos un pixel para el final escalar y no leer de mas
+    int i = 0;
+    for( ; i + 9 <= n; i += 8, src += 24 )
+    {
+        __m256i px = _mm256_i32gather_epi32( ( const int * )src, offsets, 1 );
+
+        __m256i B = _mm256_i32gather_epi32( t.gamma, _mm256_and_si256( px, byteMask ), 4 );
+        __m256i G = _mm256_i32gather_epi32( t.gamma, _mm256_and_si256( _mm256_srli_epi32( px, 8 ), byteMask ), 4 );
+        __m256i R = _mm256_i32gather_epi32( t.gamma, _mm256_and_si256( _mm256_srli_epi32( px, 16 ), byteMask ), 4 );
+
+        __m256i X = _mm256_add_epi32( _mm256_add_epi32( _mm256_mullo_epi32( B, cx0 ), _mm256_mullo_epi32( G, cx1 ) ),
+                                      _mm256_add_epi32( _mm256_mullo_epi32( R, cx2 ), round ) );
+        __m256i Y = _mm256_add_epi32( _mm256_add_epi32( _mm256_mullo_epi32( B, cy0 ), _mm256_mullo_epi32( G, cy1 ) ),
+                                      _mm256_add_epi32( _mm256_mullo_epi32( R, cy2 ), round ) );
+
+        __m256i fX = _mm256_i32gather_epi32( t.cbrt, _mm256_srli_epi32( X, SKIN_XYZ_SHIFT ), 4 );
+        __m256i fY = _mm256_i32gather_epi32( t.cbrt, _mm256_srli_epi32( Y, SKIN_XYZ_SHIFT ), 4 );
+        __m256i d = _mm256_sub_epi32( fX, fY );
+
+        __m256i out = _mm256_or_si256( _mm256_cmpgt_epi32( lo, d ), _mm256_cmpgt_epi32( d, hi ) );
+
+        __m128i packed = _mm_packs_epi32( _mm256_castsi256_si128( out ), _mm256_extracti128_si256( out, 1 ) );
+        _mm_storel_epi64( ( __m128i * )( dst + i ), _mm_packs_epi16( packed, packed ) );
+    }
+
+    segmentScalar( src, dst + i, n - i, dLo, dHi );
+}
+
+#endif
+
+typedef void ( *RowKernel )( const uchar *, uchar *, int, int, int );
+
+bool supported( SkinSegmenter::Kernel kernel )
+{
+    switch( kernel )
+    {
+    case SkinSegmenter::SCALAR:
+        return true;
+#ifdef SKIN_X86
+    case SkinSegmenter::SSE2:
+        return __builtin_cpu_supports( "sse2" );
+    case SkinSegmenter::AVX2:
+        return __builtin_cpu_supports( "avx2" );
+#endif
+    default:
+        return false;
+    }
+}
+
+RowKernel rowKernel( SkinSegmenter::Kernel kernel )
+{
+    while( !supported( kernel ) ) kernel = ( SkinSegmenter::Kernel )( kernel - 1 );
+
+    switch( kernel )
+    {
+#ifdef SKIN_X86
+    case SkinSegmenter::AVX2: return segmentAVX2;
+    case SkinSegmenter::SSE2: return segmentSSE2;
+#endif
+    default: return segmentScalar;
+    }
+}
+
+/**
+ * Los kernels vectoriales dependen de gathers que en algunas CPUs ( o con mitigaciones de microcodigo ) son
+ * mas lentos que las lecturas escalares, asi que no alcanza con saber que la CPU los soporta: se mide cada
+ * kernel una vez sobre un bloque de prueba y se queda el mas rapido.
+ */
+SkinSegmenter::Kernel calibrate()
+{
+    const int samplePixels = 64 * 1024;
+    std::vector< uchar > sample( samplePixels * 3 );
+    unsigned int seed = 12345;
+    for( size_t i = 0; i < sample.size(); i++ )
+    {
+        seed = seed * 1103515245 + 12345;
+        sample[ i ] = ( uchar )( seed >> 16 );
+    }
+    std::vector< uchar > mask( samplePixels );
+
+    int dLo, dHi;
+    rangeOfDifference( 130, 150, dLo, dHi );
+
+    SkinSegmenter::Kernel best = SkinSegmenter::SCALAR;
+    int64 bestTicks = 0;
+
+    for( int k = SkinSegmenter::SCALAR; k <= SkinSegmenter::AVX2; k++ )
+    {
+        SkinSegmenter::Kernel kernel = ( SkinSegmenter::Kernel )k;
+        if( !supported( kernel ) ) continue;
+
+        RowKernel run = rowKernel( kernel );
+        run( sample.data(), mask.data(), samplePixels, dLo, dHi );  // calienta caches y tablas
+
+        int64 ticks = getTickCount();
+        for( int r = 0; r < 4; r++ ) run( sample.data(), mask.data(), samplePixels, dLo, dHi );
+        ticks = getTickCount() - ticks;
+
+        if( k == SkinSegmenter::SCALAR || ticks < bestTicks )
+        {
+            best = kernel;
+            bestTicks = ticks;
+        }
+    }
+
+    return best;
+}
+
+}
+
+SkinSegmenter::Kernel SkinSegmenter::bestKernel()
+{
+    static const Kernel best = calibrate();
+    return best;
+}
+
+void SkinSegmenter::segment( const Mat &frame, Mat &mask, int minimumA, int maximumA )
+{
+    segment( frame, mask, minimumA, maximumA, bestKernel() );
+}
+
+void SkinSegmenter::segment( const Mat &frame, Mat &mask, int minimumA, int maximumA, Kernel kernel )
+{
+    CV_Assert( frame.type() == CV_8UC3 );
+
+    mask.create( frame.rows, frame.cols, CV_8UC1 );
+
+    int dLo, dHi;
+    rangeOfDifference( minimumA, maximumA, dLo, dHi );
+
+    RowKernel run = rowKernel( kernel );
+
+    if( frame.isContinuous() && mask.isContinuous() )
+    {
+        run( frame.ptr< uchar >( 0 ), mask.ptr< uchar >( 0 ), frame.rows * frame.cols, dLo, dHi );
+        return;
+    }
+
+    for( int j = 0; j < frame.rows; j++ )
+        run( frame.ptr< uchar >( j ), mask.ptr< uchar >( j ), frame.cols, dLo, dHi );
+}
@@ -0,0 +1,42 @@
+#ifndef SKINSEGMENTER_H
+#define SKINSEGMENTER_H
+
+#include <opencv2/core/core.hpp>
+
+using namespace cv;
+
+/**
+ * Segmentacion de piel en una sola pasada.
+ *
+ * Fusiona la conversion BGR -> Lab con la comparacion del canal a contra el rango [ minimumA, maximumA ]
+ * de Skin. Se usan las mismas tablas de punto fijo que cvtColor( CV_BGR2Lab ) para imagenes de 8 bits, por
+ * lo que el canal a calculado es identico al de OpenCV, pero sin generar la imagen Lab intermedia.
+ *
+ * La mascara respeta la convencion de Scene::process: 0 si el canal a cae dentro del rango y 255 si no.
+ *
+ * El kernel ( AVX2, SSE2 o escalar ) se elige en tiempo de ejecucion: entre los que soporta la CPU, el que
+ * resulta mas rapido en una medicion inicial.
+ */
+class SkinSegmenter
+{
+public:
+
+    enum Kernel { SCALAR, SSE2, AVX2 };
+
+    /**
+     * Genera en mask ( CV_8UC1, se reusa si ya tiene el tamanio de frame ) la mascara de frame ( CV_8UC3 ).
+     */
+    static void segment( const Mat &frame, Mat &mask, int minimumA, int maximumA );
+
+    /**
+     * Igual que segment() pero forzando un kernel. Si la CPU no lo soporta se baja al siguiente que si.
+     */
+    static void segment( const Mat &frame, Mat &mask, int minimumA, int maximumA, Kernel kernel );
+
+    /**
+     * Kernel que usa segment() en esta maquina. La primera llamada hace la medicion.
+     */
+    static Kernel bestKernel();
+};
+
+#endif // SKINSEGMENTER_H
@@ -0,0 +1,248 @@
+#include "streamingtexture.h"
+
+#include <cstring>
+
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_STREAM_DRAW
+#define GL_STREAM_DRAW 0x88E0
+#endif
+#ifndef GL_MAP_WRITE_BIT
+#define GL_MAP_WRITE_BIT 0x0002
+#endif
+#ifndef GL_MAP_INVALIDATE_BUFFER_BIT
+#define GL_MAP_INVALIDATE_BUFFER_BIT 0x0008
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+
+StreamingTexture::StreamingTexture( QString name, QObject *parent ) : Texture( name, parent ),
+                                                                      mapBufferRange( NULL ),
+                                                                      unmapBuffer( NULL ),
+                                                                      bufferStorage( NULL ),
+                                                                      fenceSync( NULL ),
+                                                                      clientWaitSync( NULL ),
+                                                                      deleteSync( NULL ),
+                                                                      width( 0 ), height( 0 ),
+                                                                      textureWidth( 0 ), textureHeight( 0 ),
+                                                                      persistent( false ),
+                                                                      nextSlot( 0 )
+{
+    for( int i = 0; i < SLOTS; i++ )
+    {
+        pbo[ i ] = 0;
+        mapped[ i ] = NULL;
+        fences[ i ] = NULL;
+    }
+}
+
+void StreamingTexture::initialize( int width, int height )
+{
+    initializeGLFunctions();
+
+    this->width = width;
+    this->height = height;
+
+    const QGLContext *context = QGLContext::currentContext();
+
+    mapBufferRange = ( MapBufferRange )context->getProcAddress( "glMapBufferRange" );
+    unmapBuffer = ( UnmapBuffer )context->getProcAddress( "glUnmapBuffer" );
+    fenceSync = ( FenceSync )context->getProcAddress( "glFenceSync" );
+    clientWaitSync = ( ClientWaitSync )context->getProcAddress( "glClientWaitSync" );
+    deleteSync = ( DeleteSync )context->getProcAddress( "glDeleteSync" );
+
+    // Con getProcAddress no alcanza: algunos drivers devuelven punteros para funciones que no soportan
+    const char *extensions = ( const char * )glGetString( GL_EXTENSIONS );
+    if( extensions && strstr( extensions, "GL_ARB_buffer_storage" ) )
+        bufferStorage = ( BufferStorage )context->getProcAddress( "glBufferStorage" );
+
+    allocateTexture( width, height );
+
+    if( ! mapBufferRange || ! unmapBuffer ) return;
+
+    const int size = width * height * 3;
+
+    glGenBuffers( SLOTS, pbo );
+
+    persistent = bufferStorage && fenceSync && clientWaitSync && deleteSync;
+
+    if( persistent )
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        for( int i = 0; i < SLOTS && persistent; i++ )
+        {
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ i ] );
+            bufferStorage( GL_PIXEL_UNPACK_BUFFER, size, NULL, flags );
+            mapped[ i ] = ( uchar * )mapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size, flags );
+
+            if( ! mapped[ i ] ) persistent = false;
+        }
+
+        // Si algun casillero no se pudo mapear se descartan todos: los buffers con almacenamiento inmutable
+        // siguen mapeados y upload() no podria volver a mapearlos, asi que se regeneran para glBufferData
+        if( ! persistent )
+        {
+            for( int i = 0; i < SLOTS; i++ )
+            {
+                if( ! mapped[ i ] ) continue;
+
+                glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ i ] );
+                unmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+                mapped[ i ] = NULL;
+            }
+
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+            glDeleteBuffers( SLOTS, pbo );
+            glGenBuffers( SLOTS, pbo );
+        }
+    }
+
+    if( ! persistent )
+    {
+        for( int i = 0; i < SLOTS; i++ )
+        {
+            glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ i ] );
+            glBufferData( GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW );
+        }
+    }
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    if( persistent )
+    {
+        for( int i = 0; i < SLOTS; i++ ) freeSlots.push( i );
+    }
+}
+
+void StreamingTexture::allocateTexture( int width, int height )
+{
+    // La unica vez que se reserva memoria para la textura, salvo que cambie el tamanio de la camara
+    glBindTexture( GL_TEXTURE_2D, id );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_BGR, GL_UNSIGNED_BYTE, NULL );
+
+    textureWidth = width;
+    textureHeight = height;
+}
+
+void StreamingTexture::copyFrame( uchar *destination, const Mat &frame )
+{
+    const int rowBytes = frame.cols * 3;
+
+    if( frame.isContinuous() )
+    {
+        memcpy( destination, frame.data, rowBytes * frame.rows );
+        return;
+    }
+
+    for( int i = 0; i < frame.rows; i++ )
+        memcpy( destination + i * rowBytes, frame.ptr< uchar >( i ), rowBytes );
+}
+
+void StreamingTexture::upload()
+{
+    if( mat.empty() ) return;
+
+    if( mat.cols != textureWidth || mat.rows != textureHeight ) allocateTexture( mat.cols, mat.rows );
+
+    glBindTexture( GL_TEXTURE_2D, id );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+    // Con mapeo persistente los PBO son del hilo que escribe los cuadros, y si no hay PBO ni modo de mapearlos
+    // o el tamanio no coincide, se sube directo desde mat
+    if( persistent || ! pbo[ 0 ] || mat.cols != width || mat.rows != height )
+    {
+        if( mat.isContinuous() )
+        {
+            glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, mat.cols, mat.rows, GL_BGR, GL_UNSIGNED_BYTE, mat.data );
+        }
+        else
+        {
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, mat.step / 3 );
+            glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, mat.cols, mat.rows, GL_BGR, GL_UNSIGNED_BYTE, mat.data );
+            glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+        }
+        return;
+    }
+
+    // Se invalida el PBO entero para que el driver no tenga que esperar a que la GPU termine de leerlo
+    const int size = width * height * 3;
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ nextSlot ] );
+
+    uchar *destination = ( uchar * )mapBufferRange( GL_PIXEL_UNPACK_BUFFER, 0, size,
+                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT );
+    if( destination )
+    {
+        copyFrame( destination, mat );
+        unmapBuffer( GL_PIXEL_UNPACK_BUFFER );
+        glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, NULL );
+    }
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    nextSlot = ( nextSlot + 1 ) % SLOTS;
+}
+
+void StreamingTexture::uploadSlot( int slot )
+{
+    if( width != textureWidth || height != textureHeight ) allocateTexture( width, height );
+
+    glBindTexture( GL_TEXTURE_2D, id );
+    glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, pbo[ slot ] );
+    glTexSubImage2D( GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, NULL );
+    glBindBuffer( GL_PIXEL_UNPACK_BUFFER, 0 );
+
+    // El casillero vuelve a estar libre cuando la GPU termine de leerlo, ver recycle()
+    fences[ slot ] = fenceSync( GL_SYNC_GPU_COMMANDS_COMPLETE, 0 );
+}
+
+void StreamingTexture::recycle()
+{
+    if( ! persistent ) return;
+
+    for( int i = 0; i < SLOTS; i++ )
+    {
+        if( ! fences[ i ] ) continue;
+
+        GLenum status = clientWaitSync( fences[ i ], 0, 0 );
+        if( status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED )
+        {
+            deleteSync( fences[ i ] );
+            fences[ i ] = NULL;
+            freeSlots.push( i );
+        }
+    }
+}
+
+int StreamingTexture::acquireSlot()
+{
+    int slot;
+    if( ! persistent || ! freeSlots.pop( slot ) ) return -1;
+    return slot;
+}
+
+bool StreamingTexture::writeSlot( int slot, const Mat &frame )
+{
+    if( frame.cols != width || frame.rows != height || frame.type() != CV_8UC3 ) return false;
+
+    copyFrame( mapped[ slot ], frame );
+    return true;
+}
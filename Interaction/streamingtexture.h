@@ -0,0 +1,101 @@
+#ifndef STREAMINGTEXTURE_H
+#define STREAMINGTEXTURE_H
+
+#include <QGLFunctions>
+
+#include "texture.h"
+#include "framering.h"
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+/**
+ * Textura para la imagen de la camara, que cambia en cada cuadro.
+ *
+ * Reserva la textura una sola vez y despues solo la actualiza con glTexSubImage2D, pasando por una ronda de
+ * pixel buffer objects para que la copia a la GPU sea asincronica.
+ *
+ * Si el driver tiene GL_ARB_buffer_storage, los PBO quedan mapeados de forma persistente y otro hilo puede
+ * escribir el cuadro directamente en ellos ( acquireSlot() y writeSlot() ). Al hilo de GL solo le queda lanzar
+ * la subida ( uploadSlot() ). Sin buffer storage ( o si no hay un casillero libre ) upload() copia mat en un
+ * PBO desde el hilo de GL, y sin glMapBufferRange sube directo desde mat.
+ *
+ * Todo lo que no sea acquireSlot() y writeSlot() se llama desde el hilo de GL con el contexto activo.
+ */
+class StreamingTexture : public Texture, protected QGLFunctions
+{
+    Q_OBJECT
+
+public:
+
+    StreamingTexture( QString name = "", QObject *parent = 0 );
+
+    /**
+     * Crea los PBO para cuadros de width x height. Va antes de que arranquen los otros hilos.
+     */
+    void initialize( int width, int height );
+
+    /**
+     * Sube mat copiandola desde este hilo.
+     */
+    void upload();
+
+    /**
+     * Sube el casillero que otro hilo ya lleno con writeSlot().
+     */
+    void uploadSlot( int slot );
+
+    /**
+     * Libera los casilleros que la GPU ya termino de leer. Conviene llamarla una vez por cuadro.
+     */
+    void recycle();
+
+    /**
+     * Desde el hilo que escribe los cuadros: un casillero libre, o -1 si no hay o no hay mapeo persistente.
+     */
+    int acquireSlot();
+
+    /**
+     * Desde el hilo que escribe los cuadros: copia frame al casillero. Si frame no tiene el tamanio de
+     * initialize() devuelve false y el casillero sigue siendo de quien lo pidio.
+     */
+    bool writeSlot( int slot, const Mat &frame );
+
+private:
+
+    enum { SLOTS = 3 };
+
+    typedef struct __GLsync *SyncObject;
+
+    typedef void *( APIENTRY *MapBufferRange )( GLenum target, ptrdiff_t offset, ptrdiff_t length, GLbitfield access );
+    typedef GLboolean ( APIENTRY *UnmapBuffer )( GLenum target );
+    typedef void ( APIENTRY *BufferStorage )( GLenum target, ptrdiff_t size, const void *data, GLbitfield flags );
+    typedef SyncObject ( APIENTRY *FenceSync )( GLenum condition, GLbitfield flags );
+    typedef GLenum ( APIENTRY *ClientWaitSync )( SyncObject sync, GLbitfield flags, quint64 timeout );
+    typedef void ( APIENTRY *DeleteSync )( SyncObject sync );
+
+    MapBufferRange mapBufferRange;
+    UnmapBuffer unmapBuffer;
+    BufferStorage bufferStorage;
+    FenceSync fenceSync;
+    ClientWaitSync clientWaitSync;
+    DeleteSync deleteSync;
+
+    int width, height;              // Tamanio de los PBO
+    int textureWidth, textureHeight;  // Tamanio reservado para la textura, 0 si todavia no se reservo
+
+    bool persistent;
+    GLuint pbo[ SLOTS ];
+    uchar *mapped[ SLOTS ];
+    SyncObject fences[ SLOTS ];
+    int nextSlot;
+
+    // Casilleros que la GPU ya leyo, del hilo de GL al que escribe los cuadros
+    FrameRing< int, SLOTS > freeSlots;
+
+    void allocateTexture( int width, int height );
+    void copyFrame( uchar *destination, const Mat &frame );
+};
+
+#endif // STREAMINGTEXTURE_H